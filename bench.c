@@ -0,0 +1,1522 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "jsontools.h"
+#include "jsonnumber.h"
+
+/*------------------------------------------------------------------
+ * Micro benchmarks for the parser. make builds them along with the
+ * library, but they are not installed. Run them from the source
+ * directory with ./bench
+ *-----------------------------------------------------------------*/
+
+#define NUMBER_COUNT    1000000
+#define NUMBER_WIDTH    32
+#define ROUNDS          5
+#define MESSAGE_COUNT   200000
+#define RECORD_COUNT    100000
+#define BUILD_COUNT     100000
+#define BUILD_FIELDS    8
+#define WIDE_KEYS       20000
+#define PLUCK_COUNT     2000
+#define PLUCK_FIELDS    40
+#define CONTENTION_COUNT 50000
+#define FLAG_COUNT      100000
+#define TEXT_COUNT      100000
+#define UTF8_COUNT      100000
+
+static const char* fieldNames[BUILD_FIELDS] = {
+   "id", "name", "email", "status", "created", "updated", "owner", "region"
+};
+
+static const char* smallMessage =
+   "{\"id\" : 1234567, \"user\" : {\"name\" : \"Jane Doe\", \"email\" : \"jane@example.com\", \"active\" : true},"
+   " \"tags\" : [\"alpha\", \"beta\", \"gamma\"], \"scores\" : [1.5, 2.25, 3.125, 4, 5],"
+   " \"location\" : {\"lat\" : 40.7128, \"lon\" : -74.006, \"city\" : \"New York\"},"
+   " \"note\" : null, \"created\" : \"2024-01-01T00:00:00Z\", \"flags\" : [true, false, true]}";
+
+static unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+
+/**
+ * A small xorshift generator, so every run benchmarks the same input
+ */
+static unsigned long long nextRandom(void){
+   seed ^= seed << 13;
+   seed ^= seed >> 7;
+   seed ^= seed << 17;
+   return seed;
+}
+
+/**
+ * Returns the current time in seconds
+ */
+static double now(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * The number conversion the parser used before stringToNumber(). The
+ * characters are copied into a buffer on the stack and handed to strtod.
+ * It is kept here as the baseline to measure against.
+ */
+static JSONError_t strtodNumber(const char* token, size_t length, double* value){
+   int tempSize = 48;
+   char temp[tempSize];
+
+   if (length >= (size_t)tempSize){
+      length = tempSize - 1;
+   }
+
+   memcpy(temp, token, length);
+   temp[length] = '\0';
+
+   errno = 0;
+   *value = strtod(temp, NULL);
+
+   if (errno){
+      return JSON_NUMBER_OUT_OF_RANGE;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Fills the table with one kind of number
+ *
+ * @param numbers - NUMBER_COUNT slots of NUMBER_WIDTH characters
+ * @param kind - 0 for integers, 1 for fixed point, 2 for full precision doubles
+ */
+static void fillNumbers(char* numbers, int kind){
+   int i;
+   for (i = 0; i < NUMBER_COUNT; ++i){
+      char* slot = numbers + (size_t)i * NUMBER_WIDTH;
+      if (kind == 0){
+         snprintf(slot, NUMBER_WIDTH, "%lld", (long long)(nextRandom() >> 20) - (1LL << 42));
+      }
+      else if (kind == 1){
+         snprintf(slot, NUMBER_WIDTH, "%.3f", (double)(nextRandom() % 10000000) / 1000.0);
+      }
+      else{
+         unsigned long long bits = nextRandom() >> 2;
+         double value;
+         memcpy(&value, &bits, sizeof(value));
+         snprintf(slot, NUMBER_WIDTH, "%.17g", value);
+      }
+   }
+}
+
+/**
+ * Times one number conversion function over the whole table
+ *
+ * @return the number of nanoseconds per number of the best round
+ */
+static double timeNumbers(const char* numbers, JSONError_t (*convert)(const char*, size_t, double*), double* sum){
+   double best = 0;
+   int round, i;
+
+   for (round = 0; round < ROUNDS; ++round){
+      double start = now();
+      for (i = 0; i < NUMBER_COUNT; ++i){
+         const char* slot = numbers + (size_t)i * NUMBER_WIDTH;
+         double value = 0;
+         convert(slot, strlen(slot), &value);
+         *sum += value;
+      }
+      double elapsed = (now() - start) * 1e9 / NUMBER_COUNT;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   return best;
+}
+
+/**
+ * Compares the old strtod based number conversion with stringToNumber()
+ */
+static void benchNumbers(void){
+   static const char* kinds[] = {"integers", "fixed point", "doubles"};
+   char* numbers = malloc((size_t)NUMBER_COUNT * NUMBER_WIDTH);
+   double sum = 0;
+   int kind;
+
+   if (!numbers){
+      fprintf(stderr, "Unable to allocate the number table\n");
+      exit(1);
+   }
+
+   fprintf(stdout, "numbers (ns per number)\n");
+   for (kind = 0; kind < 3; ++kind){
+      fillNumbers(numbers, kind);
+      double oldTime = timeNumbers(numbers, strtodNumber, &sum);
+      double newTime = timeNumbers(numbers, stringToNumber, &sum);
+      fprintf(stdout, "   %-12s strtod %6.1f   stringToNumber %6.1f   %.2fx\n",
+              kinds[kind], oldTime, newTime, oldTime / newTime);
+   }
+
+   free(numbers);
+
+   if (sum == 42.0){
+      fprintf(stdout, "\n");
+   }
+}
+
+/**
+ * Times parsing and disposing of the same small message over and over.
+ * The message is copied into a buffer first each time, like a message 
+ * read off of a socket, so PARSE_IN_SITU has a buffer it can write to.
+ *
+ * @param options - The parser options to use
+ * @param recycle - Hand each document back to the parser instead of
+ *    disposing of it
+ * @return the number of nanoseconds per message of the best round
+ */
+static double timeDocuments(int options, bool recycle){
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(smallMessage);
+   char buffer[length + 1];
+   double best = 0;
+   int round, i;
+
+   setJSONParserOptions(parser, options);
+
+   for (round = 0; round < ROUNDS; ++round){
+      double start = now();
+      for (i = 0; i < MESSAGE_COUNT; ++i){
+         JSONKeyValue_t* document = NULL;
+         size_t consumed = 0;
+         memcpy(buffer, smallMessage, length + 1);
+         JSONError_t status = (options & PARSE_IN_SITU) ?
+                              parseJSONBufferInSitu(parser, &document, buffer, length, &consumed) :
+                              parseJSONBuffer(parser, &document, buffer, length, &consumed);
+         if (status){
+            fprintf(stderr, "Unable to parse the benchmark message\n");
+            exit(1);
+         }
+         if (recycle){
+            recycleJSONDocument(parser, document);
+         }
+         else {
+            disposeOfPair(document);
+         }
+      }
+      double elapsed = (now() - start) * 1e9 / MESSAGE_COUNT;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Compares building each document with malloc against building it in
+ * an arena that is recycled for the next message, and against leaving
+ * the keys and strings in the message
+ */
+static void benchDocuments(void){
+   double mallocTime = timeDocuments(PARSE_DEFAULT, false);
+   double recycledTime = timeDocuments(PARSE_DEFAULT, true);
+   double arenaTime = timeDocuments(PARSE_ARENA, true);
+   double inSituTime = timeDocuments(PARSE_IN_SITU, true);
+   double bothTime = timeDocuments(PARSE_ARENA | PARSE_IN_SITU, true);
+
+   fprintf(stdout, "small documents (ns per message)\n");
+   fprintf(stdout, "   malloc          %8.1f\n", mallocTime);
+   fprintf(stdout, "   recycled pairs  %8.1f   %.2fx\n", recycledTime, mallocTime / recycledTime);
+   fprintf(stdout, "   arena           %8.1f   %.2fx\n", arenaTime, mallocTime / arenaTime);
+   fprintf(stdout, "   in situ         %8.1f   %.2fx\n", inSituTime, mallocTime / inSituTime);
+   fprintf(stdout, "   arena, in situ  %8.1f   %.2fx\n", bothTime, mallocTime / bothTime);
+}
+
+/**
+ * Builds one large array of records that all have the same keys
+ *
+ * @return The message, it must be freed
+ */
+static char* makeRecords(void){
+   size_t size = (size_t)RECORD_COUNT * 256;
+   char* message = malloc(size);
+   size_t length = 0;
+   int i;
+
+   if (!message){
+      fprintf(stderr, "Unable to allocate the records\n");
+      exit(1);
+   }
+
+   length += sprintf(message + length, "[");
+   for (i = 0; i < RECORD_COUNT; ++i){
+      length += sprintf(message + length,
+                        "%s{\"timestamp\":%d,\"host\":\"web%d\",\"service\":\"api\",\"level\":\"info\","
+                        "\"latency_ms\":%d.%d,\"status\":200,\"bytes_sent\":%d,\"user_id\":%d,"
+                        "\"region\":\"us-east\",\"cached\":%s,\"retries\":0,\"trace_id\":\"t%d\"}",
+                        (i) ? "," : "", 1700000000 + i, i % 16, i % 500, i % 10, i * 7, i % 1000,
+                        (i % 3) ? "true" : "false", i);
+   }
+   sprintf(message + length, "]");
+
+   return message;
+}
+
+/**
+ * Times parsing and disposing of the large array of records
+ *
+ * @param records - The message to parse
+ * @param options - The parser options to use
+ * @return the number of milliseconds of the best round
+ */
+static double timeRecords(const char* records, int options){
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(records);
+   double best = 0;
+   int round;
+
+   setJSONParserOptions(parser, options);
+
+   for (round = 0; round < ROUNDS; ++round){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      double start = now();
+      if (parseJSONBuffer(parser, &document, records, length, &consumed)){
+         fprintf(stderr, "Unable to parse the records\n");
+         exit(1);
+      }
+      recycleJSONDocument(parser, document);
+      double elapsed = (now() - start) * 1e3;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Compares copying every key against interning them for an array of
+ * records with the same 12 keys
+ */
+static void benchRecords(void){
+   char* records = makeRecords();
+   double copyTime = timeRecords(records, PARSE_DEFAULT);
+   double internTime = timeRecords(records, PARSE_INTERN_KEYS);
+   double arenaTime = timeRecords(records, PARSE_ARENA);
+   double bothTime = timeRecords(records, PARSE_ARENA | PARSE_INTERN_KEYS);
+
+   fprintf(stdout, "%d records (ms per document)\n", RECORD_COUNT);
+   fprintf(stdout, "   copied keys          %8.1f\n", copyTime);
+   fprintf(stdout, "   interned keys        %8.1f   %.2fx\n", internTime, copyTime / internTime);
+   fprintf(stdout, "   arena                %8.1f   %.2fx\n", arenaTime, copyTime / arenaTime);
+   fprintf(stdout, "   arena, interned keys %8.1f   %.2fx\n", bothTime, copyTime / bothTime);
+
+   free(records);
+}
+
+/**
+ * Builds a small record with the copying builder functions. The key and
+ * string are copied by the builder, and the pair has to be freed after
+ * it is added to the object.
+ */
+static JSONKeyValue_t* buildCopied(int id){
+   JSONValue_t* object = newJSONObject(newJSONPair(NUMBER, (char*)"seq", newJSONNumber(id)));
+   int i;
+
+   for (i = 0; i < BUILD_FIELDS; ++i){
+      char value[32];
+      snprintf(value, sizeof(value), "value %d", id + i);
+      JSONKeyValue_t* pair = newJSONPair(STRING, (char*)fieldNames[i], newJSONString(value));
+      addKeyValuePair(object, pair);
+      free(pair);
+   }
+
+   return newJSONPair(OBJECT, NULL, object);
+}
+
+/**
+ * Builds the same record with the builder functions that take ownership
+ * of the key, string, and pair handed to them.
+ */
+static JSONKeyValue_t* buildTaken(int id){
+   JSONValue_t* object = takeJSONObject(takeJSONPair(NUMBER, strdup("seq"), newJSONNumber(id)));
+   int i;
+
+   for (i = 0; i < BUILD_FIELDS; ++i){
+      char* value = malloc(32);
+      snprintf(value, 32, "value %d", id + i);
+      takeKeyValuePair(object, takeJSONPair(STRING, strdup(fieldNames[i]), takeJSONString(value)));
+   }
+
+   return takeJSONPair(OBJECT, NULL, object);
+}
+
+/**
+ * Times building and disposing of small records
+ *
+ * @param build - The function that builds a record
+ * @return the number of nanoseconds per record of the best round
+ */
+static double timeBuild(JSONKeyValue_t* (*build)(int)){
+   double best = 0;
+   int round, i;
+
+   for (round = 0; round < ROUNDS; ++round){
+      double start = now();
+      for (i = 0; i < BUILD_COUNT; ++i){
+         JSONKeyValue_t* record = build(i);
+         disposeOfPair(record);
+      }
+      double elapsed = (now() - start) * 1e9 / BUILD_COUNT;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   return best;
+}
+
+/**
+ * Compares the copying builder functions with the ones that take ownership
+ */
+static void benchBuilder(void){
+   double copyTime = timeBuild(buildCopied);
+   double takeTime = timeBuild(buildTaken);
+
+   fprintf(stdout, "building records (ns per record)\n");
+   fprintf(stdout, "   copied %8.1f   taken %8.1f   %.2fx\n", copyTime, takeTime, copyTime / takeTime);
+}
+
+/**
+ * Times building one wide object, either by adding each pair to the
+ * object (which walks to the end of the object every time) or with an
+ * appender that remembers where the end is.
+ *
+ * @param useAppender - true to build with an appender
+ * @return the number of nanoseconds per key
+ */
+static double timeWideObject(bool useAppender){
+   JSONAppender_t appender;
+   JSONValue_t* object = NULL;
+   char key[32];
+   int i;
+
+   double start = now();
+   if (useAppender){
+      startJSONContainer(&appender, OBJECT, NULL);
+   }
+   else {
+      object = takeJSONObject(NULL);
+   }
+
+   for (i = 0; i < WIDE_KEYS; ++i){
+      snprintf(key, sizeof(key), "key%d", i);
+      JSONKeyValue_t* pair = takeJSONPair(NUMBER, strdup(key), newJSONNumber(i));
+      if (useAppender){
+         appendJSONPair(&appender, pair);
+      }
+      else {
+         takeKeyValuePair(object, pair);
+      }
+   }
+
+   JSONKeyValue_t* document = (useAppender) ? finishJSONContainer(&appender) : takeJSONPair(OBJECT, NULL, object);
+   double elapsed = (now() - start) * 1e9 / WIDE_KEYS;
+
+   disposeOfPair(document);
+   return elapsed;
+}
+
+/**
+ * Compares walking to the end of an object on every insert with appending
+ */
+static void benchAppend(void){
+   double walkTime = timeWideObject(false);
+   double appendTime = timeWideObject(true);
+
+   fprintf(stdout, "building a %d key object (ns per key)\n", WIDE_KEYS);
+   fprintf(stdout, "   walked %8.1f   appended %8.1f   %.2fx\n", walkTime, appendTime, walkTime / appendTime);
+}
+
+/**
+ * Builds a message of about 40KB that holds a few simple fields and a lot
+ * of nested data that is not needed
+ *
+ * @return The message, it must be freed
+ */
+static char* makePluckMessage(void){
+   char* message = malloc(64 * 1024);
+   size_t length = 0;
+   int i, j;
+
+   if (!message){
+      fprintf(stderr, "Unable to allocate the message\n");
+      exit(1);
+   }
+
+   length += sprintf(message + length, "{\"id\":12345,\"user\":{\"name\":\"alice\",\"admin\":false}");
+   for (i = 0; i < PLUCK_FIELDS; ++i){
+      length += sprintf(message + length, ",\"field%d\":[", i);
+      for (j = 0; j < 10; ++j){
+         length += sprintf(message + length, "%s{\"host\":\"web%d\",\"latency\":%d.%d,\"ok\":true,\"tags\":[\"a\",\"b\"]}",
+                           (j) ? "," : "", j, i * j, j);
+      }
+      length += sprintf(message + length, "]");
+   }
+   sprintf(message + length, ",\"status\":\"done\"}");
+
+   return message;
+}
+
+/**
+ * Times reading 4 values out of the large message, either by building the
+ * whole document or by reading only those values out of a lazy document.
+ *
+ * @param message - The message to read from
+ * @param options - The parser options to use, or -1 for a lazy document
+ * @return the number of microseconds per message of the best round
+ */
+static double timePluck(const char* message, int options){
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(message);
+   double best = 0;
+   double sum = 0;
+   int round, i;
+
+   if (options >= 0){
+      setJSONParserOptions(parser, options);
+   }
+
+   for (round = 0; round < ROUNDS; ++round){
+      double start = now();
+      for (i = 0; i < PLUCK_COUNT; ++i){
+         if (options < 0){
+            JSONLazyDocument_t* document = NULL;
+            if (parseJSONLazy(&document, message, length)){
+               fprintf(stderr, "Unable to index the message\n");
+               exit(1);
+            }
+            JSONLazyValue_t root = getLazyRoot(document);
+            sum += getLazyNumberVal(getLazyChild(root, "id"));
+            sum += strlen(getLazyStringVal(getLazyChild(getLazyChild(root, "user"), "name")));
+            sum += getLazyNumberVal(getLazyChild(getLazyElement(getLazyChild(root, "field20"), 3), "latency"));
+            sum += strlen(getLazyStringVal(getLazyChild(root, "status")));
+            disposeOfJSONLazyDocument(document);
+         }
+         else {
+            JSONKeyValue_t* document = NULL;
+            size_t consumed = 0;
+            if (parseJSONBuffer(parser, &document, message, length, &consumed)){
+               fprintf(stderr, "Unable to parse the message\n");
+               exit(1);
+            }
+            sum += getNumberVal(getChildPair(document, "id"));
+            sum += strlen(getStringVal(getChildPair(getChildPair(document, "user"), "name")));
+            JSONKeyValue_t* element = getChildPair(document, "field20")->value->aVal;
+            for (int skip = 0; skip < 3; ++skip){
+               element = element->next;
+            }
+            sum += getNumberVal(getChildPair(element, "latency"));
+            sum += strlen(getStringVal(getChildPair(document, "status")));
+            recycleJSONDocument(parser, document);
+         }
+      }
+      double elapsed = (now() - start) * 1e6 / PLUCK_COUNT;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   if (sum == 0){
+      fprintf(stderr, "Read the wrong values\n");
+   }
+
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Compares building the whole document with reading a few values out of
+ * a lazy document
+ */
+static void benchPluck(void){
+   char* message = makePluckMessage();
+   double mallocTime = timePluck(message, PARSE_DEFAULT);
+   double arenaTime = timePluck(message, PARSE_ARENA);
+   double lazyTime = timePluck(message, -1);
+
+   fprintf(stdout, "reading 4 values from %zu bytes (us per message)\n", strlen(message));
+   fprintf(stdout, "   document        %8.1f\n", mallocTime);
+   fprintf(stdout, "   arena document  %8.1f   %.2fx\n", arenaTime, mallocTime / arenaTime);
+   fprintf(stdout, "   lazy document   %8.1f   %.2fx\n", lazyTime, mallocTime / lazyTime);
+
+   free(message);
+}
+
+/**
+ * Times parsing the large array of records while only keeping two of
+ * the 12 keys in each record
+ *
+ * @param records - The message to parse
+ * @param projection - The key paths to keep, or NULL to keep everything
+ * @param pairs - Set to the number of pairs in the document
+ * @return the number of milliseconds of the best round
+ */
+static double timeProjected(const char* records, JSONProjection_t* projection, int* pairs){
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(records);
+   double best = 0;
+   int round;
+
+   setJSONParserProjection(parser, projection);
+
+   for (round = 0; round < ROUNDS; ++round){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      double start = now();
+      if (parseJSONBuffer(parser, &document, records, length, &consumed)){
+         fprintf(stderr, "Unable to parse the records\n");
+         exit(1);
+      }
+      double elapsed = (now() - start) * 1e3;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+
+      *pairs = document->length;
+      for (JSONKeyValue_t* record = document->value->aVal; record; record = record->next){
+         *pairs += record->length;
+      }
+      disposeOfPair(document);
+   }
+
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Counts a key event for checkProjectedScalars
+ */
+static bool countKey(void* context, const char* key, size_t length){
+   (void)key;
+   (void)length;
+   ((int*)context)[0]++;
+   return true;
+}
+
+/**
+ * Counts a number event for checkProjectedScalars
+ */
+static bool countNumber(void* context, double value){
+   (void)value;
+   ((int*)context)[1]++;
+   return true;
+}
+
+/**
+ * Parses a message where a key on the way to a projected value has a
+ * scalar value, which is dropped along with its key. The document has to
+ * hold only the one object, and the events can not have a key without a
+ * value after it.
+ */
+static void checkProjectedScalars(void){
+   static const char* message = "{\"user\" : 5, \"x\" : 1, \"user\" : {\"id\" : 7, \"name\" : \"a\"}, \"user\" : \"s\"}";
+   static const int options[] = {PARSE_DEFAULT, PARSE_ARENA, PARSE_ARENA | PARSE_INTERN_KEYS};
+   JSONProjection_t* projection = newJSONProjection();
+   JSONCallbacks_t callbacks;
+   size_t length = strlen(message);
+   int counts[2] = {0, 0};
+   int passed = 0;
+   int checks = 0;
+   int i;
+   int round;
+
+   addJSONProjectionPath(projection, "user.id");
+
+   for (i = 0; i < (int)(sizeof(options) / sizeof(options[0])); ++i){
+      JSONParser_t* parser = newJSONParser();
+      setJSONParserOptions(parser, options[i]);
+      setJSONParserProjection(parser, projection);
+
+      //The second round reuses the arena the first one was recycled into
+      for (round = 0; round < 2; ++round){
+         JSONKeyValue_t* document = NULL;
+         size_t consumed = 0;
+         if (parseJSONBuffer(parser, &document, message, length, &consumed)){
+            fprintf(stderr, "Unable to parse the projected scalars\n");
+            exit(1);
+         }
+
+         JSONKeyValue_t* user = document->value->oVal;
+         checks++;
+         passed += (document->length == 1 && strcmp(user->key, "user") == 0 && user->length == 1 &&
+                    strcmp(user->value->oVal->key, "id") == 0);
+         recycleJSONDocument(parser, document);
+      }
+
+      disposeOfJSONParser(parser);
+   }
+
+   memset(&callbacks, 0, sizeof(callbacks));
+   callbacks.context = counts;
+   callbacks.key = countKey;
+   callbacks.number = countNumber;
+
+   JSONParser_t* parser = newJSONParser();
+   size_t consumed = 0;
+   setJSONParserProjection(parser, projection);
+   if (parseJSONEvents(parser, &callbacks, message, length, &consumed)){
+      fprintf(stderr, "Unable to parse the projected scalars\n");
+      exit(1);
+   }
+   checks++;
+   passed += (counts[0] == 2 && counts[1] == 1);
+
+   fprintf(stdout, "   scalar on the way         %d of %d\n", passed, checks);
+   if (passed != checks){
+      fprintf(stderr, "A key on the way to a projected value outlived its scalar value\n");
+      exit(1);
+   }
+
+   disposeOfJSONParser(parser);
+   disposeOfJSONProjection(projection);
+}
+
+/**
+ * Compares building every record in full with building only the two
+ * keys that are needed out of each one
+ */
+static void benchProjection(void){
+   char* records = makeRecords();
+   JSONProjection_t* projection = newJSONProjection();
+   int allPairs = 0;
+   int projectedPairs = 0;
+
+   addJSONProjectionPath(projection, "[*].user_id");
+   addJSONProjectionPath(projection, "[*].status");
+
+   double allTime = timeProjected(records, NULL, &allPairs);
+   double projectedTime = timeProjected(records, projection, &projectedPairs);
+
+   fprintf(stdout, "%d records, 2 of 12 keys (ms per document)\n", RECORD_COUNT);
+   fprintf(stdout, "   every key   %8.1f   %d pairs\n", allTime, allPairs);
+   fprintf(stdout, "   projected   %8.1f   %d pairs   %.2fx\n", projectedTime, projectedPairs, allTime / projectedTime);
+   checkProjectedScalars();
+
+   disposeOfJSONProjection(projection);
+   free(records);
+}
+
+/**
+ * Times checking the large array of records, either by parsing it into a
+ * document or with the validator
+ *
+ * @param records - The message to check
+ * @param options - The parser options to use, or -1 for the validator
+ * @return the number of milliseconds of the best round
+ */
+static double timeVerify(const char* records, int options){
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(records);
+   double best = 0;
+   int round;
+
+   if (options >= 0){
+      setJSONParserOptions(parser, options);
+   }
+
+   for (round = 0; round < ROUNDS; ++round){
+      size_t consumed = 0;
+      double start = now();
+      if (options < 0){
+         if (validateJSONBuffer(records, length, &consumed)){
+            fprintf(stderr, "Unable to validate the records\n");
+            exit(1);
+         }
+      }
+      else {
+         JSONKeyValue_t* document = NULL;
+         if (parseJSONBuffer(parser, &document, records, length, &consumed)){
+            fprintf(stderr, "Unable to parse the records\n");
+            exit(1);
+         }
+         recycleJSONDocument(parser, document);
+      }
+      double elapsed = (now() - start) * 1e3;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Checks that the validator agrees with the parser on surrogate pairs,
+ * which are one escape in a key, in keys and in values
+ */
+static void checkValidateSurrogates(void){
+   static const char* messages[] = {
+      "{\"\\ud83d\\ude00\" : 1}",
+      "{\"a\" : \"\\ud83d\\ude00\"}",
+      "{\"\\ud83d\\ude00\\n\\ud83d\\ude00\" : \"\\ud83d\\ude00\"}",
+      "{\"\\ud83d\" : 1}",
+      "{\"\\ude00\" : 1}"
+   };
+   int count = (int)(sizeof(messages) / sizeof(messages[0]));
+   int agreed = 0;
+   int i;
+
+   for (i = 0; i < count; ++i){
+      JSONParser_t* parser = newJSONParser();
+      JSONKeyValue_t* document = NULL;
+      size_t length = strlen(messages[i]);
+      size_t consumed = 0;
+      bool parsed = (parseJSONBuffer(parser, &document, messages[i], length, &consumed) == JSON_SUCCESS);
+      bool validated = (validateJSONBuffer(messages[i], length, &consumed) == JSON_SUCCESS);
+      agreed += (parsed == validated);
+
+      disposeOfPair(document);
+      disposeOfJSONParser(parser);
+   }
+
+   fprintf(stdout, "   surrogate pairs %d of %d\n", agreed, count);
+   if (agreed != count){
+      fprintf(stderr, "The validator and the parser disagree on a surrogate pair\n");
+      exit(1);
+   }
+}
+
+/**
+ * Compares verifying a message by parsing it with the validator
+ */
+static void benchVerify(void){
+   char* records = makeRecords();
+   double mallocTime = timeVerify(records, PARSE_DEFAULT);
+   double arenaTime = timeVerify(records, PARSE_ARENA);
+   double validateTime = timeVerify(records, -1);
+
+   fprintf(stdout, "verifying %d records (ms per document)\n", RECORD_COUNT);
+   fprintf(stdout, "   parsed          %8.1f\n", mallocTime);
+   fprintf(stdout, "   parsed, arena   %8.1f   %.2fx\n", arenaTime, mallocTime / arenaTime);
+   fprintf(stdout, "   validated       %8.1f   %.2fx\n", validateTime, mallocTime / validateTime);
+   checkValidateSurrogates();
+
+   free(records);
+}
+
+/**
+ * Creates newline delimited records, the same records as makeRecords()
+ * with one message on each line
+ *
+ * @return The messages, they must be freed
+ */
+static char* makeLines(void){
+   char* records = makeRecords();
+   size_t length = strlen(records);
+   size_t i;
+
+   //Drop the brackets, and put each record on its own line
+   memmove(records, records + 1, length - 2);
+   records[length - 2] = '\n';
+   records[length - 1] = '\0';
+   for (i = 1; i < length - 2; ++i){
+      if (records[i] == '{' && records[i - 1] == ','){
+         records[i - 1] = '\n';
+      }
+   }
+
+   return records;
+}
+
+/**
+ * Times parsing every line as a batch
+ *
+ * @param lines - The messages to parse
+ * @param threads - The number of threads to parse with, 0 to parse the
+ *    lines one after another on the calling thread
+ * @return the number of milliseconds of the best round
+ */
+static double timeBatch(const char* lines, int threads){
+   JSONThreadPool_t* pool = (threads) ? newJSONThreadPool(threads) : NULL;
+   size_t length = strlen(lines);
+   double best = 0;
+   int round;
+
+   for (round = 0; round < ROUNDS; ++round){
+      JSONBatch_t* batch = NULL;
+      double start = now();
+      if (parseJSONBatch(pool, &batch, lines, length, PARSE_DEFAULT) || batch->count != RECORD_COUNT || batch->failed){
+         fprintf(stderr, "Unable to parse the batch\n");
+         exit(1);
+      }
+      disposeOfJSONBatch(batch);
+      double elapsed = (now() - start) * 1e3;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   disposeOfJSONThreadPool(pool);
+   return best;
+}
+
+/**
+ * Compares parsing newline delimited records one after another with
+ * parsing them as a batch on more and more threads
+ */
+static void benchBatch(void){
+   char* lines = makeLines();
+   double serialTime = timeBatch(lines, 0);
+   int threads;
+
+   fprintf(stdout, "%d lines (ms per batch)\n", RECORD_COUNT);
+   fprintf(stdout, "   one after another %8.1f\n", serialTime);
+   for (threads = 1; threads <= 8; threads *= 2){
+      double batchTime = timeBatch(lines, threads);
+      fprintf(stdout, "   %d thread%s         %8.1f   %.2fx\n", threads, (threads > 1) ? "s" : " ",
+              batchTime, serialTime / batchTime);
+   }
+
+   free(lines);
+}
+
+/**
+ * Times parsing the large array of records with a thread pool
+ *
+ * @param records - The message to parse
+ * @param threads - The number of threads in the pool, 0 for no pool
+ * @return the number of milliseconds of the best round
+ */
+static double timeLargeArray(const char* records, int threads){
+   JSONThreadPool_t* pool = (threads) ? newJSONThreadPool(threads) : NULL;
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(records);
+   double best = 0;
+   int round;
+
+   setJSONParserOptions(parser, PARSE_ARENA);
+   setJSONParserThreadPool(parser, pool);
+
+   for (round = 0; round < ROUNDS; ++round){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      double start = now();
+      if (parseJSONBuffer(parser, &document, records, length, &consumed) || document->length != RECORD_COUNT){
+         fprintf(stderr, "Unable to parse the records\n");
+         exit(1);
+      }
+      recycleJSONDocument(parser, document);
+      double elapsed = (now() - start) * 1e3;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   disposeOfJSONParser(parser);
+   disposeOfJSONThreadPool(pool);
+   return best;
+}
+
+/**
+ * Parses the large array of records with interned keys, on the calling
+ * thread and with a pool of 4 threads, and checks that both documents
+ * point at the same interned keys. Once with PARSE_ARENA, where every
+ * record has to point at the same keys as the first record, and once with
+ * one key table shared by both parsers, where the two documents have to
+ * point at the very same strings.
+ *
+ * @param records - The message to parse
+ */
+static void checkInternedLargeArray(const char* records){
+   JSONThreadPool_t* pool = newJSONThreadPool(4);
+   JSONKeyTable_t* table = newJSONKeyTable();
+   JSONParser_t* serial = newJSONParser();
+   JSONParser_t* pooled = newJSONParser();
+   JSONKeyValue_t* serialDocument = NULL;
+   JSONKeyValue_t* pooledDocument = NULL;
+   size_t length = strlen(records);
+   size_t consumed = 0;
+   int keys = 0;
+   int found = 0;
+   int same = 0;
+
+   setJSONParserOptions(pooled, PARSE_ARENA | PARSE_INTERN_KEYS);
+   setJSONParserThreadPool(pooled, pool);
+   if (parseJSONBuffer(pooled, &pooledDocument, records, length, &consumed)){
+      fprintf(stderr, "Unable to parse the records\n");
+      exit(1);
+   }
+
+   JSONKeyValue_t* first = pooledDocument->value->aVal;
+   JSONKeyValue_t* record;
+   JSONKeyValue_t* pair;
+   for (record = first; record; record = record->next){
+      JSONKeyValue_t* firstPair = first->value->oVal;
+      for (pair = record->value->oVal; pair && firstPair; pair = pair->next, firstPair = firstPair->next){
+         keys++;
+         found += (pair->key == firstPair->key && (pair->flags & PAIR_KEY_INTERNED));
+      }
+   }
+   disposeOfPair(pooledDocument);
+   pooledDocument = NULL;
+
+   setJSONParserOptions(pooled, PARSE_DEFAULT);
+   setJSONParserKeyTable(serial, table);
+   setJSONParserKeyTable(pooled, table);
+   if (parseJSONBuffer(serial, &serialDocument, records, length, &consumed) ||
+       parseJSONBuffer(pooled, &pooledDocument, records, length, &consumed)){
+      fprintf(stderr, "Unable to parse the records\n");
+      exit(1);
+   }
+
+   JSONKeyValue_t* other = pooledDocument->value->aVal;
+   for (record = serialDocument->value->aVal; record && other; record = record->next, other = other->next){
+      JSONKeyValue_t* otherPair = other->value->oVal;
+      for (pair = record->value->oVal; pair && otherPair; pair = pair->next, otherPair = otherPair->next){
+         same += (pair->key == otherPair->key && (otherPair->flags & PAIR_KEY_INTERNED));
+      }
+   }
+
+   fprintf(stdout, "   interned keys, arena      %d of %d\n", found, keys);
+   fprintf(stdout, "   interned keys, shared     %d of %d\n", same, keys);
+   if (found != keys || same != keys){
+      fprintf(stderr, "The pool did not intern the keys the way the parser does\n");
+      exit(1);
+   }
+
+   disposeOfPair(serialDocument);
+   disposeOfPair(pooledDocument);
+   disposeOfJSONParser(serial);
+   disposeOfJSONParser(pooled);
+   disposeOfJSONKeyTable(table);
+   disposeOfJSONThreadPool(pool);
+}
+
+/**
+ * Compares parsing one large array on the calling thread with splitting
+ * its elements between more and more threads
+ */
+static void benchLargeArray(void){
+   char* records = makeRecords();
+   double serialTime = timeLargeArray(records, 0);
+   int threads;
+
+   fprintf(stdout, "array of %d records (ms per document)\n", RECORD_COUNT);
+   fprintf(stdout, "   one thread        %8.1f\n", serialTime);
+   for (threads = 2; threads <= 8; threads *= 2){
+      double poolTime = timeLargeArray(records, threads);
+      fprintf(stdout, "   %d threads         %8.1f   %.2fx\n", threads, poolTime, serialTime / poolTime);
+   }
+
+   checkInternedLargeArray(records);
+   free(records);
+}
+
+/**
+ * What the threads of the contention benchmark share
+ */
+typedef struct {
+   pthread_mutex_t* lock; /**< Held around each message when the work is serialized, or NULL */
+} ContentionJob_t;
+
+/**
+ * Parses and outputs the small message CONTENTION_COUNT times with a
+ * parser of its own. Every 16th message is cut short, and json_errno must
+ * hold this thread's error afterward no matter what the other threads
+ * are doing.
+ *
+ * @param context - The ContentionJob_t
+ * @param task - Not used, each task does the same work
+ */
+static void parseAndOutput(void* context, size_t task){
+   ContentionJob_t* job = (ContentionJob_t*)context;
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(smallMessage);
+   int i;
+
+   (void)task;
+   for (i = 0; i < CONTENTION_COUNT; ++i){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      bool truncated = ((i & 15) == 15);
+
+      if (job->lock){
+         pthread_mutex_lock(job->lock);
+      }
+
+      JSONError_t status = parseJSONBuffer(parser, &document, smallMessage, (truncated) ? length / 2 : length, &consumed);
+      if (truncated){
+         if (status != JSON_MESSAGE_INCOMPLETE || json_errno != JSON_MESSAGE_INCOMPLETE){
+            fprintf(stderr, "json_errno was changed by another thread\n");
+            exit(1);
+         }
+         resetParser(parser);
+      }
+      else {
+         char* output = NULL;
+         int outputLength = 0;
+         if (status || documentToString(document, &output, &outputLength)){
+            fprintf(stderr, "Unable to parse the benchmark message\n");
+            exit(1);
+         }
+         free(output);
+         recycleJSONDocument(parser, document);
+      }
+
+      if (job->lock){
+         pthread_mutex_unlock(job->lock);
+      }
+   }
+
+   disposeOfJSONParser(parser);
+}
+
+/**
+ * Times each of the threads parsing and outputting messages on its own
+ *
+ * @param threads - The number of threads
+ * @param serialize - Hold one lock around each message, the way callers
+ *    had to when json_errno was shared by every thread
+ * @return the number of messages per millisecond of the best round
+ */
+static double timeContention(int threads, bool serialize){
+   JSONThreadPool_t* pool = newJSONThreadPool(threads);
+   pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+   ContentionJob_t job = {(serialize) ? &lock : NULL};
+   double best = 0;
+   int round;
+
+   for (round = 0; round < ROUNDS; ++round){
+      double start = now();
+      runJSONThreadPool(pool, parseAndOutput, &job, threads);
+      double rate = (double)threads * CONTENTION_COUNT / ((now() - start) * 1e3);
+      if (round == 0 || rate > best){
+         best = rate;
+      }
+   }
+
+   disposeOfJSONThreadPool(pool);
+   return best;
+}
+
+/**
+ * Compares threads that parse and output messages independently with
+ * the same threads taking turns behind one lock
+ */
+static void benchContention(void){
+   double single = timeContention(1, false);
+   int threads;
+
+   fprintf(stdout, "parse and output on each thread (messages per ms)\n");
+   fprintf(stdout, "   threads    independent        locked\n");
+   for (threads = 1; threads <= 8; threads *= 2){
+      double independent = (threads == 1) ? single : timeContention(threads, false);
+      double locked = timeContention(threads, true);
+      fprintf(stdout, "   %-7d %8.1f %5.2fx %8.1f %5.2fx\n", threads, independent, independent / single,
+              locked, locked / single);
+   }
+}
+
+/**
+ * Builds a feature flag document. Every flag is an object that holds
+ * nothing but booleans and nulls.
+ *
+ * @return The message, it must be freed
+ */
+static char* makeFlags(void){
+   size_t size = (size_t)FLAG_COUNT * 96;
+   char* message = malloc(size);
+   size_t length = 0;
+   int i;
+
+   if (!message){
+      fprintf(stderr, "Unable to allocate the flags\n");
+      exit(1);
+   }
+
+   length += sprintf(message + length, "{");
+   for (i = 0; i < FLAG_COUNT; ++i){
+      length += sprintf(message + length, "%s\"flag%d\":{\"enabled\":%s,\"beta\":%s,\"rollout\":null,\"sticky\":%s}",
+                        (i) ? "," : "", i, (i % 3) ? "true" : "false", (i % 5) ? "false" : "true",
+                        (i % 2) ? "true" : "false");
+   }
+   sprintf(message + length, "}");
+
+   return message;
+}
+
+/**
+ * Times parsing the feature flags
+ *
+ * @param flags - The message to parse
+ * @param events - Only send events to empty callbacks instead of building
+ *    the document, so the time is mostly spent reading the literals
+ * @return the number of nanoseconds per flag of the best round
+ */
+static double timeFlags(const char* flags, bool events){
+   JSONParser_t* parser = newJSONParser();
+   JSONCallbacks_t callbacks;
+   size_t length = strlen(flags);
+   double best = 0;
+   int round;
+
+   memset(&callbacks, 0, sizeof(callbacks));
+   setJSONParserOptions(parser, PARSE_ARENA);
+
+   for (round = 0; round < ROUNDS; ++round){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      double start = now();
+      JSONError_t status = (events) ? parseJSONEvents(parser, &callbacks, flags, length, &consumed) :
+                                      parseJSONBuffer(parser, &document, flags, length, &consumed);
+      if (status){
+         fprintf(stderr, "Unable to parse the flags\n");
+         exit(1);
+      }
+      recycleJSONDocument(parser, document);
+      double elapsed = (now() - start) * 1e9 / FLAG_COUNT;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Times parsing a document that is mostly true, false, and null
+ */
+static void benchFlags(void){
+   char* flags = makeFlags();
+
+   fprintf(stdout, "%d feature flags, 4 literals each (ns per flag)\n", FLAG_COUNT);
+   fprintf(stdout, "   document        %8.1f\n", timeFlags(flags, false));
+   fprintf(stdout, "   events only     %8.1f\n", timeFlags(flags, true));
+
+   free(flags);
+}
+
+/**
+ * Builds an array of strings that are full of escape sequences, the way
+ * text from other languages looks when it was written by an encoder that
+ * only writes ASCII.
+ *
+ * @return The message, it must be freed
+ */
+static char* makeText(void){
+   size_t size = (size_t)TEXT_COUNT * 96;
+   char* message = malloc(size);
+   size_t length = 0;
+   int i;
+
+   if (!message){
+      fprintf(stderr, "Unable to allocate the text\n");
+      exit(1);
+   }
+
+   length += sprintf(message + length, "[");
+   for (i = 0; i < TEXT_COUNT; ++i){
+      length += sprintf(message + length, "%s\"caf\\u00e9 %d \\u2014 \\\"quoted\\\"\\n\\ud83d\\ude00 line %d\"",
+                        (i) ? "," : "", i, i % 7);
+   }
+   sprintf(message + length, "]");
+
+   return message;
+}
+
+/**
+ * Times getting the text out of the strings, either by converting each
+ * string with convertString() after parsing, or by parsing with
+ * PARSE_DECODE_STRINGS.
+ *
+ * @param text - The message to parse
+ * @param decode - Decode the strings while parsing
+ * @return the number of nanoseconds per string of the best round
+ */
+static double timeText(const char* text, bool decode){
+   JSONParser_t* parser = newJSONParser();
+   size_t length = strlen(text);
+   double best = 0;
+   size_t bytes = 0;
+   int round;
+
+   setJSONParserOptions(parser, (decode) ? PARSE_DECODE_STRINGS : PARSE_DEFAULT);
+
+   for (round = 0; round < ROUNDS; ++round){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      double start = now();
+      if (parseJSONBuffer(parser, &document, text, length, &consumed)){
+         fprintf(stderr, "Unable to parse the text\n");
+         exit(1);
+      }
+
+      for (JSONKeyValue_t* pair = document->value->aVal; pair; pair = pair->next){
+         if (decode){
+            bytes += strlen(pair->value->sVal);
+         }
+         else {
+            char* converted = NULL;
+            convertString(pair->value->sVal, &converted);
+            bytes += strlen(converted);
+            free(converted);
+         }
+      }
+
+      recycleJSONDocument(parser, document);
+      double elapsed = (now() - start) * 1e9 / TEXT_COUNT;
+      if (round == 0 || elapsed < best){
+         best = elapsed;
+      }
+   }
+
+   if (!bytes){
+      fprintf(stderr, "No text was decoded\n");
+   }
+
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Times getting decoded text out of escaped strings
+ */
+static void benchText(void){
+   char* text = makeText();
+
+   fprintf(stdout, "%d escaped strings (ns per string)\n", TEXT_COUNT);
+   fprintf(stdout, "   convertString   %8.1f\n", timeText(text, false));
+   fprintf(stdout, "   decode on parse %8.1f\n", timeText(text, true));
+
+   free(text);
+}
+
+/**
+ * Builds an array of strings in a mix of scripts, so most of the bytes in
+ * the strings are parts of multibyte UTF-8 sequences
+ *
+ * @return The message, it must be freed
+ */
+static char* makeUnicode(void){
+   static const char* words[] = {"caf\xc3\xa9", "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82",
+                                 "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", "\xf0\x9f\x98\x80",
+                                 "\xce\xb1\xce\xb2\xce\xb3", "na\xc3\xafve"};
+   size_t size = (size_t)UTF8_COUNT * 128;
+   char* message = malloc(size);
+   size_t length = 0;
+   int i, j;
+
+   if (!message){
+      fprintf(stderr, "Unable to allocate the unicode text\n");
+      exit(1);
+   }
+
+   length += sprintf(message + length, "[");
+   for (i = 0; i < UTF8_COUNT; ++i){
+      length += sprintf(message + length, "%s\"", (i) ? "," : "");
+      for (j = 0; j < 8; ++j){
+         length += sprintf(message + length, "%s ", words[(i + j) % 6]);
+      }
+      length += sprintf(message + length, "\"");
+   }
+   sprintf(message + length, "]");
+
+   return message;
+}
+
+/**
+ * Compares parsing with and without checking that every string is well
+ * formed UTF-8, for mostly ASCII records and for text in other scripts
+ */
+static void benchStrictUTF8(void){
+   char* records = makeRecords();
+   char* unicode = makeUnicode();
+   double recordTime = timeRecords(records, PARSE_ARENA);
+   double recordStrict = timeRecords(records, PARSE_ARENA | PARSE_STRICT_UTF8);
+   double unicodeTime = timeRecords(unicode, PARSE_ARENA);
+   double unicodeStrict = timeRecords(unicode, PARSE_ARENA | PARSE_STRICT_UTF8);
+
+   fprintf(stdout, "Strict UTF-8 (ms per document)\n");
+   fprintf(stdout, "   records              %8.1f\n", recordTime);
+   fprintf(stdout, "   records, strict      %8.1f   %.2fx\n", recordStrict, recordTime / recordStrict);
+   fprintf(stdout, "   unicode text         %8.1f   %.1f MB/s\n", unicodeTime, strlen(unicode) / unicodeTime / 1e3);
+   fprintf(stdout, "   unicode text, strict %8.1f   %.2fx\n", unicodeStrict, unicodeTime / unicodeStrict);
+
+   free(records);
+   free(unicode);
+}
+
+/**
+ * Adds up every number under a pair by following the pointers
+ *
+ * @param pair - The pair to walk
+ * @return The sum of the numbers
+ */
+static double sumPairs(JSONKeyValue_t* pair){
+   double sum = 0;
+
+   if (pair->type == NUMBER){
+      return pair->value->nVal;
+   }
+
+   if ((pair->type == OBJECT || pair->type == ARRAY) && pair->value){
+      for (JSONKeyValue_t* child = pair->value->oVal; child; child = child->next){
+         sum += sumPairs(child);
+      }
+   }
+
+   return sum;
+}
+
+/**
+ * Times parsing the large array of records into a document or onto a
+ * tape, and then adding up every number in it
+ *
+ * @param records - The message to parse
+ * @param useTape - Parse onto a tape instead of building a document
+ * @param walkTime - Set to the number of milliseconds the best walk took
+ * @return the number of milliseconds of the best parse
+ */
+static double timeTape(const char* records, bool useTape, double* walkTime){
+   JSONParser_t* parser = newJSONParser();
+   JSONTape_t* tape = newJSONTape();
+   size_t length = strlen(records);
+   double best = 0;
+   double sum = 0;
+   int round;
+
+   setJSONParserOptions(parser, PARSE_ARENA | PARSE_DECODE_STRINGS);
+
+   for (round = 0; round < ROUNDS; ++round){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      double start = now();
+      JSONError_t status = (useTape) ? parseJSONTape(parser, tape, records, length, &consumed) :
+                                       parseJSONBuffer(parser, &document, records, length, &consumed);
+      if (status){
+         fprintf(stderr, "Unable to parse the records\n");
+         exit(1);
+      }
+      double parsed = now();
+
+      if (useTape){
+         for (size_t word = 0; word < tape->count; ++word){
+            if (TAPE_TAG(tape->words[word]) == TAPE_NUMBER){
+               double number;
+               memcpy(&number, &tape->words[++word], sizeof(double));
+               sum += number;
+            }
+         }
+      }
+      else {
+         sum += sumPairs(document);
+      }
+      double walked = now();
+
+      recycleJSONDocument(parser, document);
+      if (round == 0 || (parsed - start) * 1e3 < best){
+         best = (parsed - start) * 1e3;
+      }
+      if (round == 0 || (walked - parsed) * 1e3 < *walkTime){
+         *walkTime = (walked - parsed) * 1e3;
+      }
+   }
+
+   if (sum == 0){
+      fprintf(stderr, "Read the wrong values\n");
+   }
+
+   disposeOfJSONTape(tape);
+   disposeOfJSONParser(parser);
+   return best;
+}
+
+/**
+ * Parses a projected message onto a tape. Scalars under a key on the way
+ * to a projected value are dropped with their keys, so the tape has to
+ * hold nothing but user.id.
+ */
+static void checkProjectedTape(void){
+   static const char* message = "{\"user\" : 5, \"x\" : 1, \"user\" : {\"id\" : 7, \"name\" : \"a\"}, \"user\" : \"s\"}";
+   JSONProjection_t* projection = newJSONProjection();
+   JSONParser_t* parser = newJSONParser();
+   JSONTape_t* tape = newJSONTape();
+   size_t consumed = 0;
+
+   addJSONProjectionPath(projection, "user.id");
+   setJSONParserProjection(parser, projection);
+   if (parseJSONTape(parser, tape, message, strlen(message), &consumed)){
+      fprintf(stderr, "Unable to parse the projected tape\n");
+      exit(1);
+   }
+
+   JSONTapeValue_t root = getTapeRoot(tape);
+   JSONTapeValue_t user = getTapeChild(root, "user");
+   bool passed = (getTapeLength(root) == 1 && getTapeLength(user) == 1 &&
+                  getTapeNumberVal(getTapeChild(user, "id")) == 7);
+
+   fprintf(stdout, "   projected tape       %s\n", (passed) ? "ok" : "wrong");
+   if (!passed){
+      fprintf(stderr, "The projected tape does not match the projection\n");
+      exit(1);
+   }
+
+   disposeOfJSONTape(tape);
+   disposeOfJSONParser(parser);
+   disposeOfJSONProjection(projection);
+}
+
+/**
+ * Compares building the records into pairs with writing them onto a tape,
+ * and walking every value of each
+ */
+static void benchTape(void){
+   char* records = makeRecords();
+   double documentWalk = 0;
+   double tapeWalk = 0;
+   double documentTime = timeTape(records, false, &documentWalk);
+   double tapeTime = timeTape(records, true, &tapeWalk);
+
+   fprintf(stdout, "%d records on a tape (ms per document)\n", RECORD_COUNT);
+   fprintf(stdout, "   arena document       %8.1f   walk %6.2f\n", documentTime, documentWalk);
+   fprintf(stdout, "   tape                 %8.1f   walk %6.2f   %.2fx   walk %.2fx\n",
+           tapeTime, tapeWalk, documentTime / tapeTime, documentWalk / tapeWalk);
+   checkProjectedTape();
+
+   free(records);
+}
+
+/*------------------------------------------------------------------
+ * Main function for the benchmarks
+ *-----------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+   (void)argc;
+   (void)argv;
+
+   benchNumbers();
+   benchDocuments();
+   benchRecords();
+   benchBuilder();
+   benchAppend();
+   benchPluck();
+   benchProjection();
+   benchVerify();
+   benchBatch();
+   benchLargeArray();
+   benchContention();
+   benchFlags();
+   benchText();
+   benchStrictUTF8();
+   benchTape();
+
+   return 0;
+}
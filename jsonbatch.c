@@ -0,0 +1,877 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "jsontools.h"
+#include "jsonscan.h"
+
+/**
+ * A piece of the buffer that is parsed by one task. Each range starts on
+ * a line that looks like the start of a message, which is only a guess
+ * until the range before it is finished. If the message before the range
+ * does not end where the range starts, the range is parsed again from the
+ * right place.
+ */
+typedef struct {
+   size_t start;                   /**< Where the first message of the range starts */
+   size_t end;                     /**< Messages that start before this belong to the range */
+   size_t stop;                    /**< Where the message after the range starts */
+   JSONBatchDocument_t* documents; /**< The messages parsed from the range */
+   size_t count;                   /**< How many messages were parsed */
+   size_t capacity;                /**< How many messages fit before the list has to grow */
+   JSONParser_t* parser;           /**< The parser the range is parsed with */
+   JSONError_t status;             /**< JSON_MALLOC_FAIL if the range could not be parsed at all */
+} JSONBatchRange_t;
+
+/**
+ * Everything the tasks of a batch share.
+ */
+typedef struct {
+   const char* message;       /**< The buffer of messages */
+   size_t length;             /**< The length of the buffer */
+   int options;               /**< The options each parser is given */
+   JSONBatchRange_t* ranges;  /**< One for each task */
+} JSONBatchJob_t;
+
+/**
+ * A piece of a large array that is scanned on its own, to find where the
+ * array ends and where its elements can be cut apart. The depths are
+ * counted from the start of the chunk, since how deep the chunk starts is
+ * not known until the chunks before it have been scanned.
+ */
+typedef struct {
+   size_t start;                 /**< The first byte of the chunk */
+   size_t end;                   /**< One past the last byte of the chunk */
+   bool inString;                /**< The chunk starts inside of a string */
+   bool escaped;                 /**< The first byte of the chunk is escaped */
+   bool endsInString;            /**< The chunk ends inside of a string */
+   bool scanned;                 /**< The chunk has been scanned from the right string state */
+   int depth;                    /**< How much deeper the chunk ends than it starts */
+   size_t comma[MAX_DEPTH + 1];  /**< comma[d] is the first ',' found d levels above the start, SIZE_MAX if there is none */
+   size_t close[MAX_DEPTH + 1];  /**< close[d] is where the chunk first closes d levels above the start, SIZE_MAX if it never does */
+} JSONArrayChunk_t;
+
+/**
+ * A run of elements of a large array that is parsed by one task.
+ */
+typedef struct {
+   size_t start;              /**< The first byte after the ',' (or '[') before the elements */
+   size_t end;                /**< The ',' (or ']') after the elements */
+   JSONKeyValue_t* document;  /**< An array holding just these elements */
+   JSONKeyValue_t* tail;      /**< The last of the elements */
+   JSONError_t status;        /**< JSON_SUCCESS if the elements were parsed */
+} JSONArrayRange_t;
+
+/**
+ * Everything the tasks that split up and parse a large array share.
+ */
+typedef struct {
+   JSONParser_t* parser;      /**< The parser that was asked to parse the array */
+   const char* message;       /**< The message holding the array */
+   size_t open;               /**< Where the '[' of the array is */
+   JSONArrayChunk_t* chunks;  /**< The chunks of the piece being scanned */
+   size_t* cuts;              /**< The ',' characters the elements are cut apart at */
+   size_t cutCount;           /**< How many cuts there are */
+   size_t cutCapacity;        /**< How many cuts fit before the list has to grow */
+   JSONArrayRange_t* ranges;  /**< The runs of elements between the cuts */
+} JSONArrayJob_t;
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static void splitRanges(JSONBatchJob_t* job, size_t rangeCount);
+static void parseRangeTask(void* context, size_t task);
+static void parseRange(JSONBatchJob_t* job, JSONBatchRange_t* range);
+static JSONError_t addDocument(JSONBatchRange_t* range, JSONKeyValue_t* document, JSONError_t status, size_t offset);
+static void dropDocuments(JSONBatchRange_t* range);
+static size_t findMessageLine(const char* message, size_t index, size_t length);
+static JSONError_t collectRanges(JSONBatchJob_t* job, size_t rangeCount, JSONBatch_t* batch);
+static bool canSplitArray(JSONParser_t* parser, const char* message, size_t length);
+static JSONError_t splitArray(JSONArrayJob_t* job, size_t length, size_t* close);
+static void scanChunkTask(void* context, size_t task);
+static JSONError_t addCut(JSONArrayJob_t* job, size_t cut);
+static void parseElementsTask(void* context, size_t task);
+static JSONError_t parseElements(JSONArrayJob_t* job, JSONArrayRange_t* range);
+static JSONError_t feedElements(JSONParser_t* parser, JSONKeyValue_t** document, const char* chunk, size_t length, size_t* consumed);
+static JSONError_t joinRanges(JSONArrayJob_t* job, size_t rangeCount, JSONKeyValue_t** document);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Parses every message in a buffer of concatenated or newline delimited
+ * messages, using the threads of a pool to parse different parts of the
+ * buffer at the same time. The buffer is cut into ranges at lines that
+ * start with '{' or '[', and each range is parsed by a single task, one
+ * message after another just like nextJSONDocument(). When a range turns
+ * out to have started in the middle of a message (a pretty printed message,
+ * or a string holding a new line) it is parsed again from where the range
+ * before it really ended, so the documents are always the same as parsing
+ * the buffer from start to finish.
+ *
+ * A message that can not be parsed is kept in the batch with its error,
+ * and parsing picks up again at the next line that starts with '{' or '['.
+ *
+ * The message is only read, so PARSE_IN_SITU can not be used. The other
+ * options work the same as they do for setJSONParserOptions().
+ *
+ * @param pool - The threads to parse with, or NULL to parse on the calling thread
+ * @param batch - Where the new batch is placed, dispose of it with disposeOfJSONBatch()
+ * @param message - The buffer of messages, it must outlive the batch
+ * @param length - The number of bytes in the buffer
+ * @param options - PARSE_DEFAULT, or a combination of JSONParseOptions_t values
+ * @return JSON_SUCCESS if the buffer was parsed (even if some messages
+ *    were bad), JSON_NULL_ARGUMENT, JSON_INVALID_ARGUMENT, or JSON_MALLOC_FAIL
+ */
+JSONError_t parseJSONBatch(JSONThreadPool_t* pool, JSONBatch_t** batch, const char* message, size_t length, int options){
+   if (!batch || (!message && length > 0)){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (options & PARSE_IN_SITU){
+      //Two ranges could be writing to the same message while one of them is guessing
+      json_errno = JSON_INVALID_ARGUMENT;
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   size_t rangeCount = 1;
+   if (pool){
+      rangeCount = (size_t)pool->threadCount * BATCH_RANGES_PER_THREAD;
+      if (rangeCount > length / BATCH_MIN_RANGE_SIZE + 1){
+         rangeCount = length / BATCH_MIN_RANGE_SIZE + 1;
+      }
+   }
+
+   JSONBatchJob_t job;
+   job.message = message;
+   job.length = length;
+   job.options = options;
+   job.ranges = (JSONBatchRange_t*)calloc(rangeCount, sizeof(JSONBatchRange_t));
+   if (!job.ranges){
+      json_errno = JSON_MALLOC_FAIL;
+      return JSON_MALLOC_FAIL;
+   }
+
+   splitRanges(&job, rangeCount);
+   if (pool && rangeCount > 1){
+      runJSONThreadPool(pool, parseRangeTask, &job, rangeCount);
+   }
+   else {
+      parseRangeTask(&job, 0);
+   }
+
+   //Check each guess against where the range before it really ended
+   size_t i;
+   size_t expected = job.ranges[0].stop;
+   for (i = 1; i < rangeCount; ++i){
+      JSONBatchRange_t* range = &job.ranges[i];
+      if (range->start != expected){
+         range->start = expected;
+         parseRange(&job, range);
+      }
+      expected = range->stop;
+   }
+
+   JSONBatch_t* newBatch = (JSONBatch_t*)calloc(1, sizeof(JSONBatch_t));
+   JSONError_t returnStatus = (newBatch) ? collectRanges(&job, rangeCount, newBatch) : JSON_MALLOC_FAIL;
+
+   if (returnStatus){
+      //Whatever was parsed is thrown away with the ranges
+      free(newBatch);
+      for (i = 0; i < rangeCount; ++i){
+         dropDocuments(&job.ranges[i]);
+         free(job.ranges[i].documents);
+         disposeOfJSONParser(job.ranges[i].parser);
+      }
+      free(job.ranges);
+      json_errno = returnStatus;
+      return returnStatus;
+   }
+
+   for (i = 0; i < rangeCount; ++i){
+      free(job.ranges[i].documents);
+   }
+   free(job.ranges);
+
+   *batch = newBatch;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Frees a batch, its documents, and the parsers that built them.
+ *
+ * @param batch - The batch that was created by parseJSONBatch()
+ */
+void disposeOfJSONBatch(JSONBatch_t* batch){
+   if (!batch){
+      return;
+   }
+
+   size_t i;
+   for (i = 0; i < batch->count; ++i){
+      disposeOfPair(batch->documents[i].document);
+   }
+
+   //The documents may point at keys the parsers interned, so they go last
+   for (i = 0; i < batch->parserCount; ++i){
+      disposeOfJSONParser(batch->parsers[i]);
+   }
+
+   free(batch->documents);
+   free(batch->parsers);
+   free(batch);
+}
+
+/**
+ * Parses a large array by splitting its elements between the threads of
+ * the parsers pool (see setJSONParserThreadPool). The array is scanned in
+ * chunks on the threads first, to find where it ends and to find commas
+ * between its elements that it can be cut at. Each run of elements is then
+ * parsed on its own parser, and the runs are joined into one array in
+ * order. With PARSE_ARENA the arenas of the runs are merged into the
+ * arena of the document.
+ *
+ * This only takes on arrays that are worth splitting and that it can build
+ * exactly the way the parser would. If the array is too small, or any part
+ * of it can not be parsed, nothing is built and JSON_FAIL is returned so
+ * the parser can parse the message itself (and report any error the way
+ * it always does). The exception is PARSE_IN_SITU, where the threads may
+ * already have written to the message, so the error from the first run of
+ * elements that could not be parsed is returned instead.
+ *
+ * @param parser - The parser, its index has to be on the '[' of the array
+ * @param message - The message holding the array
+ * @param length - The length of the message
+ * @param document - Where the new document is placed
+ * @return JSON_SUCCESS with the parsers index just past the array,
+ *    JSON_FAIL if the array has to be parsed by the parser instead, or
+ *    an error with PARSE_IN_SITU
+ */
+JSONError_t parseJSONArrayInParallel(JSONParser_t* parser, const char* message, size_t length, JSONKeyValue_t** document){
+   if (!parser || !document || !message || !canSplitArray(parser, message, length)){
+      return JSON_FAIL;
+   }
+
+   size_t chunkCount = (size_t)parser->pool->threadCount * PARALLEL_CHUNKS_PER_THREAD;
+   JSONArrayJob_t job;
+   memset(&job, 0, sizeof(JSONArrayJob_t));
+   job.parser = parser;
+   job.message = message;
+   job.open = parser->index;
+   job.chunks = (JSONArrayChunk_t*)malloc(sizeof(JSONArrayChunk_t) * chunkCount);
+   if (!job.chunks){
+      return JSON_FAIL;
+   }
+
+   size_t close = 0;
+   JSONError_t returnStatus = splitArray(&job, length, &close);
+   free(job.chunks);
+
+   size_t rangeCount = job.cutCount + 1;
+   if (!returnStatus){
+      job.ranges = (JSONArrayRange_t*)calloc(rangeCount, sizeof(JSONArrayRange_t));
+      returnStatus = (job.ranges) ? JSON_SUCCESS : JSON_FAIL;
+   }
+
+   if (!returnStatus){
+      size_t i;
+      for (i = 0; !returnStatus && i < rangeCount; ++i){
+         JSONArrayRange_t* range = &job.ranges[i];
+         range->start = (i) ? job.cuts[i - 1] + 1 : job.open + 1;
+         range->end = (i < job.cutCount) ? job.cuts[i] : close;
+
+         //Two commas in a row (or one before the ']') leave a run with no elements
+         size_t first = range->start;
+         while (first < range->end && isspace((unsigned char)message[first])){
+            first++;
+         }
+         returnStatus = (first < range->end) ? JSON_SUCCESS : JSON_FAIL;
+      }
+   }
+
+   if (!returnStatus){
+      runJSONThreadPool(parser->pool, parseElementsTask, &job, rangeCount);
+      returnStatus = joinRanges(&job, rangeCount, document);
+
+      if (returnStatus && !(parser->options & PARSE_IN_SITU)){
+         //Nothing has changed, so the parser can find the error itself
+         returnStatus = JSON_FAIL;
+      }
+   }
+
+   free(job.ranges);
+
+   free(job.cuts);
+   if (!returnStatus){
+      parser->index = close + 1;
+   }
+
+   return returnStatus;
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Cuts the buffer into ranges of about the same size. Each range after
+ * the first starts at the first line that starts with '{' or '[' past its
+ * share of the buffer. A range can be empty if there is no such line
+ * before the next share starts.
+ *
+ * @param job - The batch being parsed
+ * @param rangeCount - How many ranges to cut the buffer into
+ */
+static void splitRanges(JSONBatchJob_t* job, size_t rangeCount){
+   size_t start = 0;
+   size_t i;
+
+   job->ranges[0].start = 0;
+   for (i = 1; i < rangeCount; ++i){
+      size_t share = (size_t)((double)job->length * i / rangeCount);
+      if (start < share){
+         //The new line just before the share counts, it could start a message right at the share
+         start = findMessageLine(job->message, share - 1, job->length);
+      }
+
+      job->ranges[i].start = start;
+      job->ranges[i - 1].end = start;
+   }
+
+   job->ranges[rangeCount - 1].end = job->length;
+}
+
+/**
+ * Parses one of the ranges of a batch, this is run on the thread pool.
+ *
+ * @param context - The batch being parsed
+ * @param task - The range to parse
+ */
+static void parseRangeTask(void* context, size_t task){
+   JSONBatchJob_t* job = (JSONBatchJob_t*)context;
+   parseRange(job, &job->ranges[task]);
+}
+
+/**
+ * Parses the messages that start in a range, one after another, starting
+ * at range->start. The last message can run past the end of the range,
+ * range->stop is set to where the message after it starts. Anything the
+ * range held from an earlier try is thrown away first.
+ *
+ * @param job - The batch being parsed
+ * @param range - The range to parse
+ */
+static void parseRange(JSONBatchJob_t* job, JSONBatchRange_t* range){
+   dropDocuments(range);
+   range->status = JSON_SUCCESS;
+   range->stop = range->start;
+
+   if (range->start >= range->end){
+      return;
+   }
+
+   if (!range->parser){
+      range->parser = newJSONParser();
+      if (!range->parser || setJSONParserOptions(range->parser, job->options)){
+         range->status = JSON_MALLOC_FAIL;
+         return;
+      }
+   }
+
+   size_t offset = range->start;
+   while (offset < range->end){
+      JSONKeyValue_t* document = NULL;
+      size_t consumed = 0;
+      JSONError_t status = parseJSONBuffer(range->parser, &document, &job->message[offset],
+                                           job->length - offset, &consumed);
+      if (status){
+         //Start over at the next line that could be a message
+         resetParser(range->parser);
+         document = NULL;
+         consumed = findMessageLine(job->message, offset, job->length) - offset;
+      }
+
+      if (addDocument(range, document, status, offset)){
+         disposeOfPair(document);
+         range->status = JSON_MALLOC_FAIL;
+         return;
+      }
+
+      offset += consumed;
+   }
+
+   range->stop = offset;
+}
+
+/**
+ * Adds a message to the end of a range, growing its list if needed.
+ *
+ * @param range - The range the message was found in
+ * @param document - The document, or NULL if the message could not be parsed
+ * @param status - What happened when the message was parsed
+ * @param offset - Where the message starts in the buffer
+ * @return JSON_SUCCESS, or JSON_MALLOC_FAIL
+ */
+static JSONError_t addDocument(JSONBatchRange_t* range, JSONKeyValue_t* document, JSONError_t status, size_t offset){
+   if (range->count == range->capacity){
+      size_t capacity = (range->capacity) ? range->capacity * 2 : 64;
+      JSONBatchDocument_t* documents = (JSONBatchDocument_t*)realloc(range->documents, sizeof(JSONBatchDocument_t) * capacity);
+      if (!documents){
+         return JSON_MALLOC_FAIL;
+      }
+
+      range->documents = documents;
+      range->capacity = capacity;
+   }
+
+   JSONBatchDocument_t* entry = &range->documents[range->count++];
+   entry->document = document;
+   entry->status = status;
+   entry->offset = offset;
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Disposes of every document a range has parsed, the list is kept so it
+ * can be filled again.
+ *
+ * @param range - The range to empty
+ */
+static void dropDocuments(JSONBatchRange_t* range){
+   size_t i;
+   for (i = 0; i < range->count; ++i){
+      disposeOfPair(range->documents[i].document);
+   }
+
+   range->count = 0;
+}
+
+/**
+ * Finds the next line that starts with '{' or '[', since that is where
+ * messages start in newline delimited (and most other) buffers.
+ *
+ * @param message - The buffer of messages
+ * @param index - Where to start looking, this can be the new line before the line
+ * @param length - The length of the buffer
+ * @return The index of the '{' or '[', or length if there is no such line
+ */
+static size_t findMessageLine(const char* message, size_t index, size_t length){
+   while (index < length){
+      const char* newLine = (const char*)memchr(&message[index], '\n', length - index);
+      if (!newLine){
+         break;
+      }
+
+      index = (size_t)(newLine - message) + 1;
+      if (index < length && (message[index] == '{' || message[index] == '[')){
+         return index;
+      }
+   }
+
+   return length;
+}
+
+/**
+ * Moves the documents from every range into the batch, in order, along
+ * with the parsers that built them.
+ *
+ * @param job - The batch that was parsed
+ * @param rangeCount - How many ranges there are
+ * @param batch - The batch to fill in
+ * @return JSON_SUCCESS, or JSON_MALLOC_FAIL
+ */
+static JSONError_t collectRanges(JSONBatchJob_t* job, size_t rangeCount, JSONBatch_t* batch){
+   size_t count = 0;
+   size_t i;
+
+   for (i = 0; i < rangeCount; ++i){
+      if (job->ranges[i].status){
+         return job->ranges[i].status;
+      }
+      count += job->ranges[i].count;
+   }
+
+   batch->documents = (JSONBatchDocument_t*)malloc(sizeof(JSONBatchDocument_t) * (count + 1));
+   batch->parsers = (JSONParser_t**)malloc(sizeof(JSONParser_t*) * rangeCount);
+   if (!batch->documents || !batch->parsers){
+      free(batch->documents);
+      free(batch->parsers);
+      return JSON_MALLOC_FAIL;
+   }
+
+   for (i = 0; i < rangeCount; ++i){
+      JSONBatchRange_t* range = &job->ranges[i];
+      size_t j;
+
+      for (j = 0; j < range->count; ++j){
+         batch->documents[batch->count++] = range->documents[j];
+         if (range->documents[j].status){
+            batch->failed++;
+         }
+      }
+
+      if (range->parser){
+         batch->parsers[batch->parserCount++] = range->parser;
+      }
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Checks that an array can be split up exactly the way the parser would
+ * build it, and that it is big enough for that to be worth it.
+ *
+ * @param parser - The parser, its index has to be on the '['
+ * @param message - The message holding the array
+ * @param length - The length of the message
+ * @return true if the array can be split
+ */
+static bool canSplitArray(JSONParser_t* parser, const char* message, size_t length){
+   if (!parser->pool || parser->pool->threadCount < 2 || parser->callbacks || parser->projection || parser->maxDepth > MAX_DEPTH){
+      return false;
+   }
+
+   if (parser->keyTable){
+      //Each range would intern its keys in a table of its own, so the same key
+      //would end up at a different address in each range, and none of them in
+      //the parsers table
+      return false;
+   }
+
+   return message[parser->index] == '[' && length - parser->index >= PARALLEL_MIN_SIZE;
+}
+
+/**
+ * Scans the array for where it ends, and for the commas between its
+ * elements that it can be cut at. The first PARALLEL_MIN_SIZE bytes are
+ * scanned on the calling thread, and if the array ends there it is not
+ * split. After that the message is scanned a piece at a time, each piece
+ * twice as big as the last, so a small array at the start of a large
+ * buffer does not cost a scan of the whole buffer. Each piece is cut into
+ * chunks that are scanned on the pool, at most one cut is taken from each.
+ *
+ * A chunk is first scanned as if it starts outside of a string. Since the
+ * quotes in a chunk are the same either way, how many there are tells the
+ * next chunk whether it starts in a string, and the chunks that guessed
+ * wrong are scanned again.
+ *
+ * @param job - The array being split
+ * @param length - The length of the message
+ * @param close - Where the ']' that ends the array is
+ * @return JSON_SUCCESS, or JSON_FAIL if the array should not be split
+ */
+static JSONError_t splitArray(JSONArrayJob_t* job, size_t length, size_t* close){
+   JSONThreadPool_t* pool = job->parser->pool;
+   size_t chunkLimit = (size_t)pool->threadCount * PARALLEL_CHUNKS_PER_THREAD;
+   size_t position = job->open + 1;
+   size_t pieceSize = PARALLEL_MIN_SIZE;
+   bool inString = false;
+   int depth = 1;
+
+   while (position < length){
+      size_t size = (length - position < pieceSize) ? length - position : pieceSize;
+      size_t chunkCount = (position == job->open + 1) ? 1 : size / PARALLEL_MIN_CHUNK_SIZE;
+      size_t i;
+
+      if (chunkCount > chunkLimit){
+         chunkCount = chunkLimit;
+      }
+      else if (chunkCount == 0){
+         chunkCount = 1;
+      }
+
+      for (i = 0; i < chunkCount; ++i){
+         JSONArrayChunk_t* chunk = &job->chunks[i];
+         chunk->start = position + (size_t)((double)size * i / chunkCount);
+         chunk->end = (i + 1 < chunkCount) ? position + (size_t)((double)size * (i + 1) / chunkCount) : position + size;
+         chunk->inString = (i == 0) ? inString : false;
+         chunk->scanned = false;
+
+         //An odd run of backslashes before the chunk escapes its first byte
+         size_t backslash = chunk->start;
+         while (backslash > job->open && job->message[backslash - 1] == '\\'){
+            backslash--;
+         }
+         chunk->escaped = ((chunk->start - backslash) & 1) != 0;
+      }
+
+      if (chunkCount > 1){
+         runJSONThreadPool(pool, scanChunkTask, job, chunkCount);
+      }
+      else {
+         scanChunkTask(job, 0);
+      }
+
+      //Work out where each chunk really starts, and scan the ones that guessed wrong
+      bool rescan = false;
+      for (i = 0; i < chunkCount; ++i){
+         JSONArrayChunk_t* chunk = &job->chunks[i];
+         bool quotesOdd = (chunk->endsInString != chunk->inString);
+         if (chunk->inString != inString){
+            chunk->inString = inString;
+            chunk->scanned = false;
+            rescan = true;
+         }
+         inString = (inString != quotesOdd);
+      }
+
+      if (rescan){
+         runJSONThreadPool(pool, scanChunkTask, job, chunkCount);
+      }
+
+      //Walk the chunks in order, now that each one knows how deep it starts
+      for (i = 0; i < chunkCount; ++i){
+         JSONArrayChunk_t* chunk = &job->chunks[i];
+         if (depth > MAX_DEPTH){
+            //The message is nested too deep, let the parser report it
+            return JSON_FAIL;
+         }
+
+         size_t comma = chunk->comma[depth - 1];
+         if (chunk->close[depth] != SIZE_MAX){
+            *close = chunk->close[depth];
+            if (job->message[*close] != ']' || *close - job->open < PARALLEL_MIN_SIZE){
+               return JSON_FAIL;
+            }
+
+            return (comma < *close) ? addCut(job, comma) : JSON_SUCCESS;
+         }
+
+         if (comma != SIZE_MAX && addCut(job, comma)){
+            return JSON_FAIL;
+         }
+
+         depth += chunk->depth;
+      }
+
+      position += size;
+      pieceSize *= 2;
+   }
+
+   //The array never ended, let the parser report it
+   return JSON_FAIL;
+}
+
+/**
+ * Scans one chunk of a large array, this is run on the thread pool.
+ *
+ * @param context - The array being split
+ * @param task - The chunk to scan
+ */
+static void scanChunkTask(void* context, size_t task){
+   JSONArrayJob_t* job = (JSONArrayJob_t*)context;
+   JSONArrayChunk_t* chunk = &job->chunks[task];
+   const char* message = job->message;
+   JSONScanner_t scanner;
+   size_t position = 0;
+   int depth = 0;
+   int lowest = 0;
+
+   if (chunk->scanned){
+      return;
+   }
+
+   memset(chunk->comma, 0xFF, sizeof(chunk->comma));
+   memset(chunk->close, 0xFF, sizeof(chunk->close));
+
+   initJSONScanner(&scanner, message, chunk->start, chunk->end);
+   scanner.inString = (chunk->inString) ? ~(uint64_t)0 : 0;
+   scanner.escaped = (chunk->escaped) ? 1 : 0;
+
+   while (nextStructural(&scanner, &position)){
+      switch (message[position]){
+         case '{':
+         case '[':
+            depth++;
+            break;
+         case '}':
+         case ']':
+            depth--;
+            if (depth < lowest){
+               lowest = depth;
+               if (-lowest <= MAX_DEPTH){
+                  chunk->close[-lowest] = position;
+               }
+            }
+            break;
+         case ',':
+            if (depth <= 0 && -depth <= MAX_DEPTH && chunk->comma[-depth] == SIZE_MAX){
+               chunk->comma[-depth] = position;
+            }
+            break;
+         default:
+            break;
+      }
+   }
+
+   chunk->endsInString = (scanner.inString != 0);
+   chunk->depth = depth;
+   chunk->scanned = true;
+}
+
+/**
+ * Adds a place to cut the array at, growing the list if needed.
+ *
+ * @param job - The array being split
+ * @param cut - The position of a ',' between two elements
+ * @return JSON_SUCCESS, or JSON_MALLOC_FAIL
+ */
+static JSONError_t addCut(JSONArrayJob_t* job, size_t cut){
+   if (job->cutCount == job->cutCapacity){
+      size_t capacity = (job->cutCapacity) ? job->cutCapacity * 2 : 256;
+      size_t* cuts = (size_t*)realloc(job->cuts, sizeof(size_t) * capacity);
+      if (!cuts){
+         return JSON_MALLOC_FAIL;
+      }
+
+      job->cuts = cuts;
+      job->cutCapacity = capacity;
+   }
+
+   job->cuts[job->cutCount++] = cut;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Parses one run of elements of a large array, this is run on the thread pool.
+ *
+ * @param context - The array being parsed
+ * @param task - The run to parse
+ */
+static void parseElementsTask(void* context, size_t task){
+   JSONArrayJob_t* job = (JSONArrayJob_t*)context;
+   JSONArrayRange_t* range = &job->ranges[task];
+
+   range->status = parseElements(job, range);
+   if (range->status){
+      disposeOfPair(range->document);
+      range->document = NULL;
+   }
+}
+
+/**
+ * Parses a run of elements on a parser of its own. The parser is fed a
+ * '[' on its own, then the elements, then a ']', so the elements end up
+ * in an array of their own that is built exactly the way the parser would
+ * build the whole array.
+ *
+ * @param job - The array being parsed
+ * @param range - The run of elements
+ * @return JSON_SUCCESS, or why the elements could not be parsed
+ */
+static JSONError_t parseElements(JSONArrayJob_t* job, JSONArrayRange_t* range){
+   JSONParser_t* parser = newJSONParser();
+   if (!parser){
+      return JSON_MALLOC_FAIL;
+   }
+
+   JSONError_t returnStatus = setJSONParserOptions(parser, job->parser->options);
+   if (!returnStatus){
+      returnStatus = setJSONParserMaxDepth(parser, job->parser->maxDepth);
+   }
+
+   char brackets[] = "[]";
+   size_t consumed = 0;
+   if (!returnStatus){
+      returnStatus = feedElements(parser, &range->document, &brackets[0], 1, &consumed);
+   }
+
+   //The elements have to leave the array open for the ']'
+   if (returnStatus == JSON_MESSAGE_INCOMPLETE){
+      returnStatus = feedElements(parser, &range->document, &job->message[range->start],
+                                  range->end - range->start, &consumed);
+      if (returnStatus == JSON_SUCCESS){
+         returnStatus = JSON_INVALID_MESSAGE;
+      }
+   }
+
+   if (returnStatus == JSON_MESSAGE_INCOMPLETE){
+      returnStatus = feedElements(parser, &range->document, &brackets[1], 1, &consumed);
+   }
+
+   disposeOfJSONParser(parser);
+   if (returnStatus){
+      return returnStatus;
+   }
+
+   JSONKeyValue_t* tail = range->document->value->aVal;
+   while (tail->next){
+      tail = tail->next;
+   }
+   range->tail = tail;
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Feeds part of a run of elements to its parser. With PARSE_IN_SITU the
+ * parser writes to the message, that is only allowed because the whole
+ * array came in through parseJSONBufferInSitu() (parseJSONBuffer() turns
+ * PARSE_IN_SITU away before the array is ever split).
+ *
+ * @param parser - The parser of the run
+ * @param document - Where the run is being built
+ * @param chunk - The part of the run to parse
+ * @param length - The length of the part
+ * @param consumed - The number of bytes that were used
+ * @return what feedJSONParser() returns
+ */
+static JSONError_t feedElements(JSONParser_t* parser, JSONKeyValue_t** document, const char* chunk, size_t length, size_t* consumed){
+   if (parser->options & PARSE_IN_SITU){
+      return feedJSONParserInSitu(parser, document, (char*)chunk, length, consumed);
+   }
+
+   return feedJSONParser(parser, document, chunk, length, consumed);
+}
+
+/**
+ * Joins the runs of elements into the array of the first run. If any run
+ * could not be parsed, they are all thrown away.
+ *
+ * @param job - The array that was parsed
+ * @param rangeCount - How many runs there are
+ * @param document - Where the whole array is placed
+ * @return JSON_SUCCESS, or the error from the first run that could not be parsed
+ */
+static JSONError_t joinRanges(JSONArrayJob_t* job, size_t rangeCount, JSONKeyValue_t** document){
+   size_t i;
+
+   for (i = 0; i < rangeCount; ++i){
+      JSONError_t returnStatus = job->ranges[i].status;
+      if (returnStatus){
+         for (i = 0; i < rangeCount; ++i){
+            disposeOfPair(job->ranges[i].document);
+         }
+         return returnStatus;
+      }
+   }
+
+   JSONKeyValue_t* root = job->ranges[0].document;
+   JSONArena_t* arena = getDocumentArena(root);
+
+   for (i = 1; i < rangeCount; ++i){
+      JSONArrayRange_t* range = &job->ranges[i];
+      job->ranges[i - 1].tail->next = range->document->value->aVal;
+      root->length += range->document->length;
+
+      //The elements now belong to the root, only the empty array is left
+      range->document->value->aVal = NULL;
+      range->document->length = 0;
+      if (arena){
+         mergeJSONArena(arena, getDocumentArena(range->document));
+      }
+      else {
+         disposeOfPair(range->document);
+      }
+   }
+
+   *document = root;
+   return JSON_SUCCESS;
+}
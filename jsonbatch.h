@@ -0,0 +1,54 @@
+#ifndef _JSON_BATCH_H
+#define _JSON_BATCH_H
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+#include "jsonparser.h"
+#include "jsonthreads.h"
+
+#define BATCH_RANGES_PER_THREAD  4
+#define BATCH_MIN_RANGE_SIZE     (64 * 1024)
+#define PARALLEL_MIN_SIZE        (1024 * 1024)
+#define PARALLEL_CHUNKS_PER_THREAD 8
+#define PARALLEL_MIN_CHUNK_SIZE  (64 * 1024)
+
+/**
+ * One message of a batch, and what became of it.
+ */
+typedef struct {
+   JSONKeyValue_t* document; /**< The document, NULL if the message could not be parsed */
+   JSONError_t status;       /**< JSON_SUCCESS, or why the message could not be parsed */
+   size_t offset;            /**< Where the message starts in the buffer */
+} JSONBatchDocument_t;
+
+/**
+ * The documents parsed from a buffer of concatenated or newline delimited
+ * messages by parseJSONBatch(). The documents are in the same order as
+ * the messages in the buffer, and each one has its own status, so one bad
+ * message does not stop the rest from being parsed.
+ */
+typedef struct {
+   JSONBatchDocument_t* documents; /**< One for each message found in the buffer */
+   size_t count;                   /**< How many messages were found */
+   size_t failed;                  /**< How many of them could not be parsed */
+   JSONParser_t** parsers;         /**< The parsers used, they hold the keys when keys are interned */
+   size_t parserCount;             /**< How many parsers were used */
+} JSONBatch_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONError_t parseJSONBatch(JSONThreadPool_t* pool, JSONBatch_t** batch, const char* message, size_t length, int options);
+void disposeOfJSONBatch(JSONBatch_t* batch);
+JSONError_t parseJSONArrayInParallel(JSONParser_t* parser, const char* message, size_t length, JSONKeyValue_t** document);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -114,6 +114,7 @@ JSONValue_t* newJSONString(char* string) {
             newString[strIndex++] = string[i];
          }
       }
+      newString[strIndex] = '\0';
    }
    else{
       strcpy(newString, string);
@@ -365,3 +366,277 @@ JSONKeyValue_t* newJSONPair(JSONType_t type, char* key, JSONValue_t* value) {
    
    return newPair;
 }
+
+/**
+ * Creates a new JSON string object that takes ownership of the string,
+ * instead of copying it like newJSONString() does. The string must have
+ * been allocated with malloc, and is freed along with the document. If 
+ * the string holds characters that have to be escaped, it is escaped 
+ * into a new string and the original is freed right away.
+ * 
+ * @param string - The string to make into a JSON string object
+ * 
+ * @return The JSON string value that can be added to a pair, or array
+ */
+JSONValue_t* takeJSONString(char* string) {
+   if (!string){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+   
+   if (string[strcspn(string, "\"\\\b\f\n\r\t")] != '\0'){
+      JSONValue_t* escaped = newJSONString(string);
+      free(string);
+      return escaped;
+   }
+   
+   JSONValue_t* stringValue = (JSONValue_t*) malloc(sizeof(JSONValue_t));
+   
+   if (stringValue == NULL){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+   
+   memset(stringValue, 0, sizeof(JSONValue_t));
+   stringValue->sVal = string;
+   
+   return stringValue;
+}
+
+/**
+ * Creates a new JSON object object that takes ownership of the pair. The
+ * pair itself becomes the first pair of the object, nothing is copied. 
+ * 
+ * @param pair - The JSON pair object that will start the JSON object object,
+ *    or NULL for an empty object
+ * 
+ * @return The JSON object value that can be added to a pair, or array
+ */
+JSONValue_t* takeJSONObject(JSONKeyValue_t* pair) {
+   JSONValue_t* newObject = (JSONValue_t*) malloc(sizeof(JSONValue_t));
+   
+   if (newObject == NULL){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+   
+   memset(newObject, 0, sizeof(JSONValue_t));
+   newObject->oVal = pair;
+   
+   return newObject;
+}
+
+/**
+ * Links the pair onto the end of the object value. Unlike addKeyValuePair()
+ * the pair is not copied, the object takes ownership of it. The pair must 
+ * have been allocated with malloc (by the builder or the parser), and must
+ * not already be part of another object or array.
+ * 
+ * @param object - The JSON object object to link the key value pair to
+ * 
+ * @param pair - The key value pair to link to the object value
+ * 
+ * @return The JSON object that this pair was linked to. 
+ */
+JSONValue_t* takeKeyValuePair(JSONValue_t* object, JSONKeyValue_t* pair){
+   if (!object || !pair){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+   
+   pair->next = NULL;
+   
+   JSONKeyValue_t* current = object->oVal;
+   if (current == NULL){
+      object->oVal = pair;
+   }
+   else {
+      while (current->next != NULL){
+         current = current->next;
+      }
+      
+      current->next = pair;
+   }
+   
+   return object;
+}
+
+/**
+ * Creates a new JSON array that takes ownership of the elements. The
+ * elements are linked together in the order given, nothing is copied. 
+ * 
+ * @param elements - The pairs that will make up the array, each one must
+ *    have been allocated with malloc and not be part of anything else
+ * 
+ * @param length - The number of elements
+ * 
+ * @return The JSON key:value pair with the values inside of the array
+ */
+JSONKeyValue_t* takeJSONArray(JSONKeyValue_t* elements[], int length) {
+   if (!elements && length > 0){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+   
+   JSONKeyValue_t* newArray = (JSONKeyValue_t*) malloc(sizeof(JSONKeyValue_t));
+   JSONValue_t* arrayValue = (JSONValue_t*) malloc(sizeof(JSONValue_t));
+   
+   if (newArray == NULL || arrayValue == NULL){
+      free(newArray);
+      free(arrayValue);
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+   
+   memset(newArray, 0, sizeof(JSONKeyValue_t));
+   memset(arrayValue, 0, sizeof(JSONValue_t));
+   
+   for (int i = length - 1; i >= 0; i--){
+      elements[i]->next = arrayValue->aVal;
+      arrayValue->aVal = elements[i];
+   }
+   
+   newArray->type = ARRAY;
+   newArray->value = arrayValue;
+   newArray->length = length;
+   
+   return newArray;
+}
+
+/**
+ * Creates a new JSON key value pair that takes ownership of the key and
+ * the value, instead of copying the key like newJSONPair() does. The key
+ * must have been allocated with malloc (or be NULL), and is freed along 
+ * with the pair. 
+ * 
+ * @param type - The type of data contained in the value
+ * 
+ * @param key - The unique identifier for the key:value pair
+ * 
+ * @param value - A previously creatd JSON value that matches the type
+ */
+JSONKeyValue_t* takeJSONPair(JSONType_t type, char* key, JSONValue_t* value) {
+   JSONKeyValue_t* newPair = (JSONKeyValue_t*) malloc(sizeof(JSONKeyValue_t));
+   
+   if (newPair == NULL){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+   
+   memset(newPair, 0, sizeof(JSONKeyValue_t));
+   
+   int count = 1;
+   if ((type == OBJECT || type == ARRAY) && value){
+      count = 0;
+      for (JSONKeyValue_t* current = value->oVal; current != NULL; current = current->next){
+         count++;
+      }
+   }
+   
+   newPair->type = type;
+   newPair->key = key;
+   newPair->value = value;
+   newPair->length = count;
+   
+   return newPair;
+}
+
+/**
+ * Starts building a new object or array with an appender. The key is 
+ * taken over the same way takeJSONPair() takes it. Values are added with
+ * appendJSONPair(), and finishJSONContainer() hands back the finished
+ * pair. 
+ * 
+ * @param appender - The appender that will keep track of the container
+ * 
+ * @param type - OBJECT or ARRAY
+ * 
+ * @param key - The key for the container, allocated with malloc, or NULL
+ * 
+ * @return The empty object or array pair, or NULL if it could not be created
+ */
+JSONKeyValue_t* startJSONContainer(JSONAppender_t* appender, JSONType_t type, char* key) {
+   if (!appender){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+   
+   appender->pair = NULL;
+   appender->tail = NULL;
+   
+   if (type != OBJECT && type != ARRAY){
+      json_errno = JSON_INVALID_ARGUMENT;
+      return NULL;
+   }
+   
+   JSONValue_t* value = takeJSONObject(NULL);
+   if (value == NULL){
+      return NULL;
+   }
+   
+   JSONKeyValue_t* pair = takeJSONPair(type, key, value);
+   if (pair == NULL){
+      free(value);
+      return NULL;
+   }
+   
+   pair->length = 0;
+   appender->pair = pair;
+   
+   return pair;
+}
+
+/**
+ * Links the pair onto the end of the object or array the appender is 
+ * building. The pair is not copied, the container takes ownership of it
+ * (see takeKeyValuePair()). Pairs added to an object should have a key, 
+ * and pairs added to an array should not. 
+ * 
+ * @param appender - The appender that was started with startJSONContainer()
+ * 
+ * @param pair - The key value pair to link to the container
+ * 
+ * @return The pair that was linked, or NULL if there was a problem
+ */
+JSONKeyValue_t* appendJSONPair(JSONAppender_t* appender, JSONKeyValue_t* pair) {
+   if (!appender || !appender->pair || !pair){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+   
+   pair->next = NULL;
+   
+   if (appender->tail){
+      appender->tail->next = pair;
+   }
+   else {
+      appender->pair->value->oVal = pair;
+   }
+   
+   appender->tail = pair;
+   appender->pair->length++;
+   
+   return pair;
+}
+
+/**
+ * Finishes the object or array the appender was building. The appender
+ * lets go of the container, which now belongs to the caller (or whatever
+ * it is appended to next).
+ * 
+ * @param appender - The appender that was started with startJSONContainer()
+ * 
+ * @return The finished object or array pair
+ */
+JSONKeyValue_t* finishJSONContainer(JSONAppender_t* appender) {
+   if (!appender || !appender->pair){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+   
+   JSONKeyValue_t* pair = appender->pair;
+   appender->pair = NULL;
+   appender->tail = NULL;
+   
+   return pair;
+}
@@ -5,6 +5,18 @@
 #include <stdbool.h>
 #include "jsoncommon.h"
 
+/**
+ * Builds an object or array one value at a time. The appender remembers
+ * the last value added, so each append links the new value straight onto
+ * the end instead of walking the whole list like addKeyValuePair() does.
+ * This is the same thing the parser does for the objects and arrays it
+ * has open.
+ */
+typedef struct {
+   JSONKeyValue_t* pair;   /**< The object or array being built */
+   JSONKeyValue_t* tail;   /**< The last value added, new values are linked after it */
+} JSONAppender_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,6 +28,14 @@ JSONValue_t* newJSONObject(JSONKeyValue_t* pair);
 JSONValue_t* addKeyValuePair(JSONValue_t* object, JSONKeyValue_t* pair);
 JSONKeyValue_t* newJSONArray(void* array[], JSONType_t types[], int length);
 JSONKeyValue_t* newJSONPair(JSONType_t type, char* key, JSONValue_t* value);
+JSONValue_t* takeJSONString(char* string);
+JSONValue_t* takeJSONObject(JSONKeyValue_t* pair);
+JSONValue_t* takeKeyValuePair(JSONValue_t* object, JSONKeyValue_t* pair);
+JSONKeyValue_t* takeJSONArray(JSONKeyValue_t* elements[], int length);
+JSONKeyValue_t* takeJSONPair(JSONType_t type, char* key, JSONValue_t* value);
+JSONKeyValue_t* startJSONContainer(JSONAppender_t* appender, JSONType_t type, char* key);
+JSONKeyValue_t* appendJSONPair(JSONAppender_t* appender, JSONKeyValue_t* pair);
+JSONKeyValue_t* finishJSONContainer(JSONAppender_t* appender);
 
 #ifdef __cplusplus
 }
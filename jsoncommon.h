@@ -5,8 +5,6 @@
 #include <stdio.h>
 #include <stdbool.h>
 
-#define KEY_STACK_SIZE           256
-
 struct _json_key_value_t;
 
 /**
@@ -33,6 +31,21 @@ typedef union {
    struct _json_key_value_t* aVal; /**< The values in the array will be stored here (no keys) */
 } JSONValue_t;
 
+/**
+ * Flags kept on a pair that say where its memory came from. Pairs that
+ * come from an arena are not freed one at a time, their memory goes away
+ * with the arena. Borrowed keys and strings belong to the message they
+ * were parsed from, and interned keys belong to a key table.
+ */
+typedef enum {
+   PAIR_IN_ARENA =         0x00000001, /**< The pair, its value, key, and string all came from an arena */
+   PAIR_ARENA_ROOT =       0x00000002, /**< The pair is the root of a document that owns its arena */
+   PAIR_KEY_BORROWED =     0x00000004, /**< The key points into the message, it is not freed */
+   PAIR_STRING_BORROWED =  0x00000008, /**< The string value points into the message, it is not freed */
+   PAIR_KEY_INTERNED =     0x00000010, /**< The key belongs to a key table, it is not freed */
+   PAIR_STRING_DECODED =   0x00000020  /**< The string value has its escape sequences expanded, it is escaped again on output */
+} JSONPairFlags_t;
+
 /**
  * Define a type that encapsulates a single JSON key:value pair. The 
  * type defines what the value will be, If this is not an array, the 
@@ -52,6 +65,7 @@ typedef struct _json_key_value_t {
    char* key;        /**< The unique identifier for this pair */
    JSONValue_t* value;  /**< The actual value (or sub-value for OBJECT and ARRAY) */
    struct _json_key_value_t* next; /**< The next element after this if there is one */
+   int flags;        /**< Where the memory for this pair came from (see JSONPairFlags_t) */
 } JSONKeyValue_t;
 
 #endif
@@ -6,7 +6,7 @@
 #include "jsonerror.h"
 #include "jsonparser.h"
 
-int json_errno;
+JSON_THREAD_LOCAL int json_errno;
 
 static char* errorDescriptions[] = {
    "Success",
@@ -41,6 +41,8 @@ static char* errorDescriptions[] = {
    "The pair that was being searched for was not found",
    "Unable to allocate memory for json object",
    "A stdlib function failed",
+   "A parser callback asked the parser to stop",
+   "A string holds bytes that are not well formed UTF-8",
 };
 
 
@@ -48,7 +50,7 @@ static char* errorDescriptions[] = {
  * Returns a description of the specific error number
  */
 const char* json_strerror(int errNo){
-   if (errNo < 0 || errNo > JSON_INTERNAL_FAILURE){
+   if (errNo < 0 || errNo > JSON_INVALID_UTF8){
       return "UNKNWON ERROR";
    }
    
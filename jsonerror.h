@@ -38,10 +38,28 @@ typedef enum {
    JSON_NUMBER_OUT_OF_RANGE,       /**< The number value is out of range for a double type */
    JSON_NO_MATCHING_PAIR,          /**< The pair that was being searched for was not found */
    JSON_MALLOC_FAIL,               /**< Unable to allocate memory for json object */
-   JSON_INTERNAL_FAILURE           /**< A stdlib function failed */
+   JSON_INTERNAL_FAILURE,          /**< A stdlib function failed */
+   JSON_CALLBACK_ABORTED,          /**< A parser callback asked the parser to stop */
+   JSON_INVALID_UTF8               /**< A string holds bytes that are not well formed UTF-8 */
 } JSONError_t;
 
-extern int json_errno;
+/**
+ * Each thread has its own json_errno, so threads that parse, build, and
+ * output documents at the same time do not see each other's errors.
+ */
+#if defined(__GNUC__)
+#define JSON_THREAD_LOCAL __thread
+#elif defined(__cplusplus) && __cplusplus >= 201103L
+#define JSON_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define JSON_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define JSON_THREAD_LOCAL __declspec(thread)
+#else
+#error "jsontools needs a compiler with thread local storage"
+#endif
+
+extern JSON_THREAD_LOCAL int json_errno;
 
 
 /*--------------------------------------------------------------
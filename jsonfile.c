@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jsontools.h"
+
+#define FILE_READ_SIZE  (64 * 1024)
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static JSONError_t mapFile(JSONFile_t* file, int fd, size_t length, int options);
+static JSONError_t readFile(JSONFile_t* file, int fd);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Opens a file and maps it into memory, so it can be parsed without
+ * reading it into a buffer first. The pages are only read in as the
+ * parser gets to them, and they are shared with the page cache, so a
+ * file of several gigabytes does not need that much memory to parse.
+ *
+ * The mapping is read only unless FILE_WRITABLE is given. A writable
+ * mapping is a private copy, the file itself is never changed, and only
+ * the pages that are written to are copied. PARSE_IN_SITU documents
+ * borrow their keys and strings from the mapping, so it has to stay open
+ * for as long as they are used.
+ *
+ * @param path - The path of the file to open
+ * @param options - FILE_DEFAULT, or a combination of JSONFileOptions_t values
+ * @return The contents of the file, or NULL if it could not be opened,
+ *    mapped, or read (errno will say why)
+ */
+JSONFile_t* openJSONFile(const char* path, int options){
+   if (!path){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0){
+      json_errno = JSON_INTERNAL_FAILURE;
+      return NULL;
+   }
+
+   JSONFile_t* file = openJSONFileDescriptor(fd, options);
+
+   int error = errno;
+   close(fd);
+   errno = error;
+
+   return file;
+}
+
+/**
+ * Maps a file that is already open into memory, see openJSONFile(). The
+ * descriptor can be closed once this returns. Anything that is not a
+ * regular file, like a pipe or standard in, can not be mapped, so it is
+ * read from where it is to the end into memory instead.
+ *
+ * @param fd - The file descriptor, it must be open for reading
+ * @param options - FILE_DEFAULT, or a combination of JSONFileOptions_t values
+ * @return The contents of the file, or NULL if it could not be mapped or
+ *    read (errno will say why)
+ */
+JSONFile_t* openJSONFileDescriptor(int fd, int options){
+   if (fd < 0){
+      json_errno = JSON_INVALID_ARGUMENT;
+      return NULL;
+   }
+
+   JSONFile_t* file = (JSONFile_t*)calloc(1, sizeof(JSONFile_t));
+   if (!file){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   struct stat info;
+   if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && (uintmax_t)info.st_size <= SIZE_MAX){
+      if (mapFile(file, fd, (size_t)info.st_size, options) == JSON_SUCCESS){
+         return file;
+      }
+   }
+
+   //Empty files can not be mapped, and neither can pipes
+   JSONError_t status = readFile(file, fd);
+   if (status != JSON_SUCCESS){
+      free(file);
+      json_errno = status;
+      return NULL;
+   }
+
+   return file;
+}
+
+/**
+ * Parses the first message in a file. The rest of the messages can be
+ * walked with a document iterator over file->data and file->length.
+ *
+ * @param parser - The parser to parse the message with
+ * @param document - Where the new document will be put
+ * @param file - The file that was opened with openJSONFile()
+ * @param consumed - Where the next message starts in the file, or the
+ *    length of the file if there are no more
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, JSON_INVALID_ARGUMENT if the
+ *    parser would write to a read only mapping, or the parsers error
+ */
+JSONError_t parseJSONFile(JSONParser_t* parser, JSONKeyValue_t** document, const JSONFile_t* file, size_t* consumed){
+   if (!parser || !document || !file || !consumed){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if ((parser->options & PARSE_IN_SITU) && !file->writable){
+      //The null terminators can not be written to a read only mapping
+      json_errno = JSON_INVALID_ARGUMENT;
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   if (parser->options & PARSE_IN_SITU){
+      return parseJSONBufferInSitu(parser, document, file->data, file->length, consumed);
+   }
+
+   return parseJSONBuffer(parser, document, file->data, file->length, consumed);
+}
+
+/**
+ * Unmaps (or frees) the contents of a file. Documents that borrowed from
+ * it must be disposed of first.
+ *
+ * @param file - The file that was opened with openJSONFile()
+ */
+void closeJSONFile(JSONFile_t* file){
+   if (!file){
+      return;
+   }
+
+   if (file->mapped){
+      munmap(file->data, file->mapped);
+   }
+   else {
+      free(file->data);
+   }
+   free(file);
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Maps the whole file, and tells the kernel how it will be read. The
+ * advice is only a hint, so it is not an error if it is not taken.
+ *
+ * @param file - Where the mapping is kept
+ * @param fd - The file to map
+ * @param length - The size of the file
+ * @param options - The JSONFileOptions_t values
+ * @return JSON_SUCCESS, or JSON_INTERNAL_FAILURE if it could not be mapped
+ */
+static JSONError_t mapFile(JSONFile_t* file, int fd, size_t length, int options){
+   int protection = PROT_READ;
+   int flags = MAP_PRIVATE;
+
+   if (options & FILE_WRITABLE){
+      protection |= PROT_WRITE;
+   }
+#ifdef MAP_POPULATE
+   if (options & FILE_POPULATE){
+      flags |= MAP_POPULATE;
+   }
+#endif
+
+   void* data = mmap(NULL, length, protection, flags, fd, 0);
+   if (data == MAP_FAILED){
+      return JSON_INTERNAL_FAILURE;
+   }
+
+   //The parser goes from front to back, so read ahead and drop what is behind
+   madvise(data, length, MADV_SEQUENTIAL);
+#ifndef MAP_POPULATE
+   if (options & FILE_POPULATE){
+      madvise(data, length, MADV_WILLNEED);
+   }
+#endif
+#ifdef MADV_HUGEPAGE
+   if (options & FILE_HUGE_PAGES){
+      madvise(data, length, MADV_HUGEPAGE);
+   }
+#endif
+
+   file->data = (char*)data;
+   file->length = length;
+   file->mapped = length;
+   file->writable = (options & FILE_WRITABLE) != 0;
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Reads everything that is left in a file into memory, for files that
+ * can not be mapped.
+ *
+ * @param file - Where the contents are kept
+ * @param fd - The file to read
+ * @return JSON_SUCCESS, JSON_MALLOC_FAIL, or JSON_INTERNAL_FAILURE if the
+ *    file could not be read
+ */
+static JSONError_t readFile(JSONFile_t* file, int fd){
+   size_t size = FILE_READ_SIZE;
+   size_t length = 0;
+   char* data = (char*)malloc(size);
+   if (!data){
+      return JSON_MALLOC_FAIL;
+   }
+
+   while (true){
+      if (length == size){
+         char* bigger = (char*)realloc(data, size * 2);
+         if (!bigger){
+            free(data);
+            return JSON_MALLOC_FAIL;
+         }
+         data = bigger;
+         size *= 2;
+      }
+
+      ssize_t bytes = read(fd, data + length, size - length);
+      if (bytes == 0){
+         break;
+      }
+
+      if (bytes < 0){
+         if (errno == EINTR){
+            continue;
+         }
+
+         free(data);
+         return JSON_INTERNAL_FAILURE;
+      }
+
+      length += (size_t)bytes;
+   }
+
+   file->data = data;
+   file->length = length;
+   file->mapped = 0;
+   file->writable = true;
+
+   return JSON_SUCCESS;
+}
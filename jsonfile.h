@@ -0,0 +1,50 @@
+#ifndef _JSON_FILE_H
+#define _JSON_FILE_H
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+#include "jsonparser.h"
+
+/**
+ * Options that change how a file is mapped into memory. They can be
+ * combined with a bitwise or.
+ */
+typedef enum {
+   FILE_DEFAULT =    0x00000000, /**< Map the file read only, and read it in as it is parsed */
+   FILE_WRITABLE =   0x00000001, /**< Map a private copy of the file that can be written to, for PARSE_IN_SITU */
+   FILE_POPULATE =   0x00000002, /**< Read the whole file in when it is mapped, instead of page by page */
+   FILE_HUGE_PAGES = 0x00000004  /**< Ask for huge pages, so very large files need fewer page table entries */
+} JSONFileOptions_t;
+
+/**
+ * The contents of a file, mapped into memory when that is possible. Files
+ * that can not be mapped (pipes, terminals, and some special files) are
+ * read into memory instead. Either way the contents are in data, and any
+ * document that borrows keys or strings from it must be disposed of
+ * before the file is closed.
+ */
+typedef struct {
+   char* data;    /**< The contents of the file, not null terminated */
+   size_t length; /**< How many bytes are in the file */
+   size_t mapped; /**< The size of the mapping, 0 if the file was read into memory instead */
+   bool writable; /**< true if the contents can be written to */
+} JSONFile_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONFile_t* openJSONFile(const char* path, int options);
+JSONFile_t* openJSONFileDescriptor(int fd, int options);
+JSONError_t parseJSONFile(JSONParser_t* parser, JSONKeyValue_t** document, const JSONFile_t* file, size_t* consumed);
+void closeJSONFile(JSONFile_t* file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
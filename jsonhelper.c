@@ -1,15 +1,14 @@
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdbool.h>
 
 #include "jsontools.h"
+#include "jsonstring.h"
 
 /*-----------------------------------------------------------------
  * Declare private static functions
  *---------------------------------------------------------------*/
 
-static int convertToUTF8(unsigned int character, char utfBytes[]);
 
 /*------------------------------------------------------------------
  * Implement global functions
@@ -37,7 +36,7 @@ bool hasChildPair(JSONKeyValue_t* parent, const char* key){
    JSONKeyValue_t* current = parent->value->oVal;
    while(current != NULL){
       if (current->type != NIL){
-         if (strcmp(current->key, key) == 0){
+         if (current->key == key || strcmp(current->key, key) == 0){
             return true;
          }
       }
@@ -72,7 +71,7 @@ JSONKeyValue_t* getChildPair(JSONKeyValue_t* parent, const char* key){
    JSONKeyValue_t* current = parent->value->oVal;
    while(current != NULL){
       if (current->type != NIL){
-         if (strcmp(current->key, key) == 0){
+         if (current->key == key || strcmp(current->key, key) == 0){
             return current;
          }
       }
@@ -83,6 +82,39 @@ JSONKeyValue_t* getChildPair(JSONKeyValue_t* parent, const char* key){
    return NULL;
 }
 
+/**
+ * Gets the child element for this JSON object, comparing keys by pointer
+ * only. This is much faster than getChildPair(), but only works when the
+ * document was parsed with a key table and the key being searched for was
+ * interned in the same table (see internJSONKey and findJSONKey).
+ * 
+ * @param parent - The parent key:value pair whos value is another key:value pair
+ * 
+ * @param key - The interned key of the key:value pair you want to reterive. 
+ * 
+ * @return - The JSONKeyValue_t* object that matches the request, or NULL
+ */
+JSONKeyValue_t* getInternedChildPair(JSONKeyValue_t* parent, const char* key){
+   if (!parent || !key){
+      return NULL;
+   }
+   
+   if (parent->type != OBJECT){
+      return NULL;
+   }
+   
+   JSONKeyValue_t* current = parent->value->oVal;
+   while(current != NULL){
+      if (current->key == key && current->type != NIL){
+         return current;
+      }
+      
+      current = current->next;
+   }
+   
+   return NULL;
+}
+
 /**
  * Gets the child elements for this JSON object or array. This is useful to reterive
  * nested key:value pairs from JSON object types, regardless of the key.
@@ -343,7 +375,8 @@ char** getElementKeys(JSONKeyValue_t* element, int* size){
  * This disposes of a single pair. This is used by the disposeOfDocument 
  * function, but is also provided as a helper. Please note that if you
  * dispose of a pair that is still attached to a document, it will cause
- * undefined behaiver, and maybe seg faults. 
+ * undefined behaiver, and maybe seg faults. Pairs from a document that
+ * was built in an arena can only be disposed of as a whole document.
  * 
  * @param pair - the pair that was previously created
  */
@@ -352,6 +385,13 @@ void disposeOfPair(JSONKeyValue_t* pair){
       return;
    }
    
+   if (pair->flags & PAIR_IN_ARENA){
+      //Pairs in an arena are all freed at once, when the root pair is
+      //disposed of the arena goes with it
+      disposeOfJSONArena(getDocumentArena(pair));
+      return;
+   }
+   
    if (pair->type == OBJECT){
       //Objects elements must be freed so we don't get unreachable memory leaks
       JSONKeyValue_t* current = pair->value->oVal;
@@ -372,12 +412,12 @@ void disposeOfPair(JSONKeyValue_t* pair){
          current = next;
       }
    }
-   else if (pair->type == STRING){
+   else if (pair->type == STRING && !(pair->flags & PAIR_STRING_BORROWED)){
       //free the string value
       free(pair->value->sVal);
    }
    
-   if (pair->key){
+   if (pair->key && !(pair->flags & (PAIR_KEY_BORROWED | PAIR_KEY_INTERNED))){
       //free the key
       free(pair->key);
    }
@@ -390,9 +430,10 @@ void disposeOfPair(JSONKeyValue_t* pair){
 /**
  * This converts a string with escaped sequences into an unescaped UTF-8 
  * string with all values expanded. All control characters and unicode 
- * escaped sequences will be expanded. Note that the string being created
- * and assigned to converted is a dynamicly created string that must be
- * freed to avoid memory leaks.
+ * escaped sequences will be expanded, including surrogate pairs. Note that
+ * the string being created and assigned to converted is a dynamicly
+ * created string that must be freed to avoid memory leaks. Strings parsed
+ * with PARSE_DECODE_STRINGS are already converted.
  * 
  * @param origional - The origional string that contains JSON escaped sequences.
  * 
@@ -405,157 +446,19 @@ JSONError_t convertString(const char* origional, char** convertedString){
       return JSON_NULL_ARGUMENT;
    }
    
-   int stringLength = strlen(origional);
+   size_t stringLength = strlen(origional);
    char* converted = (char*)malloc((sizeof(char) * stringLength) + 1);
-   
-   /* 
-    * If we have special characters in the string, we need to parse the
-    * string and convert those characters to their JSON escaped equivilants
-    * 
-    *  \"
-    *  \\
-    *  \/   <-- this one is touchy, '/' is supposed to be esacped, but no one does this in practice. we just ignore it.
-    *  \b
-    *  \f
-    *  \n
-    *  \r
-    *  \t
-    */
-   int index = 0;
-   char temp[6];
-   for (int i = 0; i < stringLength; i++){
-      if (origional[i] == '\\'){
-         //Found beginning of escae
-         i++;
-         if (origional[i] == '\\'){
-            converted[index++] = '\\';
-         }
-         else if (origional[i] =='"'){
-            converted[index++] = '"';
-         }
-         else if (origional[i] == '/'){
-            converted[index++] = '/';
-         }
-         else if (origional[i] == 'b'){
-            converted[index++] = '\b';
-         }
-         else if (origional[i] == 'f'){
-            converted[index++] = '\f';
-         }
-         else if (origional[i] == 'n'){
-            converted[index++] = '\n';
-         }
-         else if (origional[i] == 'r'){
-            converted[index++] = '\r';
-         }
-         else if (origional[i] == 't'){
-            converted[index++] = '\t';
-         }
-         else if (origional[i] == 'u'){
-            //Need to convert unicode escape sequence to UTF-8
-            i++;
-            temp[0] = '0';
-            temp[1] = 'x';
-            for (int j = 0; j < 4; j++){
-               if (isxdigit(origional[i])){
-                  temp[2+j] = origional[i];
-                  i++;
-               }
-               else{
-                  free(converted);
-                  return JSON_INVALID_UNICODE_SEQ;
-               }
-            }
-            
-            i--; //Need to step back one so we don't miss next character
-            
-            unsigned int unicode = (unsigned int)strtol(temp, NULL, 16);
-            int bytes = convertToUTF8(unicode, temp);
-            
-            for (int j = 0; j < bytes; j++){
-               converted[index++] = temp[j];
-            }
-         }
-         else {
-            free(converted);
-            return JSON_UNEXPECTED_CHARACTER;
-         }
-      }
-      else {
-         //Normal character, just push it into new string
-         converted[index++] = origional[i];
-      }
+   if (!converted){
+      return JSON_MALLOC_FAIL;
    }
    
-   converted[index] = '\0';
-   //converted = (char*)realloc(converted, index + 1);
+   size_t convertedLength;
+   JSONError_t returnStatus = unescapeJSONString(origional, stringLength, converted, &convertedLength);
+   if (returnStatus){
+      free(converted);
+      return returnStatus;
+   }
    
    *convertedString = converted;
    return JSON_SUCCESS;
 }
-
-/*--------------------------------------------------------------------
- * Implement private static functions
- *------------------------------------------------------------------*/
-
-/**
- * Helper function that converts an integer (unicode character) to
- * a sequence of unicode bytes. The bytes can then be written into
- * a string and displayed on a UTF-8 compatible terminal or file 
- * reader. 
- * 
- * @param character - The unicode character (up to 16 bits wide is what JSON allows)
- * 
- * @param utfBytes - an array of size 6, this array will be filled with UTF-8 bytes
- * 
- * @return - Number of bytes in utfBytes array.
- * 
- * NOTE - Always pass a char array of size 6 into the function to avoid segfaulting
- */
-static int convertToUTF8(unsigned int character, char utfBytes[]){
-   if (!utfBytes){
-      return -1;
-   }
-   
-   //ASCII characters are just left alone
-   if (character <= 0x7F){
-      utfBytes[0] = (char)(character & 0xFF);
-      return 1;
-   }
-   else if (character > 0x7F && character <= 0x7FF){
-      /*
-       * 00000yyy yyxxxxxx original 
-       * 110yyyyy 10xxxxxx formatted
-       */
-      char x = (character & 0x3F);
-      char y = ((character & 0x07C0) >> 6);
-      y |= 0xC0;
-      x |= 0x80;
-      
-      utfBytes[0] = y;
-      utfBytes[1] = x;
-      return 2;
-   }
-   else if (character > 0x7FF && character <= 0xFFFF){
-      /*
-       * zzzzyyyy yyxxxxxx          original
-       * 1110zzzz 10yyyyyy 10xxxxxx formatted
-       */
-       
-       char z = ((character & 0xF000) >> 12);
-       char y = ((character & 0x0FC0) >> 6);
-       char x = (character & 0x3F);
-       
-       z |= 0xE0;
-       y |= 0x80;
-       x |= 0x80;
-       
-       utfBytes[0] = z;
-       utfBytes[1] = y;
-       utfBytes[2] = x;
-       return 3;
-   }
-   else {
-      return -1;
-   }
-}
@@ -12,6 +12,7 @@ extern "C" {
 
 bool hasChildPair(JSONKeyValue_t* parent, const char* key);
 JSONKeyValue_t* getChildPair(JSONKeyValue_t* parent, const char* key);
+JSONKeyValue_t* getInternedChildPair(JSONKeyValue_t* parent, const char* key);
 JSONKeyValue_t* getAllChildPairs(JSONKeyValue_t* parent);
 JSONError_t getArray(JSONKeyValue_t* pair, JSONKeyValue_t** values); 
 JSONError_t getString(JSONKeyValue_t* pair, char** value);
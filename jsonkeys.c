@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "jsontools.h"
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static uint32_t hashKey(const char* key, size_t length);
+static JSONKeySlot_t* findSlot(JSONKeyTable_t* table, const char* key, size_t length, uint32_t hash);
+static bool growKeyTable(JSONKeyTable_t* table);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Creates a new, empty key table. The keys are copied into the tables
+ * own arena, so they stay good until the table is disposed of.
+ *
+ * @return The new key table, or NULL if memory could not be allocated
+ */
+JSONKeyTable_t* newJSONKeyTable(){
+   JSONKeyTable_t* table = (JSONKeyTable_t*)malloc(sizeof(JSONKeyTable_t));
+   if (!table){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   table->slots = (JSONKeySlot_t*)calloc(KEY_TABLE_SIZE, sizeof(JSONKeySlot_t));
+   table->ownStorage = newJSONArena(0);
+   if (!table->slots || !table->ownStorage){
+      free(table->slots);
+      disposeOfJSONArena(table->ownStorage);
+      free(table);
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   table->capacity = KEY_TABLE_SIZE;
+   table->count = 0;
+   table->storage = table->ownStorage;
+
+   return table;
+}
+
+/**
+ * Finds the single copy of a key, adding it to the table if this is the
+ * first time it has been seen.
+ *
+ * @param table - The key table
+ * @param key - The characters of the key, they do not need to be null terminated
+ * @param length - The length of the key
+ * @return The interned key, or NULL if memory could not be allocated
+ */
+const char* internJSONKey(JSONKeyTable_t* table, const char* key, size_t length){
+   if (!table || !key){
+      json_errno = JSON_NULL_ARGUMENT;
+      return NULL;
+   }
+
+   uint32_t hash = hashKey(key, length);
+   JSONKeySlot_t* slot = findSlot(table, key, length, hash);
+   if (slot->key){
+      return slot->key;
+   }
+
+   if ((table->count + 1) * 2 > table->capacity){
+      //Keep the table at most half full so the probes stay short
+      if (!growKeyTable(table)){
+         json_errno = JSON_MALLOC_FAIL;
+         return NULL;
+      }
+
+      slot = findSlot(table, key, length, hash);
+   }
+
+   char* newKey = (char*)allocateFromArena(table->storage, length + 1);
+   if (!newKey){
+      return NULL;
+   }
+
+   memcpy(newKey, key, length);
+   newKey[length] = '\0';
+
+   slot->key = newKey;
+   slot->hash = hash;
+   slot->length = (uint32_t)length;
+   table->count++;
+
+   return newKey;
+}
+
+/**
+ * Looks up a key without adding it. This is how a key is found before
+ * searching a document with getInternedChildPair().
+ *
+ * @param table - The key table
+ * @param key - The null terminated key to look for
+ * @return The interned key, or NULL if it is not in the table
+ */
+const char* findJSONKey(JSONKeyTable_t* table, const char* key){
+   if (!table || !key){
+      return NULL;
+   }
+
+   size_t length = strlen(key);
+   return findSlot(table, key, length, hashKey(key, length))->key;
+}
+
+/**
+ * Forgets every key in the table. From then on keys are copied into the
+ * given arena, which is how the parser keeps one copy of each key per
+ * document: the keys live in the documents arena and go away with it.
+ *
+ * @param table - The key table
+ * @param storage - Where new keys will be copied, or NULL to use the tables own arena
+ */
+void resetJSONKeyTable(JSONKeyTable_t* table, JSONArena_t* storage){
+   if (!table){
+      return;
+   }
+
+   memset(table->slots, 0, table->capacity * sizeof(JSONKeySlot_t));
+   table->count = 0;
+
+   if (storage){
+      table->storage = storage;
+   }
+   else {
+      resetJSONArena(table->ownStorage);
+      table->storage = table->ownStorage;
+   }
+}
+
+/**
+ * Frees the key table and every key in its own arena. Documents whose keys
+ * were interned in the table can not be used after this.
+ *
+ * @param table - The key table that was created with newJSONKeyTable()
+ */
+void disposeOfJSONKeyTable(JSONKeyTable_t* table){
+   if (!table){
+      return;
+   }
+
+   disposeOfJSONArena(table->ownStorage);
+   free(table->slots);
+   free(table);
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Hashes a key 8 bytes at a time.
+ *
+ * @param key - The characters of the key
+ * @param length - The length of the key
+ * @return The hash of the key
+ */
+static uint32_t hashKey(const char* key, size_t length){
+   uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+   uint64_t word;
+
+   while (length >= 8){
+      memcpy(&word, key, 8);
+      hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+      hash ^= hash >> 29;
+      key += 8;
+      length -= 8;
+   }
+
+   if (length){
+      word = 0;
+      memcpy(&word, key, length);
+      hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+      hash ^= hash >> 29;
+   }
+
+   hash *= 0x94D049BB133111EBULL;
+   return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/**
+ * Finds the slot that holds a key, or the empty slot where it would go.
+ *
+ * @param table - The key table
+ * @param key - The characters of the key
+ * @param length - The length of the key
+ * @param hash - The hash of the key
+ * @return The slot for the key
+ */
+static JSONKeySlot_t* findSlot(JSONKeyTable_t* table, const char* key, size_t length, uint32_t hash){
+   size_t mask = table->capacity - 1;
+   size_t index = hash & mask;
+
+   while (true){
+      JSONKeySlot_t* slot = &table->slots[index];
+      if (!slot->key || (slot->hash == hash && slot->length == length && memcmp(slot->key, key, length) == 0)){
+         return slot;
+      }
+
+      index = (index + 1) & mask;
+   }
+}
+
+/**
+ * Doubles the number of slots in the table. The keys themselves do not
+ * move, so the pointers handed out stay good.
+ *
+ * @param table - The key table
+ * @return true if the table grew, false if memory could not be allocated
+ */
+static bool growKeyTable(JSONKeyTable_t* table){
+   size_t capacity = table->capacity * 2;
+   JSONKeySlot_t* slots = (JSONKeySlot_t*)calloc(capacity, sizeof(JSONKeySlot_t));
+   if (!slots){
+      return false;
+   }
+
+   for (size_t i = 0; i < table->capacity; i++){
+      JSONKeySlot_t* slot = &table->slots[i];
+      if (slot->key){
+         size_t index = slot->hash & (capacity - 1);
+         while (slots[index].key){
+            index = (index + 1) & (capacity - 1);
+         }
+         slots[index] = *slot;
+      }
+   }
+
+   free(table->slots);
+   table->slots = slots;
+   table->capacity = capacity;
+
+   return true;
+}
@@ -0,0 +1,56 @@
+#ifndef _JSON_KEYS_H
+#define _JSON_KEYS_H
+
+#include <stdint.h>
+
+#include "jsoncommon.h"
+#include "jsonmemory.h"
+
+#define KEY_TABLE_SIZE           64
+
+/**
+ * One key in a key table.
+ */
+typedef struct {
+   const char* key;  /**< The interned copy of the key, NULL if the slot is empty */
+   uint32_t hash;    /**< The hash of the key */
+   uint32_t length;  /**< The length of the key */
+} JSONKeySlot_t;
+
+/**
+ * A key table keeps a single copy of every distinct key it is given.
+ * When the parser interns keys, every pair with the same key points to
+ * the same string, so a document made of many records with the same keys
+ * only stores each key once. Two keys from the same table are equal if,
+ * and only if, they are the same pointer.
+ *
+ * The keys are stored in an arena. That is either the tables own arena,
+ * or the arena of the document being parsed (see resetJSONKeyTable).
+ */
+typedef struct {
+   JSONKeySlot_t* slots;      /**< Open addressed hash table of keys */
+   size_t capacity;           /**< The number of slots, always a power of 2 */
+   size_t count;              /**< The number of keys in the table */
+   JSONArena_t* storage;      /**< Where the keys are copied to */
+   JSONArena_t* ownStorage;   /**< The tables own arena */
+} JSONKeyTable_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONKeyTable_t* newJSONKeyTable();
+const char* internJSONKey(JSONKeyTable_t* table, const char* key, size_t length);
+const char* findJSONKey(JSONKeyTable_t* table, const char* key);
+void resetJSONKeyTable(JSONKeyTable_t* table, JSONArena_t* storage);
+void disposeOfJSONKeyTable(JSONKeyTable_t* table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,995 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "jsontools.h"
+#include "jsonscan.h"
+#include "jsonnumber.h"
+
+#define LAZY_INDEX_SIZE          64
+#define LAZY_STACK_SIZE          16
+
+/**
+ * The kinds of entries in the index, as far as the structure check cares.
+ * The order matters, opening and closing brackets are checked with ranges.
+ */
+enum {
+   CLASS_OTHER,         /**< Anything that can not start a value */
+   CLASS_SCALAR,        /**< The first character of a number or literal */
+   CLASS_QUOTE,         /**< The opening or closing quote of a string */
+   CLASS_COLON,         /**< ':' */
+   CLASS_COMMA,         /**< ',' */
+   CLASS_OPEN_OBJECT,   /**< '{' */
+   CLASS_OPEN_ARRAY,    /**< '[' */
+   CLASS_CLOSE_OBJECT,  /**< '}' */
+   CLASS_CLOSE_ARRAY,   /**< ']' */
+   CLASS_COUNT
+};
+
+/**
+ * What the structure check is expecting to find next. Objects and arrays
+ * have their own states, so a ',' or a closing bracket knows where it is.
+ */
+enum {
+   LAZY_ROOT,              /**< The '{' or '[' that starts the message */
+   LAZY_KEY_OR_CLOSE,      /**< The first key of an object, or '}' */
+   LAZY_KEY,               /**< A key after a ',' */
+   LAZY_KEY_END,           /**< The closing quote of a key */
+   LAZY_DELIMITER,         /**< The ':' after a key */
+   LAZY_OBJECT_VALUE,      /**< A value after a ':' */
+   LAZY_OBJECT_STRING_END, /**< The closing quote of a string in an object */
+   LAZY_OBJECT_NEXT,       /**< A ',' or '}' after a value */
+   LAZY_VALUE_OR_CLOSE,    /**< The first value of an array, or ']' */
+   LAZY_ARRAY_VALUE,       /**< A value after a ',' */
+   LAZY_ARRAY_STRING_END,  /**< The closing quote of a string in an array */
+   LAZY_ARRAY_NEXT,        /**< A ',' or ']' after a value */
+   LAZY_DONE,              /**< The root value is finished */
+   LAZY_STATE_COUNT,
+   LAZY_ERROR = LAZY_STATE_COUNT
+};
+
+/**
+ * An object or array that has not been closed yet.
+ */
+typedef struct {
+   size_t entry;  /**< The entry of the '{' or '[' */
+   int state;     /**< The state to go back to once it closes */
+} LazyFrame_t;
+
+#define E LAZY_ERROR
+#define CLOSE LAZY_DONE
+
+/**
+ * The state that follows each kind of entry in each state. Opening an
+ * object or array goes to its first state. Closing one goes back to the
+ * state that was saved when it opened, so those columns only say where
+ * a close is allowed. The scanner never puts anything between the quotes
+ * of a string in the index, so the entry after an opening quote is always
+ * the closing quote.
+ */
+static const unsigned char transitions[LAZY_STATE_COUNT][CLASS_COUNT] = {
+   /*                     other  scalar            quote                   :                  ,                 {                  [                    }      ] */
+   /* ROOT */           { E,     E,                E,                      E,                 E,                LAZY_KEY_OR_CLOSE, LAZY_VALUE_OR_CLOSE, E,     E },
+   /* KEY_OR_CLOSE */   { E,     E,                LAZY_KEY_END,           E,                 E,                E,                 E,                   CLOSE, E },
+   /* KEY */            { E,     E,                LAZY_KEY_END,           E,                 E,                E,                 E,                   E,     E },
+   /* KEY_END */        { E,     E,                LAZY_DELIMITER,         E,                 E,                E,                 E,                   E,     E },
+   /* DELIMITER */      { E,     E,                E,                      LAZY_OBJECT_VALUE, E,                E,                 E,                   E,     E },
+   /* OBJECT_VALUE */   { E,     LAZY_OBJECT_NEXT, LAZY_OBJECT_STRING_END, E,                 E,                LAZY_KEY_OR_CLOSE, LAZY_VALUE_OR_CLOSE, E,     E },
+   /* OBJECT_STR_END */ { E,     E,                LAZY_OBJECT_NEXT,       E,                 E,                E,                 E,                   E,     E },
+   /* OBJECT_NEXT */    { E,     E,                E,                      E,                 LAZY_KEY,         E,                 E,                   CLOSE, E },
+   /* VALUE_OR_CLOSE */ { E,     LAZY_ARRAY_NEXT,  LAZY_ARRAY_STRING_END,  E,                 E,                LAZY_KEY_OR_CLOSE, LAZY_VALUE_OR_CLOSE, E,     CLOSE },
+   /* ARRAY_VALUE */    { E,     LAZY_ARRAY_NEXT,  LAZY_ARRAY_STRING_END,  E,                 E,                LAZY_KEY_OR_CLOSE, LAZY_VALUE_OR_CLOSE, E,     E },
+   /* ARRAY_STR_END */  { E,     E,                LAZY_ARRAY_NEXT,        E,                 E,                E,                 E,                   E,     E },
+   /* ARRAY_NEXT */     { E,     E,                E,                      E,                 LAZY_ARRAY_VALUE, E,                 E,                   E,     CLOSE },
+   /* DONE */           { E,     E,                E,                      E,                 E,                E,                 E,                   E,     E }
+};
+
+/**
+ * The state to carry on in once a value is finished, for each state a
+ * value can start in. This is saved when an object or array opens.
+ */
+static const unsigned char valueDone[LAZY_STATE_COUNT] = {
+   LAZY_DONE, E, E, E, E, LAZY_OBJECT_NEXT, E, E, LAZY_ARRAY_NEXT, LAZY_ARRAY_NEXT, E, E, E
+};
+
+#undef CLOSE
+#undef E
+
+/**
+ * The kind of entry each character starts. Anything not listed is CLASS_OTHER.
+ */
+static const unsigned char characterClasses[256] = {
+   ['{'] = CLASS_OPEN_OBJECT, ['['] = CLASS_OPEN_ARRAY, ['}'] = CLASS_CLOSE_OBJECT, [']'] = CLASS_CLOSE_ARRAY,
+   [':'] = CLASS_COLON, [','] = CLASS_COMMA, ['"'] = CLASS_QUOTE,
+   ['-'] = CLASS_SCALAR, ['0'] = CLASS_SCALAR, ['1'] = CLASS_SCALAR, ['2'] = CLASS_SCALAR, ['3'] = CLASS_SCALAR,
+   ['4'] = CLASS_SCALAR, ['5'] = CLASS_SCALAR, ['6'] = CLASS_SCALAR, ['7'] = CLASS_SCALAR, ['8'] = CLASS_SCALAR,
+   ['9'] = CLASS_SCALAR, ['t'] = CLASS_SCALAR, ['f'] = CLASS_SCALAR, ['n'] = CLASS_SCALAR
+};
+
+/**
+ * The error for each kind of entry that shows up where it is not allowed.
+ */
+static const JSONError_t classErrors[CLASS_COUNT] = {
+   JSON_UNEXPECTED_CHARACTER,
+   JSON_UNEXPECTED_VALUE,
+   JSON_UNEXPECTED_STRING,
+   JSON_UNEXPECTED_DELIMITER,
+   JSON_UNEXPECTED_COMMA,
+   JSON_UNEXPECTED_OBJECT,
+   JSON_UNEXPECTED_ARRAY,
+   JSON_OBJECT_BRACKET_MISMATCH,
+   JSON_ARRAY_BRACKET_MISMATCH
+};
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static JSONError_t indexMessage(JSONLazyDocument_t* document);
+static JSONError_t checkStructure(JSONLazyDocument_t* document);
+static char entryCharacter(JSONLazyDocument_t* document, size_t entry);
+static size_t scalarLength(JSONLazyDocument_t* document, size_t entry);
+static size_t firstEntry(JSONLazyDocument_t* document, size_t entry);
+static size_t nextEntry(JSONLazyDocument_t* document, size_t entry);
+static bool keyMatches(JSONLazyDocument_t* document, size_t entry, const char* key, size_t keyLength);
+static JSONError_t copyString(JSONLazyDocument_t* document, size_t entry, char** string);
+static char** stringSlot(JSONLazyDocument_t* document, size_t entry);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Indexes a message so its values can be read on demand. The structure
+ * of the whole message is checked up front: brackets, braces, keys,
+ * delimiters, and commas all have to be where they belong. The numbers,
+ * strings, and literals themselves are only checked when they are read.
+ * The message must be a single object or array, and is not copied.
+ *
+ * @param document - Where the new document is placed
+ * @param message - The JSON message, it does not need to be null terminated
+ * @param length - The length of the message
+ * @return JSON_SUCCESS, or the problem that was found in the message
+ */
+JSONError_t parseJSONLazy(JSONLazyDocument_t** document, const char* message, size_t length){
+   if (!document || !message){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   *document = NULL;
+
+   if (length > UINT32_MAX){
+      //The index holds 32 bit positions
+      json_errno = JSON_MESSAGE_TOO_LARGE;
+      return JSON_MESSAGE_TOO_LARGE;
+   }
+
+   JSONLazyDocument_t* newDocument = (JSONLazyDocument_t*)malloc(sizeof(JSONLazyDocument_t));
+   if (!newDocument){
+      json_errno = JSON_MALLOC_FAIL;
+      return JSON_MALLOC_FAIL;
+   }
+
+   memset(newDocument, 0, sizeof(JSONLazyDocument_t));
+   newDocument->message = message;
+   newDocument->length = length;
+
+   JSONError_t returnStatus = indexMessage(newDocument);
+   if (!returnStatus){
+      returnStatus = checkStructure(newDocument);
+   }
+
+   if (returnStatus){
+      disposeOfJSONLazyDocument(newDocument);
+      json_errno = returnStatus;
+      return returnStatus;
+   }
+
+   *document = newDocument;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Gets the outer object or array of a lazy document.
+ *
+ * @param document - The lazy document
+ * @return The root value
+ */
+JSONLazyValue_t getLazyRoot(JSONLazyDocument_t* document){
+   JSONLazyValue_t root = { document, (document) ? 0 : LAZY_NO_VALUE };
+   return root;
+}
+
+/**
+ * Checks if a value was found.
+ *
+ * @param value - The value returned by one of the lazy lookups
+ * @return true if the value exists, false if the lookup did not find anything
+ */
+bool isLazyValue(JSONLazyValue_t value){
+   return value.document && value.entry != LAZY_NO_VALUE;
+}
+
+/**
+ * Gets the type of a value. This only looks at the first character of the
+ * value, the value itself is not checked.
+ *
+ * @param value - The value
+ * @return The type of the value, NIL if the value does not exist
+ */
+JSONType_t getLazyType(JSONLazyValue_t value){
+   if (!isLazyValue(value)){
+      return NIL;
+   }
+
+   switch (entryCharacter(value.document, value.entry)){
+      case '{' : return OBJECT;
+      case '[' : return ARRAY;
+      case '"' : return STRING;
+      case 't' :
+      case 'f' : return BOOLEAN;
+      case 'n' : return NIL;
+      default  : return NUMBER;
+   }
+}
+
+/**
+ * Finds the value with the given key in an object. The other values in
+ * the object are stepped over without being read.
+ *
+ * @param parent - The object to look in
+ * @param key - The key of the value to find
+ * @return The value, or a value that does not exist if the parent is not
+ *    an object, or has no value with that key
+ */
+JSONLazyValue_t getLazyChild(JSONLazyValue_t parent, const char* key){
+   JSONLazyValue_t child = { parent.document, LAZY_NO_VALUE };
+
+   if (!key || getLazyType(parent) != OBJECT){
+      return child;
+   }
+
+   size_t keyLength = strlen(key);
+   for (size_t entry = firstEntry(parent.document, parent.entry); entry != LAZY_NO_VALUE; entry = nextEntry(parent.document, entry)){
+      //The key is the quotes 3 entries in front of the value
+      if (keyMatches(parent.document, entry - 3, key, keyLength)){
+         child.entry = entry;
+         break;
+      }
+   }
+
+   return child;
+}
+
+/**
+ * Finds the value at an index of an array. The values in front of it are
+ * stepped over without being read.
+ *
+ * @param parent - The array to look in
+ * @param index - The index of the value, starting at 0
+ * @return The value, or a value that does not exist if the parent is not
+ *    an array, or the index is past the end of it
+ */
+JSONLazyValue_t getLazyElement(JSONLazyValue_t parent, int index){
+   JSONLazyValue_t element = { parent.document, LAZY_NO_VALUE };
+
+   if (index < 0 || getLazyType(parent) != ARRAY){
+      return element;
+   }
+
+   size_t entry = firstEntry(parent.document, parent.entry);
+   while (entry != LAZY_NO_VALUE && index > 0){
+      entry = nextEntry(parent.document, entry);
+      index--;
+   }
+
+   element.entry = entry;
+   return element;
+}
+
+/**
+ * Gets the first value in an object or array. Together with getLazyNext()
+ * this walks every value in it.
+ *
+ * @param parent - The object or array
+ * @return The first value, or a value that does not exist if the parent is
+ *    empty, or is not an object or array
+ */
+JSONLazyValue_t getLazyFirst(JSONLazyValue_t parent){
+   JSONLazyValue_t first = { parent.document, LAZY_NO_VALUE };
+   JSONType_t type = getLazyType(parent);
+
+   if (type == OBJECT || type == ARRAY){
+      first.entry = firstEntry(parent.document, parent.entry);
+   }
+
+   return first;
+}
+
+/**
+ * Gets the value that comes after this one in its object or array.
+ *
+ * @param value - A value returned by getLazyFirst() or getLazyNext()
+ * @return The next value, or a value that does not exist if this was the last one
+ */
+JSONLazyValue_t getLazyNext(JSONLazyValue_t value){
+   JSONLazyValue_t next = { value.document, LAZY_NO_VALUE };
+
+   if (isLazyValue(value) && value.entry != 0){
+      next.entry = nextEntry(value.document, value.entry);
+   }
+
+   return next;
+}
+
+/**
+ * Counts the values in an object or array the same way the length of a
+ * pair is counted. Other values have a length of 1.
+ *
+ * @param value - The value
+ * @return The number of values in it, 0 if the value does not exist
+ */
+int getLazyLength(JSONLazyValue_t value){
+   JSONType_t type = getLazyType(value);
+
+   if (!isLazyValue(value)){
+      return 0;
+   }
+
+   if (type != OBJECT && type != ARRAY){
+      return 1;
+   }
+
+   int length = 0;
+   for (size_t entry = firstEntry(value.document, value.entry); entry != LAZY_NO_VALUE; entry = nextEntry(value.document, entry)){
+      length++;
+   }
+
+   return length;
+}
+
+/**
+ * Gets the key of a value in an object. The key is converted the same way
+ * the parser converts keys the first time it is read, and kept until the
+ * document is disposed of. Reading it again returns the same copy.
+ *
+ * @param value - A value in an object
+ * @return The key, or NULL if the value is not in an object
+ */
+const char* getLazyKey(JSONLazyValue_t value){
+   if (!isLazyValue(value) || value.entry < 3 || entryCharacter(value.document, value.entry - 1) != ':'){
+      return NULL;
+   }
+
+   char** slot = stringSlot(value.document, value.entry - 3);
+   if (!slot){
+      return NULL;
+   }
+
+   char* raw = *slot;
+   if (raw){
+      //Already read, and converted if it needed to be
+      return raw;
+   }
+
+   if (copyString(value.document, value.entry - 3, &raw) || !strchr(raw, '\\')){
+      return raw;
+   }
+
+   //The slot holds the raw copy until the key is converted
+   *slot = NULL;
+   char* converted = NULL;
+   if (convertString(raw, &converted)){
+      return NULL;
+   }
+
+   //Keep the converted key with the rest of the documents strings
+   size_t length = strlen(converted);
+   char* key = (char*)allocateFromArena(value.document->arena, length + 1);
+   if (key){
+      memcpy(key, converted, length + 1);
+   }
+   *slot = key;
+   free(converted);
+
+   return key;
+}
+
+/**
+ * Gets the string contents of a value. The string is copied out of the
+ * message the first time it is read, the same way the parser would store
+ * it, and is kept until the document is disposed of. Reading it again
+ * returns the same copy.
+ *
+ * @param value - The value that holds a string
+ * @param string - Will point to the string
+ * @return JSON_SUCCESS, JSON_NO_MATCHING_PAIR if the value does not exist,
+ *    JSON_INVALID_ARGUMENT if it is not a string, JSON_INVALID_UNICODE_SEQ,
+ *    or JSON_MALLOC_FAIL
+ */
+JSONError_t getLazyString(JSONLazyValue_t value, const char** string){
+   if (!string){
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!isLazyValue(value)){
+      return JSON_NO_MATCHING_PAIR;
+   }
+
+   if (getLazyType(value) != STRING){
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   return copyString(value.document, value.entry, (char**)string);
+}
+
+/**
+ * Gets the number contents of a value. The number is converted when it is
+ * read, with the same rules the parser uses.
+ *
+ * @param value - The value that holds a number
+ * @param number - Will hold the number
+ * @return JSON_SUCCESS, JSON_NO_MATCHING_PAIR if the value does not exist,
+ *    JSON_INVALID_ARGUMENT if it is not a number, or the problem with the number
+ */
+JSONError_t getLazyNumber(JSONLazyValue_t value, double* number){
+   if (!number){
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!isLazyValue(value)){
+      return JSON_NO_MATCHING_PAIR;
+   }
+
+   if (getLazyType(value) != NUMBER){
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   const char* token = &value.document->message[value.document->positions[value.entry]];
+   return stringToNumber(token, scalarLength(value.document, value.entry), number);
+}
+
+/**
+ * Gets the boolean contents of a value.
+ *
+ * @param value - The value that holds true or false
+ * @param boolean - Will hold the value
+ * @return JSON_SUCCESS, JSON_NO_MATCHING_PAIR if the value does not exist,
+ *    JSON_INVALID_ARGUMENT if it is not a boolean, or JSON_INVALID_VALUE if
+ *    it is not spelled right
+ */
+JSONError_t getLazyBoolean(JSONLazyValue_t value, bool* boolean){
+   if (!boolean){
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!isLazyValue(value)){
+      return JSON_NO_MATCHING_PAIR;
+   }
+
+   if (getLazyType(value) != BOOLEAN){
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   const char* token = &value.document->message[value.document->positions[value.entry]];
+   size_t length = scalarLength(value.document, value.entry);
+
+   if (length == 4 && memcmp(token, "true", 4) == 0){
+      *boolean = true;
+   }
+   else if (length == 5 && memcmp(token, "false", 5) == 0){
+      *boolean = false;
+   }
+   else {
+      return JSON_INVALID_VALUE;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Gets the string contents of a value without any error handling.
+ *
+ * @param value - The value that holds a string
+ * @return The string, or NULL if the value is not a string
+ * @see getLazyString
+ */
+const char* getLazyStringVal(JSONLazyValue_t value){
+   const char* string = NULL;
+
+   if (getLazyString(value, &string)){
+      return NULL;
+   }
+
+   return string;
+}
+
+/**
+ * Gets the number contents of a value without any error handling.
+ *
+ * @param value - The value that holds a number
+ * @return The number, or 0.0 if the value is not a number
+ * @see getLazyNumber
+ */
+double getLazyNumberVal(JSONLazyValue_t value){
+   double number = 0.0;
+
+   if (getLazyNumber(value, &number)){
+      return 0.0;
+   }
+
+   return number;
+}
+
+/**
+ * Gets the boolean contents of a value without any error handling.
+ *
+ * @param value - The value that holds a boolean
+ * @return The boolean, or false if the value is not a boolean
+ * @see getLazyBoolean
+ */
+bool getLazyBooleanVal(JSONLazyValue_t value){
+   bool boolean = false;
+
+   if (getLazyBoolean(value, &boolean)){
+      return false;
+   }
+
+   return boolean;
+}
+
+/**
+ * Builds a regular document out of one value, so the rest of the library
+ * can be used on it. Objects and arrays are run through the parser, which
+ * checks everything in them. The new pair belongs to the caller and has
+ * to be disposed of with disposeOfPair().
+ *
+ * @param value - The value to build
+ * @param pair - Where the new pair is placed
+ * @return JSON_SUCCESS, JSON_NO_MATCHING_PAIR if the value does not exist,
+ *    or the problem that was found in the value
+ */
+JSONError_t getLazyPair(JSONLazyValue_t value, JSONKeyValue_t** pair){
+   if (!pair){
+      return JSON_NULL_ARGUMENT;
+   }
+
+   *pair = NULL;
+
+   if (!isLazyValue(value)){
+      return JSON_NO_MATCHING_PAIR;
+   }
+
+   JSONLazyDocument_t* document = value.document;
+   JSONType_t type = getLazyType(value);
+   JSONError_t returnStatus = JSON_SUCCESS;
+
+   if (type == OBJECT || type == ARRAY){
+      size_t start = document->positions[value.entry];
+      size_t end = document->positions[document->ends[value.entry] - 1] + 1;
+      size_t consumed = 0;
+
+      JSONParser_t* parser = newJSONParser();
+      if (!parser){
+         return JSON_MALLOC_FAIL;
+      }
+
+      returnStatus = parseJSONBuffer(parser, pair, &document->message[start], end - start, &consumed);
+      disposeOfJSONParser(parser);
+      return returnStatus;
+   }
+
+   JSONValue_t* newValue = NULL;
+   if (type == STRING){
+      const char* string = NULL;
+      returnStatus = getLazyString(value, &string);
+      if (returnStatus){
+         return returnStatus;
+      }
+
+      //The string is already in the form the document keeps it in, so it
+      //is not escaped again like newJSONString() would
+      newValue = (JSONValue_t*)malloc(sizeof(JSONValue_t));
+      if (newValue){
+         memset(newValue, 0, sizeof(JSONValue_t));
+         newValue->sVal = strdup(string);
+         if (!newValue->sVal){
+            free(newValue);
+            newValue = NULL;
+         }
+      }
+   }
+   else if (type == NUMBER){
+      double number = 0.0;
+      returnStatus = getLazyNumber(value, &number);
+      if (returnStatus){
+         return returnStatus;
+      }
+
+      newValue = newJSONNumber(number);
+   }
+   else if (type == BOOLEAN){
+      bool boolean = false;
+      returnStatus = getLazyBoolean(value, &boolean);
+      if (returnStatus){
+         return returnStatus;
+      }
+
+      newValue = newJSONBoolean(boolean);
+   }
+   else {
+      if (scalarLength(document, value.entry) != 4 || memcmp(&document->message[document->positions[value.entry]], "null", 4) != 0){
+         return JSON_INVALID_VALUE;
+      }
+
+      *pair = takeJSONPair(NIL, NULL, NULL);
+      return (*pair) ? JSON_SUCCESS : JSON_MALLOC_FAIL;
+   }
+
+   if (!newValue){
+      return JSON_MALLOC_FAIL;
+   }
+
+   *pair = takeJSONPair(type, NULL, newValue);
+   if (!*pair){
+      if (type == STRING){
+         free(newValue->sVal);
+      }
+      free(newValue);
+      return JSON_MALLOC_FAIL;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Frees the index and every string that was read out of the document.
+ * The message itself is left alone.
+ *
+ * @param document - The document that was created by parseJSONLazy()
+ */
+void disposeOfJSONLazyDocument(JSONLazyDocument_t* document){
+   if (!document){
+      return;
+   }
+
+   free(document->positions);
+   free(document->ends);
+   free(document->strings);
+   disposeOfJSONArena(document->arena);
+   free(document);
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Runs the structural scanner over the whole message and records every
+ * position it finds.
+ *
+ * @param document - The document being built
+ * @return JSON_SUCCESS, or JSON_MALLOC_FAIL
+ */
+static JSONError_t indexMessage(JSONLazyDocument_t* document){
+   JSONScanner_t scanner;
+   size_t capacity = document->length / 4 + LAZY_INDEX_SIZE;
+   size_t found;
+
+   document->positions = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+   if (!document->positions){
+      return JSON_MALLOC_FAIL;
+   }
+
+   initJSONScanner(&scanner, document->message, 0, document->length);
+   do {
+      if (capacity - document->count < SCAN_BLOCK_SIZE){
+         capacity *= 2;
+         uint32_t* positions = (uint32_t*)realloc(document->positions, capacity * sizeof(uint32_t));
+         if (!positions){
+            return JSON_MALLOC_FAIL;
+         }
+         document->positions = positions;
+      }
+
+      found = nextStructurals(&scanner, &document->positions[document->count], capacity - document->count);
+      document->count += found;
+   } while (found);
+
+   //Every entry gets an end, even though only the values use theirs
+   document->ends = (uint32_t*)malloc((document->count + 1) * sizeof(uint32_t));
+   if (!document->ends){
+      return JSON_MALLOC_FAIL;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Walks the index to make sure the message is put together correctly, and
+ * records where each value ends. Each entry is classified and looked up in
+ * the transition table, so the only branches are for the entries that need
+ * more than a change of state. Open objects and arrays are kept on a stack
+ * along with the state to go back to when they close.
+ *
+ * @param document - The document being built
+ * @return JSON_SUCCESS, or the problem that was found in the message
+ */
+static JSONError_t checkStructure(JSONLazyDocument_t* document){
+   const char* message = document->message;
+   const uint32_t* positions = document->positions;
+   uint32_t* ends = document->ends;
+   size_t count = document->count;
+   size_t stackSize = LAZY_STACK_SIZE;
+   size_t depth = 0;
+   size_t entry = 0;
+   int state = LAZY_ROOT;
+
+   LazyFrame_t* stack = (LazyFrame_t*)malloc(stackSize * sizeof(LazyFrame_t));
+   if (!stack){
+      return JSON_MALLOC_FAIL;
+   }
+
+   while (entry < count){
+      int characterClass = characterClasses[(unsigned char)message[positions[entry]]];
+      int next = transitions[state][characterClass];
+
+      if (next == LAZY_ERROR){
+         free(stack);
+         return (state == LAZY_ROOT || state == LAZY_DONE) ? JSON_INVALID_MESSAGE : classErrors[characterClass];
+      }
+
+      //A string takes up two entries, its quotes. Only the end of the
+      //opening quote is ever used.
+      ends[entry] = entry + 1 + (characterClass == CLASS_QUOTE);
+
+      if (characterClass >= CLASS_CLOSE_OBJECT){
+         depth--;
+         ends[stack[depth].entry] = entry + 1;
+         next = stack[depth].state;
+      }
+      else if (characterClass >= CLASS_OPEN_OBJECT){
+         if (depth == stackSize){
+            stackSize *= 2;
+            LazyFrame_t* newStack = (LazyFrame_t*)realloc(stack, stackSize * sizeof(LazyFrame_t));
+            if (!newStack){
+               free(stack);
+               return JSON_MALLOC_FAIL;
+            }
+            stack = newStack;
+         }
+
+         //Once this closes, carry on as if it was any other value
+         stack[depth].entry = entry;
+         stack[depth].state = valueDone[state];
+         depth++;
+      }
+
+      state = next;
+      entry++;
+   }
+
+   free(stack);
+   return (state == LAZY_DONE) ? JSON_SUCCESS : JSON_MESSAGE_INCOMPLETE;
+}
+
+/**
+ * Gets the character in the message at an entry in the index.
+ *
+ * @param document - The lazy document
+ * @param entry - The entry in the index
+ * @return The character at that entry
+ */
+static char entryCharacter(JSONLazyDocument_t* document, size_t entry){
+   return document->message[document->positions[entry]];
+}
+
+/**
+ * Finds the length of a number or literal. It runs up to the next entry
+ * in the index, less any white space in between.
+ *
+ * @param document - The lazy document
+ * @param entry - The entry of the number or literal
+ * @return The number of characters in it
+ */
+static size_t scalarLength(JSONLazyDocument_t* document, size_t entry){
+   size_t start = document->positions[entry];
+   size_t end = (entry + 1 < document->count) ? document->positions[entry + 1] : document->length;
+
+   while (end > start && isspace((unsigned char)document->message[end - 1])){
+      end--;
+   }
+
+   return end - start;
+}
+
+/**
+ * Finds the first value in an object or array. Values in an object come
+ * 3 entries after the start of their key (quote, quote, colon).
+ *
+ * @param document - The lazy document
+ * @param entry - The entry of the '{' or '['
+ * @return The entry of the first value, or LAZY_NO_VALUE if it is empty
+ */
+static size_t firstEntry(JSONLazyDocument_t* document, size_t entry){
+   char open = entryCharacter(document, entry);
+   char first = entryCharacter(document, entry + 1);
+
+   if (first == '}' || first == ']'){
+      return LAZY_NO_VALUE;
+   }
+
+   return (open == '{') ? entry + 4 : entry + 1;
+}
+
+/**
+ * Steps over a value to the one after it in the same object or array.
+ *
+ * @param document - The lazy document
+ * @param entry - The entry of the current value
+ * @return The entry of the next value, or LAZY_NO_VALUE if this was the last one
+ */
+static size_t nextEntry(JSONLazyDocument_t* document, size_t entry){
+   size_t after = document->ends[entry];
+
+   if (after >= document->count || entryCharacter(document, after) != ','){
+      return LAZY_NO_VALUE;
+   }
+
+   //A key is followed by a ':' where a string in an array is not
+   if (after + 3 < document->count && entryCharacter(document, after + 3) == ':'){
+      return after + 4;
+   }
+
+   return after + 1;
+}
+
+/**
+ * Compares the key of a pair with the key being looked for. Keys without
+ * escape sequences are compared right in the message.
+ *
+ * @param document - The lazy document
+ * @param entry - The entry of the opening quote of the key
+ * @param key - The key being looked for
+ * @param keyLength - The length of the key being looked for
+ * @return true if they are the same key
+ */
+static bool keyMatches(JSONLazyDocument_t* document, size_t entry, const char* key, size_t keyLength){
+   const char* start = &document->message[document->positions[entry] + 1];
+   size_t length = document->positions[entry + 1] - document->positions[entry] - 1;
+
+   if (!memchr(start, '\\', length)){
+      return length == keyLength && memcmp(start, key, length) == 0;
+   }
+
+   //Escape sequences only ever get shorter
+   if (length < keyLength){
+      return false;
+   }
+
+   char* raw = (char*)malloc(length + 1);
+   char* converted = NULL;
+   bool matches = false;
+
+   if (raw){
+      memcpy(raw, start, length);
+      raw[length] = '\0';
+      if (convertString(raw, &converted) == JSON_SUCCESS){
+         matches = strcmp(converted, key) == 0;
+         free(converted);
+      }
+      free(raw);
+   }
+
+   return matches;
+}
+
+/**
+ * Copies a string out of the message into the documents arena. The
+ * string is checked and control characters are escaped the same way the
+ * parser does it, so the string matches what would be in a parsed document.
+ * The copy is remembered, so a string that is read again is not copied again.
+ *
+ * @param document - The lazy document
+ * @param entry - The entry of the opening quote of the string
+ * @param string - Will point to the null terminated string
+ * @return JSON_SUCCESS, JSON_INVALID_UNICODE_SEQ, or JSON_MALLOC_FAIL
+ */
+static JSONError_t copyString(JSONLazyDocument_t* document, size_t entry, char** string){
+   char** slot = stringSlot(document, entry);
+   if (!slot){
+      return JSON_MALLOC_FAIL;
+   }
+
+   if (*slot){
+      *string = *slot;
+      return JSON_SUCCESS;
+   }
+
+   const char* token = &document->message[document->positions[entry] + 1];
+   size_t length = document->positions[entry + 1] - document->positions[entry] - 1;
+
+   if (!document->arena){
+      document->arena = newJSONArena(0);
+      if (!document->arena){
+         return JSON_MALLOC_FAIL;
+      }
+   }
+
+   //Each control character needs room for one more character
+   size_t specialCharCount = 0;
+   for (size_t i = findEscapeOrControl(token, 0, length); i < length; i = findEscapeOrControl(token, i, length)){
+      if (token[i] == '\\'){
+         if (i + 1 < length && (token[i + 1] == 'u' || token[i + 1] == 'U')){
+            for (size_t j = i + 2; j < i + 6; j++){
+               if (j >= length || !isxdigit((unsigned char)token[j])){
+                  return JSON_INVALID_UNICODE_SEQ;
+               }
+            }
+         }
+         i += 2;
+      }
+      else {
+         specialCharCount++;
+         i++;
+      }
+   }
+
+   char* copy = (char*)allocateFromArena(document->arena, length + specialCharCount + 1);
+   if (!copy){
+      return JSON_MALLOC_FAIL;
+   }
+
+   *string = copy;
+   *slot = copy;
+   if (!specialCharCount){
+      memcpy(copy, token, length);
+      copy[length] = '\0';
+      return JSON_SUCCESS;
+   }
+
+   size_t copyIndex = 0;
+   for (size_t i = 0; i < length; i++){
+      switch (token[i]){
+         case '\\' :
+            copy[copyIndex++] = token[i++];
+            if (i < length){
+               copy[copyIndex++] = token[i];
+            }
+            break;
+         case '\b' : copy[copyIndex++] = '\\'; copy[copyIndex++] = 'b'; break;
+         case '\f' : copy[copyIndex++] = '\\'; copy[copyIndex++] = 'f'; break;
+         case '\n' : copy[copyIndex++] = '\\'; copy[copyIndex++] = 'n'; break;
+         case '\r' : copy[copyIndex++] = '\\'; copy[copyIndex++] = 'r'; break;
+         case '\t' : copy[copyIndex++] = '\\'; copy[copyIndex++] = 't'; break;
+         default : copy[copyIndex++] = token[i]; break;
+      }
+   }
+   copy[copyIndex] = '\0';
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Finds where the copy of a string or key is remembered. The slots are
+ * only allocated when the first string is read, one for each entry in the
+ * index, so documents that never read a string do not pay for them.
+ *
+ * @param document - The lazy document
+ * @param entry - The entry of the opening quote of the string
+ * @return The slot, it holds NULL if the string has not been read yet, or
+ *    NULL if the slots could not be allocated
+ */
+static char** stringSlot(JSONLazyDocument_t* document, size_t entry){
+   if (!document->strings){
+      document->strings = (char**)calloc(document->count, sizeof(char*));
+      if (!document->strings){
+         return NULL;
+      }
+   }
+
+   return &document->strings[entry];
+}
@@ -0,0 +1,76 @@
+#ifndef _JSON_LAZY_H
+#define _JSON_LAZY_H
+
+#include <stdint.h>
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+#include "jsonmemory.h"
+
+#define LAZY_NO_VALUE            ((size_t)-1)
+
+/**
+ * A lazy document is a JSON message that has been checked and indexed,
+ * but not built into pairs. One pass over the message finds every
+ * structural character, string, and value, and records where each object
+ * and array ends. Values are only converted when they are asked for, and
+ * anything that is not asked for is stepped over without being looked at.
+ * This is much faster than parseJSONMessage() when only a few values are
+ * needed out of a large message.
+ *
+ * The document points into the message, so the message has to stay around
+ * (unchanged) until the document is disposed of.
+ */
+typedef struct {
+   const char* message;    /**< The message that was indexed */
+   size_t length;          /**< The length of the message */
+   uint32_t* positions;    /**< Where each entry in the index is in the message */
+   uint32_t* ends;         /**< For each entry that starts a value, the entry just past that value */
+   size_t count;           /**< The number of entries in the index */
+   JSONArena_t* arena;     /**< Holds strings that have been copied out of the message */
+   char** strings;         /**< The copy of each string or key that has been read, by the entry of its opening quote */
+} JSONLazyDocument_t;
+
+/**
+ * One value in a lazy document. It is small enough to pass around by
+ * value. A value that was not found has its entry set to LAZY_NO_VALUE,
+ * and every accessor handles that, so lookups can be chained without
+ * checking each step.
+ */
+typedef struct {
+   JSONLazyDocument_t* document; /**< The document the value is in */
+   size_t entry;                 /**< Where the value starts in the documents index */
+} JSONLazyValue_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONError_t parseJSONLazy(JSONLazyDocument_t** document, const char* message, size_t length);
+JSONLazyValue_t getLazyRoot(JSONLazyDocument_t* document);
+bool isLazyValue(JSONLazyValue_t value);
+JSONType_t getLazyType(JSONLazyValue_t value);
+JSONLazyValue_t getLazyChild(JSONLazyValue_t parent, const char* key);
+JSONLazyValue_t getLazyElement(JSONLazyValue_t parent, int index);
+JSONLazyValue_t getLazyFirst(JSONLazyValue_t parent);
+JSONLazyValue_t getLazyNext(JSONLazyValue_t value);
+int getLazyLength(JSONLazyValue_t value);
+const char* getLazyKey(JSONLazyValue_t value);
+JSONError_t getLazyString(JSONLazyValue_t value, const char** string);
+JSONError_t getLazyNumber(JSONLazyValue_t value, double* number);
+JSONError_t getLazyBoolean(JSONLazyValue_t value, bool* boolean);
+const char* getLazyStringVal(JSONLazyValue_t value);
+double getLazyNumberVal(JSONLazyValue_t value);
+bool getLazyBooleanVal(JSONLazyValue_t value);
+JSONError_t getLazyPair(JSONLazyValue_t value, JSONKeyValue_t** pair);
+void disposeOfJSONLazyDocument(JSONLazyDocument_t* document);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
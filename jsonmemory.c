@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jsontools.h"
+
+#define ARENA_ALIGNMENT          8
+
+/**
+ * The root of a document built in an arena. The root is always the first
+ * thing allocated from the arena, and remembers the arena so the whole
+ * document can be freed from its root pair.
+ */
+typedef struct {
+   JSONKeyValue_t pair;    /**< The root pair, this must be first */
+   JSONValue_t value;      /**< The value of the root pair */
+   JSONArena_t* arena;     /**< The arena the document was built in */
+} JSONArenaDocument_t;
+
+/**
+ * A pair and its value, allocated together.
+ */
+typedef struct {
+   JSONKeyValue_t pair;    /**< The pair, this must be first */
+   JSONValue_t value;      /**< The value of the pair */
+} JSONArenaPair_t;
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static JSONArenaBlock_t* nextArenaBlock(JSONArena_t* arena, size_t size);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Creates a new arena. The arena and its first block are allocated
+ * together, so a small document only ever costs a single malloc.
+ *
+ * @param blockSize - The size of the first block, 0 for ARENA_BLOCK_SIZE
+ * @return The new arena, or NULL if memory could not be allocated
+ */
+JSONArena_t* newJSONArena(size_t blockSize){
+   if (blockSize == 0){
+      blockSize = ARENA_BLOCK_SIZE;
+   }
+
+   blockSize = (blockSize + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+   JSONArena_t* arena = (JSONArena_t*)malloc(sizeof(JSONArena_t) + sizeof(JSONArenaBlock_t) + blockSize);
+   if (!arena){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   JSONArenaBlock_t* block = (JSONArenaBlock_t*)(arena + 1);
+   block->next = NULL;
+   block->size = blockSize;
+   block->used = 0;
+
+   arena->first = block;
+   arena->current = block;
+   arena->merged = NULL;
+   arena->blockSize = (blockSize < ARENA_MAX_BLOCK_SIZE / 2) ? blockSize * 2 : ARENA_MAX_BLOCK_SIZE;
+
+   return arena;
+}
+
+/**
+ * Hands out memory from the arena. The memory is not cleared, and it can
+ * not be freed on its own. It goes away when the arena is reset or
+ * disposed of.
+ *
+ * @param arena - The arena to allocate from
+ * @param size - The number of bytes needed
+ * @return A pointer to the memory, or NULL if memory could not be allocated
+ */
+void* allocateFromArena(JSONArena_t* arena, size_t size){
+   JSONArenaBlock_t* block = arena->current;
+
+   size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+   if (block->size - block->used < size){
+      block = nextArenaBlock(arena, size);
+      if (!block){
+         json_errno = JSON_MALLOC_FAIL;
+         return NULL;
+      }
+   }
+
+   void* memory = (char*)(block + 1) + block->used;
+   block->used += size;
+
+   return memory;
+}
+
+/**
+ * Rewinds the arena so all of its memory can be handed out again. The
+ * blocks are kept, so an arena that has been used for one message will
+ * not need to allocate anything for the next message of the same size.
+ * Any arenas that were merged into it are disposed of. Anything that was
+ * allocated from the arena before is no longer valid.
+ *
+ * @param arena - The arena to rewind
+ */
+void resetJSONArena(JSONArena_t* arena){
+   if (!arena){
+      return;
+   }
+
+   disposeOfJSONArena(arena->merged);
+   arena->merged = NULL;
+   arena->current = arena->first;
+   arena->first->used = 0;
+}
+
+/**
+ * Frees the arena, any arenas merged into it, and everything that was
+ * allocated from them.
+ *
+ * @param arena - The arena that was created with newJSONArena()
+ */
+void disposeOfJSONArena(JSONArena_t* arena){
+   while (arena){
+      JSONArena_t* merged = arena->merged;
+      JSONArenaBlock_t* block = arena->first->next;
+      while (block != NULL){
+         JSONArenaBlock_t* next = block->next;
+         free(block);
+         block = next;
+      }
+
+      free(arena);
+      arena = merged;
+   }
+}
+
+/**
+ * Hands one arena over to another. Everything allocated from the other
+ * arena stays where it is, and is freed when the arena it was merged into
+ * is disposed of (or reset). This is how documents built on different
+ * threads are joined into one. The other arena can not be used after this.
+ *
+ * @param arena - The arena that takes over the other arena
+ * @param other - The arena being handed over
+ */
+void mergeJSONArena(JSONArena_t* arena, JSONArena_t* other){
+   if (!arena || !other || arena == other){
+      return;
+   }
+
+   JSONArena_t* last = other;
+   while (last->merged){
+      last = last->merged;
+   }
+
+   last->merged = arena->merged;
+   arena->merged = other;
+}
+
+/**
+ * Creates a new pair in the arena. The value is allocated right along
+ * with the pair, NULL values do not get a value.
+ *
+ * @param arena - The arena to allocate from
+ * @param type - The type of the new pair
+ * @return The new pair, or NULL if memory could not be allocated
+ */
+JSONKeyValue_t* newArenaPair(JSONArena_t* arena, JSONType_t type){
+   size_t size = (type == NIL) ? sizeof(JSONKeyValue_t) : sizeof(JSONArenaPair_t);
+   JSONArenaPair_t* newPair = (JSONArenaPair_t*)allocateFromArena(arena, size);
+   if (!newPair){
+      return NULL;
+   }
+
+   memset(&newPair->pair, 0, sizeof(JSONKeyValue_t));
+   if (type != NIL){
+      memset(&newPair->value, 0, sizeof(JSONValue_t));
+      newPair->pair.value = &newPair->value;
+   }
+
+   newPair->pair.type = type;
+   newPair->pair.length = 1;
+   newPair->pair.flags = PAIR_IN_ARENA;
+
+   return &newPair->pair;
+}
+
+/**
+ * Creates the root pair of a document that owns the arena. The arena
+ * should be empty, and belongs to the document from then on: disposing
+ * of the root pair with disposeOfPair() disposes of the arena.
+ *
+ * @param arena - The arena the document will be built in
+ * @param type - OBJECT or ARRAY
+ * @return The new root pair, or NULL if memory could not be allocated
+ */
+JSONKeyValue_t* newArenaDocument(JSONArena_t* arena, JSONType_t type){
+   JSONArenaDocument_t* document = (JSONArenaDocument_t*)allocateFromArena(arena, sizeof(JSONArenaDocument_t));
+   if (!document){
+      return NULL;
+   }
+
+   memset(document, 0, sizeof(JSONArenaDocument_t));
+   document->pair.type = type;
+   document->pair.length = 1;
+   document->pair.value = &document->value;
+   document->pair.flags = PAIR_IN_ARENA | PAIR_ARENA_ROOT;
+   document->arena = arena;
+
+   return &document->pair;
+}
+
+/**
+ * Finds the arena that owns a document.
+ *
+ * @param document - The root pair of a document
+ * @return The arena, or NULL if the document was not built in an arena
+ */
+JSONArena_t* getDocumentArena(JSONKeyValue_t* document){
+   if (!document || !(document->flags & PAIR_ARENA_ROOT)){
+      return NULL;
+   }
+
+   return ((JSONArenaDocument_t*)document)->arena;
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Moves the arena on to a block that can hold size bytes. Blocks left
+ * over from before the arena was reset are used again if they are big
+ * enough, otherwise a new block is linked in after the current one.
+ *
+ * @param arena - The arena that ran out of room
+ * @param size - The number of bytes needed
+ * @return The block to allocate from, or NULL if memory could not be allocated
+ */
+static JSONArenaBlock_t* nextArenaBlock(JSONArena_t* arena, size_t size){
+   JSONArenaBlock_t* current = arena->current;
+
+   if (current->next && current->next->size >= size){
+      current = current->next;
+      current->used = 0;
+      arena->current = current;
+      return current;
+   }
+
+   size_t blockSize = arena->blockSize;
+   while (blockSize < size){
+      blockSize *= 2;
+   }
+
+   JSONArenaBlock_t* block = (JSONArenaBlock_t*)malloc(sizeof(JSONArenaBlock_t) + blockSize);
+   if (!block){
+      return NULL;
+   }
+
+   block->next = current->next;
+   block->size = blockSize;
+   block->used = 0;
+   current->next = block;
+   arena->current = block;
+
+   arena->blockSize = (arena->blockSize < ARENA_MAX_BLOCK_SIZE / 2) ? arena->blockSize * 2 : ARENA_MAX_BLOCK_SIZE;
+
+   return block;
+}
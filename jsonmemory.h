@@ -0,0 +1,54 @@
+#ifndef _JSON_MEMORY_H
+#define _JSON_MEMORY_H
+
+#include "jsoncommon.h"
+
+#define ARENA_BLOCK_SIZE         4096
+#define ARENA_MAX_BLOCK_SIZE     (1024 * 1024)
+
+/**
+ * One block of memory in an arena. The usable memory follows right after
+ * the header.
+ */
+typedef struct _json_arena_block_t {
+   struct _json_arena_block_t* next; /**< The next block in the arena */
+   size_t size;                      /**< How many bytes the block can hold */
+   size_t used;                      /**< How many bytes have been handed out */
+} JSONArenaBlock_t;
+
+/**
+ * An arena is a bump pointer allocator. Memory is handed out from large
+ * blocks and is never freed one piece at a time, the whole arena is thrown
+ * away (or rewound to be used again) at once. Each new block is twice the
+ * size of the last, up to ARENA_MAX_BLOCK_SIZE. The arena and its first
+ * block are a single allocation.
+ */
+typedef struct _json_arena_t {
+   JSONArenaBlock_t* first;   /**< The first block, it sits right after the arena */
+   JSONArenaBlock_t* current; /**< The block memory is being handed out from */
+   size_t blockSize;          /**< The size of the next block that is created */
+   struct _json_arena_t* merged; /**< Other arenas that were merged into this one (see mergeJSONArena) */
+} JSONArena_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONArena_t* newJSONArena(size_t blockSize);
+void* allocateFromArena(JSONArena_t* arena, size_t size);
+void resetJSONArena(JSONArena_t* arena);
+void disposeOfJSONArena(JSONArena_t* arena);
+void mergeJSONArena(JSONArena_t* arena, JSONArena_t* other);
+JSONKeyValue_t* newArenaPair(JSONArena_t* arena, JSONType_t type);
+JSONKeyValue_t* newArenaDocument(JSONArena_t* arena, JSONType_t type);
+JSONArena_t* getDocumentArena(JSONKeyValue_t* document);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
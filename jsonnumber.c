@@ -0,0 +1,476 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+
+#include "jsonnumber.h"
+#include "jsonpowers.h"
+
+#define MAX_MANTISSA_DIGITS      19
+#define MAX_EXACT_INTEGER        9007199254740992ULL  /**< 2^53 */
+#define MAX_EXACT_POWER          22
+#define MAX_EXPONENT_VALUE       100000
+#define NUMBER_BUFFER_SIZE       64
+
+/**
+ * The pieces of a number that the grammar check pulls out. The value
+ * is mantissa * 10^exponent, where the mantissa holds the first 19
+ * significant digits.
+ */
+typedef struct {
+   uint64_t mantissa;   /**< The first 19 significant digits */
+   int64_t exponent;    /**< The power of ten to scale the mantissa by */
+   bool negative;       /**< The number had a leading '-' */
+   bool truncated;      /**< There were more than 19 significant digits */
+} JSONDecimal_t;
+
+/**
+ * The powers of ten that a double can hold exactly
+ */
+static const double exactPowersOfTen[] = {
+   1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*----------------------------------------------------------------
+ * Define private helper functions
+ *---------------------------------------------------------------*/
+
+static bool scanNumber(const char* token, size_t length, JSONDecimal_t* decimal);
+static bool computeDouble(int64_t power, uint64_t mantissa, bool negative, double* value);
+static uint64_t fullMultiply(uint64_t a, uint64_t b, uint64_t* low);
+static double makeDouble(uint64_t mantissa, int64_t exponent, bool negative);
+static JSONError_t slowStringToNumber(const char* token, size_t length, double* value);
+
+/*----------------------------------------------------------------
+ * Implement global functions
+ *--------------------------------------------------------------*/
+
+/**
+ * Converts a JSON number into a double. The number has to follow the JSON
+ * grammar exactly: an optional '-', then either 0 or digits that do not
+ * start with 0, an optional fraction, and an optional exponent. The result
+ * is always the closest double to the number (rounding to even on ties).
+ *
+ * Most numbers are handled without any floating point rounding at all:
+ * integers up to 2^53 are exact, small powers of ten are applied with one
+ * exact operation (Clinger's fast path), and everything else goes through
+ * the Eisel-Lemire algorithm using the table in jsonpowers.h. Only numbers
+ * with more than 19 significant digits that land too close to the half way
+ * point between two doubles fall back to strtod().
+ *
+ * @param token - The characters of the number, they do not need to be null terminated
+ * @param length - The number of characters
+ * @param value - Where the number will be stored
+ * @return JSON_SUCCESS, JSON_INVALID_VALUE if the number does not follow
+ *    the JSON grammar, or JSON_NUMBER_OUT_OF_RANGE if the number is too large
+ *    (or too small) for a double
+ */
+JSONError_t stringToNumber(const char* token, size_t length, double* value){
+   JSONDecimal_t decimal;
+
+   if (!token || !value){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!scanNumber(token, length, &decimal)){
+      json_errno = JSON_INVALID_VALUE;
+      return JSON_INVALID_VALUE;
+   }
+
+   if (decimal.mantissa == 0){
+      //Zero with any exponent is still zero
+      *value = (decimal.negative) ? -0.0 : 0.0;
+      return JSON_SUCCESS;
+   }
+
+   if (!decimal.truncated){
+      //Integers that fit in 53 bits are exact
+      if (decimal.exponent == 0 && decimal.mantissa <= MAX_EXACT_INTEGER){
+         double result = (double)decimal.mantissa;
+         *value = (decimal.negative) ? -result : result;
+         return JSON_SUCCESS;
+      }
+
+#if (FLT_EVAL_METHOD == 0) || (FLT_EVAL_METHOD == 1)
+      //Clinger's fast path, both the mantissa and the power of ten are exact
+      //so a single multiply or divide gives the correctly rounded result
+      if (decimal.mantissa <= MAX_EXACT_INTEGER &&
+          decimal.exponent >= -MAX_EXACT_POWER && decimal.exponent <= MAX_EXACT_POWER){
+         double result = (double)decimal.mantissa;
+         if (decimal.exponent < 0){
+            result /= exactPowersOfTen[-decimal.exponent];
+         }
+         else {
+            result *= exactPowersOfTen[decimal.exponent];
+         }
+
+         *value = (decimal.negative) ? -result : result;
+         return JSON_SUCCESS;
+      }
+#endif
+   }
+
+   if (decimal.exponent < POWER_OF_FIVE_MIN){
+      //So small that it is zero, strtod reports this as a range error
+      json_errno = JSON_NUMBER_OUT_OF_RANGE;
+      return JSON_NUMBER_OUT_OF_RANGE;
+   }
+
+   if (decimal.exponent > POWER_OF_FIVE_MAX){
+      json_errno = JSON_NUMBER_OUT_OF_RANGE;
+      return JSON_NUMBER_OUT_OF_RANGE;
+   }
+
+   double result;
+   if (!computeDouble(decimal.exponent, decimal.mantissa, decimal.negative, &result)){
+      //The number is too large to fit in a double
+      json_errno = JSON_NUMBER_OUT_OF_RANGE;
+      return JSON_NUMBER_OUT_OF_RANGE;
+   }
+
+   if (decimal.truncated){
+      //The real number is somewhere between mantissa and mantissa + 1, if both
+      //of those round to the same double then so does the real number
+      double upper;
+      if (decimal.mantissa == UINT64_MAX ||
+          !computeDouble(decimal.exponent, decimal.mantissa + 1, decimal.negative, &upper) ||
+          upper != result){
+         return slowStringToNumber(token, length, value);
+      }
+   }
+
+   if (result == 0.0){
+      json_errno = JSON_NUMBER_OUT_OF_RANGE;
+      return JSON_NUMBER_OUT_OF_RANGE;
+   }
+
+   *value = result;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Checks a number the same way stringToNumber() does, without keeping the
+ * value. Numbers that are sure to fit in a double are only checked against
+ * the grammar, the rest are converted to find out if they are in range.
+ *
+ * @param token - The characters of the number, they do not need to be null terminated
+ * @param length - The number of characters
+ * @return JSON_SUCCESS, JSON_INVALID_VALUE, or JSON_NUMBER_OUT_OF_RANGE
+ */
+JSONError_t checkNumber(const char* token, size_t length){
+   JSONDecimal_t decimal;
+   double value;
+
+   if (!token){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!scanNumber(token, length, &decimal)){
+      json_errno = JSON_INVALID_VALUE;
+      return JSON_INVALID_VALUE;
+   }
+
+   if (decimal.mantissa == 0 ||
+       (!decimal.truncated && decimal.exponent >= -MAX_EXACT_POWER && decimal.exponent <= MAX_EXACT_POWER)){
+      //At most 19 digits times a small power of ten is always in range
+      return JSON_SUCCESS;
+   }
+
+   return stringToNumber(token, length, &value);
+}
+
+/*-----------------------------------------------------------------
+ * Implement private helper functions
+ *----------------------------------------------------------------*/
+
+/**
+ * Checks a number against the JSON grammar and pulls out its digits and
+ * exponent in a single pass.
+ *
+ * @param token - The characters of the number
+ * @param length - The number of characters
+ * @param decimal - The pieces of the number
+ * @return true if the number follows the JSON grammar
+ */
+static bool scanNumber(const char* token, size_t length, JSONDecimal_t* decimal){
+   size_t index = 0;
+   int digits = 0;
+   int64_t dropped = 0;
+
+   memset(decimal, 0, sizeof(JSONDecimal_t));
+
+   if (index < length && token[index] == '-'){
+      decimal->negative = true;
+      index++;
+   }
+
+   if (index >= length || token[index] < '0' || token[index] > '9'){
+      return false;
+   }
+
+   //Leading zeros are not allowed, a 0 has to be on its own
+   if (token[index] == '0'){
+      index++;
+      if (index < length && token[index] >= '0' && token[index] <= '9'){
+         return false;
+      }
+   }
+   else {
+      while (index < length && token[index] >= '0' && token[index] <= '9'){
+         if (digits < MAX_MANTISSA_DIGITS){
+            decimal->mantissa = (decimal->mantissa * 10) + (token[index] - '0');
+            digits++;
+         }
+         else {
+            //Too many digits to hold, keep track of the scale instead
+            dropped++;
+            if (token[index] != '0'){
+               decimal->truncated = true;
+            }
+         }
+         index++;
+      }
+   }
+
+   if (index < length && token[index] == '.'){
+      index++;
+      if (index >= length || token[index] < '0' || token[index] > '9'){
+         return false;
+      }
+
+      while (index < length && token[index] >= '0' && token[index] <= '9'){
+         if (digits == 0 && token[index] == '0'){
+            //Leading zeros in the fraction only change the scale
+            decimal->exponent--;
+         }
+         else if (digits < MAX_MANTISSA_DIGITS){
+            decimal->mantissa = (decimal->mantissa * 10) + (token[index] - '0');
+            decimal->exponent--;
+            digits++;
+         }
+         else if (token[index] != '0'){
+            decimal->truncated = true;
+         }
+         index++;
+      }
+   }
+
+   if (index < length && (token[index] == 'e' || token[index] == 'E')){
+      bool negativeExponent = false;
+      int64_t exponent = 0;
+
+      index++;
+      if (index < length && (token[index] == '+' || token[index] == '-')){
+         negativeExponent = (token[index] == '-');
+         index++;
+      }
+
+      if (index >= length || token[index] < '0' || token[index] > '9'){
+         return false;
+      }
+
+      while (index < length && token[index] >= '0' && token[index] <= '9'){
+         //Anything this large is out of range anyway, so stop counting
+         if (exponent < MAX_EXPONENT_VALUE){
+            exponent = (exponent * 10) + (token[index] - '0');
+         }
+         index++;
+      }
+
+      decimal->exponent += (negativeExponent) ? -exponent : exponent;
+   }
+
+   decimal->exponent += dropped;
+
+   //The whole token has to be part of the number
+   return index == length;
+}
+
+/**
+ * The Eisel-Lemire algorithm. The mantissa is normalized and multiplied
+ * by a 128 bit approximation of 5^power, and the top bits of the product
+ * become the mantissa of the double. The second half of the table entry
+ * is only needed when the first product is too close to call, and it has
+ * been shown that the two together are always accurate enough.
+ *
+ * @param power - The power of ten, between POWER_OF_FIVE_MIN and POWER_OF_FIVE_MAX
+ * @param mantissa - The decimal mantissa, not zero
+ * @param negative - The number had a leading '-'
+ * @param value - Where the result will be stored
+ * @return true on success, false if the result is too large for a double
+ */
+static bool computeDouble(int64_t power, uint64_t mantissa, bool negative, double* value){
+   //floor(log2(5^power)) + power + 1023 + 63, see the Eisel-Lemire paper
+   int64_t exponent = (((152170 + 65536) * power) >> 16) + 1024 + 63;
+
+   int leadingZeros = __builtin_clzll(mantissa);
+   mantissa <<= leadingZeros;
+
+   const uint64_t* powerOfFive = &powersOfFive[2 * (power - POWER_OF_FIVE_MIN)];
+   uint64_t lower;
+   uint64_t upper = fullMultiply(mantissa, powerOfFive[0], &lower);
+
+   if ((upper & 0x1FF) == 0x1FF){
+      //Too close to call, bring in the next 64 bits of the power
+      uint64_t secondLower;
+      uint64_t secondUpper = fullMultiply(mantissa, powerOfFive[1], &secondLower);
+      lower += secondUpper;
+      if (secondUpper > lower){
+         upper++;
+      }
+   }
+
+   uint64_t upperBit = upper >> 63;
+   uint64_t bits = upper >> (upperBit + 9);
+   leadingZeros += (int)(1 ^ upperBit);
+
+   int64_t realExponent = exponent - leadingZeros;
+   if (realExponent <= 0){
+      //The result is a subnormal number (or zero)
+      if (-realExponent + 1 >= 64){
+         *value = (negative) ? -0.0 : 0.0;
+         return true;
+      }
+
+      bits >>= -realExponent + 1;
+      bits += (bits & 1);
+      bits >>= 1;
+
+      //Rounding up may have made this a normal number again
+      realExponent = (bits < (1ULL << 52)) ? 0 : 1;
+      *value = makeDouble(bits, realExponent, negative);
+      return true;
+   }
+
+   //Only exactly half way values need rounding to even, and those can
+   //only come from small powers of ten with no bits left in the low word
+   if ((lower <= 1) && (power >= -4) && (power <= 23) && ((bits & 3) == 1)){
+      if ((bits << (upperBit + 64 - 53 - 2)) == upper){
+         bits &= ~1ULL;
+      }
+   }
+
+   bits += (bits & 1);
+   bits >>= 1;
+
+   if (bits >= (1ULL << 53)){
+      //Rounding carried into the next power of two
+      bits = (1ULL << 52);
+      realExponent++;
+   }
+
+   bits &= ~(1ULL << 52);
+   if (realExponent > 2046){
+      return false;
+   }
+
+   *value = makeDouble(bits, realExponent, negative);
+   return true;
+}
+
+/**
+ * Multiplies two 64 bit numbers into a 128 bit result
+ *
+ * @param a - The first number
+ * @param b - The second number
+ * @param low - The low 64 bits of the product
+ * @return The high 64 bits of the product
+ */
+static uint64_t fullMultiply(uint64_t a, uint64_t b, uint64_t* low){
+#ifdef __SIZEOF_INT128__
+   __uint128_t product = (__uint128_t)a * b;
+   *low = (uint64_t)product;
+   return (uint64_t)(product >> 64);
+#else
+   //Multiply the 32 bit halves and add up the middle terms
+   uint64_t aLow = (uint32_t)a, aHigh = a >> 32;
+   uint64_t bLow = (uint32_t)b, bHigh = b >> 32;
+
+   uint64_t lowLow = aLow * bLow;
+   uint64_t highLow = aHigh * bLow;
+   uint64_t lowHigh = aLow * bHigh;
+   uint64_t highHigh = aHigh * bHigh;
+
+   uint64_t middle = (lowLow >> 32) + (uint32_t)highLow + lowHigh;
+   *low = (middle << 32) | (uint32_t)lowLow;
+   return highHigh + (highLow >> 32) + (middle >> 32);
+#endif
+}
+
+/**
+ * Builds a double from its raw parts
+ *
+ * @param mantissa - The 52 bit fraction
+ * @param exponent - The biased exponent
+ * @param negative - The sign
+ * @return The double
+ */
+static double makeDouble(uint64_t mantissa, int64_t exponent, bool negative){
+   uint64_t bits = mantissa | ((uint64_t)exponent << 52) | ((uint64_t)negative << 63);
+   double result;
+
+   memcpy(&result, &bits, sizeof(result));
+   return result;
+}
+
+/**
+ * Converts a number with strtod(). This is only used for numbers with
+ * too many digits to be decided any other way. strtod() uses the decimal
+ * point of the current locale, so the '.' is swapped for it first. The
+ * number is copied in full, no matter how long it is.
+ *
+ * @param token - The characters of the number (already checked against the grammar)
+ * @param length - The number of characters
+ * @param value - Where the number will be stored
+ * @return JSON_SUCCESS, JSON_NUMBER_OUT_OF_RANGE, or JSON_MALLOC_FAIL
+ */
+static JSONError_t slowStringToNumber(const char* token, size_t length, double* value){
+   const char* decimalPoint = localeconv()->decimal_point;
+   size_t pointLength = strlen(decimalPoint);
+   char localBuffer[NUMBER_BUFFER_SIZE];
+   char* buffer = localBuffer;
+   size_t bufferIndex = 0;
+
+   if (length + pointLength + 1 > NUMBER_BUFFER_SIZE){
+      buffer = (char*)malloc(length + pointLength + 1);
+      if (!buffer){
+         json_errno = JSON_MALLOC_FAIL;
+         return JSON_MALLOC_FAIL;
+      }
+   }
+
+   for (size_t i = 0; i < length; i++){
+      if (token[i] == '.'){
+         memcpy(&buffer[bufferIndex], decimalPoint, pointLength);
+         bufferIndex += pointLength;
+      }
+      else {
+         buffer[bufferIndex++] = token[i];
+      }
+   }
+   buffer[bufferIndex] = '\0';
+
+   errno = 0;
+   double result = strtod(buffer, NULL);
+   int error = errno;
+
+   if (buffer != localBuffer){
+      free(buffer);
+   }
+
+   if (error == ERANGE && (result == 0.0 || result == HUGE_VAL || result == -HUGE_VAL)){
+      json_errno = JSON_NUMBER_OUT_OF_RANGE;
+      return JSON_NUMBER_OUT_OF_RANGE;
+   }
+
+   *value = result;
+   return JSON_SUCCESS;
+}
@@ -0,0 +1,22 @@
+#ifndef _JSON_NUMBER_H
+#define _JSON_NUMBER_H
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONError_t stringToNumber(const char* token, size_t length, double* value);
+JSONError_t checkNumber(const char* token, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,7 @@
 #include <math.h>
 
 #include "jsontools.h"
+#include "jsonstring.h"
 
 /*-----------------------------------------------------------------
  * Private Helper functions 
@@ -179,7 +180,16 @@ static JSONError_t writeJSONString(JSONKeyValue_t* pair, char** output, int dept
       int strLen = 0;
       char* ind = indent(depth); //The indent string (this is dynamic so we need to free it)
       
-      if (pair->key && pair->value && pair->value->sVal){
+      if (pair->value && pair->value->sVal && (pair->flags & PAIR_STRING_DECODED)){
+         //Decoded strings have to be escaped again on the way out
+         keyLen = (pair->key) ? strlen(pair->key) : 0;
+         valLen = escapedJSONLength(pair->value->sVal);
+         *output = (char*) calloc((keyLen + valLen + otherStuff), sizeof(char));
+         strLen = (pair->key) ? sprintf(*output, "%s\"%s\" : \"", ind, pair->key) : sprintf(*output, "%s\"", ind);
+         strLen = escapeJSONString(&(*output)[strLen], pair->value->sVal) - *output;
+         strLen += sprintf(&(*output)[strLen], "\"");
+      }
+      else if (pair->key && pair->value && pair->value->sVal){
          keyLen = strlen(pair->key);
          valLen = strlen(pair->value->sVal);
          *output = (char*) calloc((keyLen + valLen + otherStuff), sizeof(char));
@@ -2,22 +2,199 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <ctype.h>
+#include <stdint.h>
 #include <errno.h>
 
 #include "jsontools.h"
+#include "jsonscan.h"
+#include "jsonnumber.h"
+#include "jsonstring.h"
+
+/**
+ * The kinds of values that can be cut off by the end of a chunk and
+ * held in the parsers token buffer until the rest of it arrives.
+ */
+typedef enum {
+   TOKEN_NONE = 0,   /**< Nothing is being held */
+   TOKEN_STRING,     /**< A key or string value (the opening quote is not held) */
+   TOKEN_NUMBER,     /**< A number value */
+   TOKEN_LITERAL     /**< true, false, or null */
+} TokenType_t;
+
+/**
+ * Where the parser is in a comment found between messages. Comments
+ * can be split across chunks just like values can.
+ */
+typedef enum {
+   COMMENT_NONE = 0, /**< Not in a comment */
+   COMMENT_SLASH,    /**< Found a '/' that could start a comment */
+   COMMENT_BLOCK,    /**< Inside a block comment */
+   COMMENT_STAR,     /**< Found a '*' that could end a block comment */
+   COMMENT_LINE      /**< Inside a single line comment */
+} CommentState_t;
+
+/**
+ * What kind of structural character was found. The scanner only stops on
+ * these, and characterClasses maps every byte to one of them.
+ */
+typedef enum {
+   CLASS_OTHER = 0,     /**< Anything that can not start a value or be part of the structure */
+   CLASS_QUOTE,         /**< '"' the start of a key or string */
+   CLASS_NUMBER,        /**< '-' or a digit */
+   CLASS_BOOLEAN,       /**< 't' or 'f' */
+   CLASS_NULL,          /**< 'n' */
+   CLASS_OPEN_OBJECT,   /**< '{' */
+   CLASS_OPEN_ARRAY,    /**< '[' */
+   CLASS_CLOSE_OBJECT,  /**< '}' */
+   CLASS_CLOSE_ARRAY,   /**< ']' */
+   CLASS_COLON,         /**< ':' */
+   CLASS_COMMA,         /**< ',' */
+   CLASS_COUNT
+} CharacterClass_t;
+
+/**
+ * Where the parser is when it finds a structural character. Each one is
+ * a row of the transition table.
+ */
+typedef enum {
+   IN_ROOT = 0,         /**< Before the '{' or '[' that starts a message */
+   IN_ARRAY,            /**< Inside of an array */
+   IN_OBJECT,           /**< Inside of an object */
+   CONTEXT_COUNT
+} ParserContext_t;
+
+/**
+ * What happens when a structural character is found in a context. The
+ * character is only allowed when every bit in required is set in the
+ * parser state. 
+ */
+typedef struct {
+   unsigned int required; /**< The state bits that must all be set */
+   JSONError_t error;     /**< The error when one of them is not */
+   unsigned int next;     /**< The state that comes after '{' '[' ':' or ',' */
+} ParserTransition_t;
+
+//A state bit that is never set, for characters that are never allowed
+#define NEVER                    0x40000000
+
+//The states that follow the characters that do not finish a value
+#define OBJECT_START             (KEY | QUOTE | CLOSE_PREN | CHARACTER)
+#define ARRAY_START              (VALUE | QUOTE | CHARACTER | DIGIT | CLOSE_BRACKET | OPEN_PREN | OPEN_BRACKET)
+#define NEXT_VALUE               (VALUE | QUOTE | CHARACTER | DIGIT | OPEN_PREN | OPEN_BRACKET)
+#define NEXT_KEY                 (KEY | QUOTE | CHARACTER)
+
+/**
+ * The kind of structural character each byte is. Anything not listed is
+ * CLASS_OTHER.
+ */
+static const unsigned char characterClasses[256] = {
+   ['"'] = CLASS_QUOTE, ['{'] = CLASS_OPEN_OBJECT, ['['] = CLASS_OPEN_ARRAY, ['}'] = CLASS_CLOSE_OBJECT,
+   [']'] = CLASS_CLOSE_ARRAY, [':'] = CLASS_COLON, [','] = CLASS_COMMA,
+   ['-'] = CLASS_NUMBER, ['0'] = CLASS_NUMBER, ['1'] = CLASS_NUMBER, ['2'] = CLASS_NUMBER, ['3'] = CLASS_NUMBER,
+   ['4'] = CLASS_NUMBER, ['5'] = CLASS_NUMBER, ['6'] = CLASS_NUMBER, ['7'] = CLASS_NUMBER, ['8'] = CLASS_NUMBER,
+   ['9'] = CLASS_NUMBER, ['t'] = CLASS_BOOLEAN, ['f'] = CLASS_BOOLEAN, ['n'] = CLASS_NULL
+};
+
+/**
+ * Which characters are allowed where, and the error for each one that is
+ * found where it is not. A message can only begin with '{' or '[', so
+ * anything else at the root is an invalid message. 
+ */
+static const ParserTransition_t transitions[CONTEXT_COUNT][CLASS_COUNT] = {
+   [IN_ROOT] = {
+      [CLASS_OTHER] =        {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_QUOTE] =        {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_NUMBER] =       {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_BOOLEAN] =      {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_NULL] =         {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_OPEN_OBJECT] =  {OPEN_PREN, JSON_UNEXPECTED_OBJECT, OBJECT_START},
+      [CLASS_OPEN_ARRAY] =   {OPEN_BRACKET, JSON_UNEXPECTED_ARRAY, ARRAY_START},
+      [CLASS_CLOSE_OBJECT] = {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_CLOSE_ARRAY] =  {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_COLON] =        {NEVER, JSON_INVALID_MESSAGE, 0},
+      [CLASS_COMMA] =        {NEVER, JSON_INVALID_MESSAGE, 0}
+   },
+   [IN_ARRAY] = {
+      [CLASS_OTHER] =        {NEVER, JSON_UNEXPECTED_CHARACTER, 0},
+      [CLASS_QUOTE] =        {QUOTE, JSON_UNEXPECTED_STRING, 0},
+      [CLASS_NUMBER] =       {DIGIT, JSON_UNEXPECTED_NUMBER, 0},
+      [CLASS_BOOLEAN] =      {CHARACTER | VALUE, JSON_UNEXPECTED_BOOLEAN, 0},
+      [CLASS_NULL] =         {CHARACTER | VALUE, JSON_UNEXPECTED_NULL, 0},
+      [CLASS_OPEN_OBJECT] =  {OPEN_PREN | VALUE, JSON_UNEXPECTED_OBJECT, OBJECT_START},
+      [CLASS_OPEN_ARRAY] =   {OPEN_BRACKET | VALUE, JSON_UNEXPECTED_ARRAY, ARRAY_START},
+      [CLASS_CLOSE_OBJECT] = {NEVER, JSON_OBJECT_BRACKET_MISMATCH, 0},
+      [CLASS_CLOSE_ARRAY] =  {CLOSE_BRACKET, JSON_ARRAY_BRACKET_MISMATCH, 0},
+      [CLASS_COLON] =        {NEVER, JSON_UNEXPECTED_CHARACTER, 0},
+      [CLASS_COMMA] =        {COMMA, JSON_UNEXPECTED_COMMA, NEXT_VALUE}
+   },
+   [IN_OBJECT] = {
+      [CLASS_OTHER] =        {NEVER, JSON_UNEXPECTED_CHARACTER, 0},
+      [CLASS_QUOTE] =        {QUOTE, JSON_UNEXPECTED_STRING, 0},
+      [CLASS_NUMBER] =       {DIGIT, JSON_UNEXPECTED_NUMBER, 0},
+      [CLASS_BOOLEAN] =      {CHARACTER | VALUE, JSON_UNEXPECTED_VALUE, 0},
+      [CLASS_NULL] =         {CHARACTER | VALUE, JSON_UNEXPECTED_VALUE, 0},
+      [CLASS_OPEN_OBJECT] =  {OPEN_PREN | VALUE, JSON_UNEXPECTED_OBJECT, OBJECT_START},
+      [CLASS_OPEN_ARRAY] =   {OPEN_BRACKET | VALUE, JSON_UNEXPECTED_ARRAY, ARRAY_START},
+      [CLASS_CLOSE_OBJECT] = {CLOSE_PREN, JSON_OBJECT_BRACKET_MISMATCH, 0},
+      [CLASS_CLOSE_ARRAY] =  {NEVER, JSON_ARRAY_BRACKET_MISMATCH, 0},
+      [CLASS_COLON] =        {DELIMITER, JSON_UNEXPECTED_DELIMITER, NEXT_VALUE},
+      [CLASS_COMMA] =        {COMMA, JSON_UNEXPECTED_COMMA, NEXT_KEY}
+   }
+};
+
+/**
+ * Jumps straight to the code for each kind of structural character. With
+ * GCC and clang this is a computed goto, so every handler has its own
+ * indirect jump for the branch predictor to learn. Anywhere else it is a
+ * switch. 
+ */
+#if defined(__GNUC__)
+#define DISPATCH(characterClass)          goto *handlers[characterClass];
+#define HANDLER(label, characterClass)    label
+#else
+#define DISPATCH(characterClass)          switch (characterClass)
+#define HANDLER(label, characterClass)    case characterClass
+#endif
 
 /*----------------------------------------------------------------
  * Define private helper functions
  *---------------------------------------------------------------*/
  
-static JSONError_t parseJSONString(JSONParser_t* parser, const char* message, int size, char** result);
-static JSONError_t parseJSONNumber(JSONParser_t* parser, const char* message, int size, double* result);
-static JSONError_t parseJSONBoolean(JSONParser_t* parser, const char* message, int size, bool* result);
-static JSONError_t parseJSONNull(JSONParser_t* parser, const char* message, int size);
-static JSONError_t parseJSONObject(JSONParser_t* parser, const char* message, int size, JSONValue_t** result);
-static JSONError_t parseJSONArray(JSONParser_t* parser, const char* message, int size, JSONKeyValue_t** result);
-static JSONError_t parseJSONKey(JSONParser_t* parser, const char* message, int size);
+static JSONError_t parseBuffer(JSONParser_t* parser, JSONKeyValue_t** document, const char* message, size_t length, size_t* consumed);
+static JSONError_t feedChunk(JSONParser_t* parser, JSONKeyValue_t** document, const char* chunk, size_t length, size_t* consumed);
+static JSONError_t runParser(JSONParser_t* parser, const char* message, size_t size, JSONKeyValue_t** document);
+static JSONError_t walkMessage(JSONParser_t* parser, const char* message, size_t size, JSONKeyValue_t** document);
+static JSONError_t skipContainer(JSONParser_t* parser, JSONScanner_t* scanner, const char* message, size_t size, size_t position);
+static JSONError_t checkStringUTF8(JSONParser_t* parser, const char* token, size_t length);
+static JSONError_t checkValueEnd(JSONParser_t* parser, const char* message, size_t size);
+static JSONError_t resumeToken(JSONParser_t* parser, const char* message, size_t size);
+static JSONError_t holdToken(JSONParser_t* parser, TokenType_t type, const char* token, size_t length);
+static JSONError_t parseToken(JSONParser_t* parser, TokenType_t type, const char* token, size_t length);
+static JSONError_t parseJSONString(JSONParser_t* parser, const char* token, size_t length);
+static JSONError_t parseDecodedString(JSONParser_t* parser, const char* token, size_t length);
+static JSONError_t parseJSONNumber(JSONParser_t* parser, const char* token, size_t length);
+static JSONError_t parseJSONLiteral(JSONParser_t* parser, const char* token, size_t length);
+static JSONError_t parseJSONKey(JSONParser_t* parser, const char* token, size_t length);
+static JSONError_t openContainer(JSONParser_t* parser, JSONType_t type);
+static JSONError_t growFrames(JSONParser_t* parser);
+static JSONError_t closeContainer(JSONParser_t* parser, JSONKeyValue_t** document);
+static JSONError_t attachValue(JSONParser_t* parser, JSONKeyValue_t* pair);
+static JSONError_t emitEvent(JSONParser_t* parser, bool keepGoing);
+static bool skipsValue(JSONParser_t* parser, const JSONProjectionStep_t** step);
+static void nextValueState(JSONParser_t* parser);
+static JSONError_t reserveToken(JSONParser_t* parser, size_t size);
+static JSONKeyValue_t* newValuePair(JSONParser_t* parser, JSONType_t type);
+static void keepSparePairs(JSONParser_t* parser, JSONKeyValue_t* document);
+static void disposeOfSparePairs(JSONParser_t* parser);
+static bool canBorrow(JSONParser_t* parser, const char* token);
+static size_t findStringEnd(const char* message, size_t index, size_t size, bool escaped);
+static size_t findNumberEnd(const char* message, size_t index, size_t size);
+static size_t findLiteralEnd(const char* message, size_t index, size_t size);
+static size_t matchLiteral(const char* token, size_t available);
+static void releaseMessage(JSONParser_t* parser);
+static void dropPendingKey(JSONParser_t* parser);
+static void skipWhiteSpace(JSONParser_t* parser, const char* message, size_t size);
+static void countLines(JSONParser_t* parser, const char* message);
 static void pushError(JSONParser_t* parser, JSONError_t error, const char* currentFunction, const char* currentFile, int line, int errNo);
 /*----------------------------------------------------------------
  * Implement global functions
@@ -26,7 +203,7 @@ static void pushError(JSONParser_t* parser, JSONError_t error, const char* curre
 /**
  * Creates a new parser object that can be used to parse a JSON message.
  * the JSON parser object maintains the parsers state, including the
- * current message depth, key stack, status, and verious statistics.
+ * current message depth, frame stack, status, and verious statistics.
  * 
  * @return Pointer to new JSON parser object 
  */
@@ -61,16 +238,20 @@ JSONError_t initJSONParser(JSONParser_t* parser){
 
    memset(parser, 0, sizeof(JSONParser_t));
 
-   parser->state = (OPEN_PREN || OPEN_BRACKET);
+   parser->maxDepth = MAX_DEPTH;
+   parser->state = (OPEN_PREN | OPEN_BRACKET);
 
    return JSON_SUCCESS;
 }
 
 /**
- * Resets the parser object so it can be used on another message. Although
- * the parseJSONMessage will reset the parser after a successful parsing it
- * will be necessary to reset the parser manually after an error occurs. 
- * this does not clear any of the accounting data out of the struct.
+ * Resets the parser so it can be used on another message. Parsing resets
+ * the parser after a successful message, so this is only needed after an
+ * error. The partly built document, held token, pending key, and the
+ * position and error of the last message are cleared. The statistics,
+ * callbacks, options, projection, key table, and pool are kept, and so are
+ * the token buffer, frame stack, and spare pairs, so the next message does
+ * not have to allocate them again.
  * 
  * @param parser - The parser object that needs to be cleared
  */
@@ -79,7 +260,16 @@ void resetParser(JSONParser_t* parser){
       return;
    }
    
-   initJSONParser(parser);
+   releaseMessage(parser);
+
+   parser->index = 0;
+   parser->lineNumber = 0;
+   parser->lineIndex = 0;
+   parser->message = NULL;
+   parser->keyFlags = 0;
+   parser->tracebackString[0] = '\0';
+   parser->jsonError = 0;
+   parser->outsideError = 0;
 }
 
 /**
@@ -93,6 +283,14 @@ void disposeOfJSONParser(JSONParser_t* parser){
       return;
    }
 
+   resetParser(parser);
+   disposeOfJSONArena(parser->arena);
+   if (parser->ownsKeyTable){
+      disposeOfJSONKeyTable(parser->keyTable);
+   }
+   disposeOfSparePairs(parser);
+   free(parser->token);
+   free(parser->frames);
    free(parser);
 }
 
@@ -113,1052 +311,2324 @@ void disposeOfJSONParser(JSONParser_t* parser){
  * @param message - the JSON message that you want to parse, The message MUST
  *    be null terminated.
  * 
+ * @param lastIndex - The index of the next message in the string, or -1 if
+ *    there are no more messages
+ * 
  * @return JSON_SUCCESS if the message was parsed correctly, an error otherwise.
+ * @see parseJSONBuffer
  */
 JSONError_t parseJSONMessage(JSONParser_t* parser, JSONKeyValue_t** document, const char* message, int* lastIndex){
-   if (!parser || !document || !message){
+   if (!parser || !document || !message || !lastIndex){
       PUSH_ERROR(parser, JSON_NULL_ARGUMENT, -1);
       json_errno = JSON_NULL_ARGUMENT;
       return JSON_NULL_ARGUMENT;
    }
    
-   int messageLength = strlen(message);
-   parser->index = 0;
-   JSONError_t returnStatus;
-   
-   //Seek forward to first character in the message
-   while(parser->index < messageLength){
-      if (isgraph(message[parser->index])){
-         parser->index++;
-         if (message[parser->index - 1] == '/' && message[parser->index] == '*'){
-            //Found a comment, we need to read ahead to get past it
-            parser->index++;
-            while(parser->index < messageLength){
-               if (message[parser->index] == '*'){
-                  parser->index++;
-                  if (message[parser->index] == '/' && parser->index < messageLength){
-                     //Found end of comment
-                     parser->index++;
-                     break;
-                  }
-               }
-               else if (message[parser->index] == '\n'){
-                  parser->index++;
-                  parser->lineNumber++;
-               }
-               else {
-                  parser->index++;
-               }
-            }
-         }
-         else if (message[parser->index - 1] == '/' && message[parser->index] == '/'){
-            //Found a single line comment, parse until end of line
-            while(parser->index < messageLength && message[parser->index++] != '\n');
-            parser->lineNumber++;
-         }
-         else {
-            //We found the first character in the message
-            //rewind index to point to that character
-            parser->index--;
-            break;
-         }
-      }
-      else if (message[parser->index] == '\n') {
-         parser->index++;
-         parser->lineNumber++;
-      }
-      else {
-         parser->index++;
-      }
+   size_t messageLength = strlen(message);
+   size_t consumed = 0;
+   JSONError_t returnStatus = parseJSONBuffer(parser, document, message, messageLength, &consumed);
+   if (returnStatus != JSON_SUCCESS){
+      return returnStatus;
    }
    
-   //If we never found the first character and ran out of message
-   if (parser->index >= messageLength){
-      PUSH_ERROR(parser, JSON_INVALID_MESSAGE, -1);
-      json_errno = JSON_INVALID_MESSAGE;
-      return JSON_INVALID_MESSAGE;
+   *lastIndex = (consumed < messageLength) ? (int)consumed : -1;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Builds the document model for the first JSON message found in a buffer
+ * of known length. The buffer does not need to be null terminated, and 
+ * nothing past message + length will be read. This is the function to use
+ * when walking a large buffer of concatenated messages, since the length
+ * is never recalculated. 
+ * 
+ * @param parser - The parser object that will be used to track the progress
+ *    of parsing process
+ * 
+ * @param document - Where the newly built document will be placed
+ * 
+ * @param message - The start of the JSON message
+ * 
+ * @param length - The number of bytes available in the message buffer
+ * 
+ * @param consumed - The number of bytes used by this message, including any
+ *    white space and comments after it. If there is another message in the 
+ *    buffer it begins at message + consumed, otherwise consumed == length.
+ * 
+ * @return JSON_SUCCESS if the message was parsed correctly, JSON_INVALID_ARGUMENT
+ *    if the parser has PARSE_IN_SITU set (use parseJSONBufferInSitu), an
+ *    error otherwise.
+ */
+JSONError_t parseJSONBuffer(JSONParser_t* parser, JSONKeyValue_t** document, const char* message, size_t length, size_t* consumed){
+   if (!parser || !document || !message || !consumed){
+      PUSH_ERROR(parser, JSON_NULL_ARGUMENT, -1);
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
    
-   //Check what kind of character it is. It can either be an
-   //Array or an Object
-   
-   if (message[parser->index] == '{'){
-      //Found an object
-      parser->index++;
-      JSONValue_t* objectValue;
-      returnStatus = parseJSONObject(parser, message, messageLength, &objectValue);
-      if (returnStatus != JSON_SUCCESS){
-         switch (returnStatus){
-            case JSON_MESSAGE_INCOMPLETE :
-               parser->incompleteMessages++;
-               return JSON_MESSAGE_INCOMPLETE;
-               break;
-            default :
-               return returnStatus;
-               break;
-         }
-      }
-      //Attach the object as the final json document
-      *document = newJSONPair(OBJECT, NULL, objectValue);
-   }
-   else if (message[parser->index] == '['){
-      //Found an array
-      parser->index++;
-      JSONKeyValue_t* arrayValue;
-      returnStatus = parseJSONArray(parser, message, messageLength, &arrayValue);
-      if (returnStatus != JSON_SUCCESS){
-         switch (returnStatus){
-            case JSON_MESSAGE_INCOMPLETE :
-               parser->incompleteMessages++;
-               return JSON_MESSAGE_INCOMPLETE;
-               break;
-            default :
-               return returnStatus;
-               break;
-         }
-      }
-      //Attach the array as the final json document
-      *document = arrayValue;
+   if (parser->options & PARSE_IN_SITU){
+      //The parser would write to a message it was promised it would only read
+      PUSH_ERROR(parser, JSON_INVALID_ARGUMENT, -1);
+      json_errno = JSON_INVALID_ARGUMENT;
+      return JSON_INVALID_ARGUMENT;
    }
    
-   //Look forward down the message to see if another JOSN message starts
-   //if it does, report the index of that message in lastIndex
-   parser->index++;  //Step past last '}' character
-   while(parser->index < messageLength && message[parser->index] != '{' && message[parser->index] != '['){
-      //If we find something other then a space or '{', no more messages
-      if (isgraph(message[parser->index])){
-         if (message[parser->index] == '/' && message[parser->index + 1] == '*'){
-            //Found a comment, we need to read ahead to get past it
-            parser->index += 2;
-            while(parser->index < messageLength){
-               if (message[parser->index++] == '*'){
-                  if (message[parser->index] == '/'){
-                     //Found end of comment
-                     break;
-                  }
-               }
-            }
-         }
-         else {
-            break;
-         }
-      }
-      parser->index++;
+   return parseBuffer(parser, document, message, length, consumed);
+}
+
+/**
+ * Builds the document model for the first JSON message found in a buffer
+ * the parser is allowed to write to. This is parseJSONBuffer() for parsers
+ * with PARSE_IN_SITU set, the keys and strings of the document point into
+ * the message, so it must outlive the document. Without PARSE_IN_SITU the
+ * message is only read, the same as parseJSONBuffer().
+ * 
+ * @param parser - The parser object that will be used to track the progress
+ *    of parsing process
+ * 
+ * @param document - Where the newly built document will be placed
+ * 
+ * @param message - The start of the JSON message, it must be writable
+ * 
+ * @param length - The number of bytes available in the message buffer
+ * 
+ * @param consumed - The number of bytes used by this message (see parseJSONBuffer)
+ * 
+ * @return JSON_SUCCESS if the message was parsed correctly, an error otherwise.
+ *    If an error occurs the message may already have been changed.
+ */
+JSONError_t parseJSONBufferInSitu(JSONParser_t* parser, JSONKeyValue_t** document, char* message, size_t length, size_t* consumed){
+   if (!parser || !document || !message || !consumed){
+      PUSH_ERROR(parser, JSON_NULL_ARGUMENT, -1);
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
    
-   if (message[parser->index] == '{' || message[parser->index] == '['){
-      *lastIndex = parser->index;
+   return parseBuffer(parser, document, message, length, consumed);
+}
+
+/**
+ * Feeds the next chunk of a stream into the parser. Chunks can be split
+ * anywhere, even in the middle of a string or number. When a chunk runs
+ * out before the message is complete, the parser remembers exactly where
+ * it stopped and JSON_MESSAGE_INCOMPLETE is returned. The next call will
+ * pick up from that point without looking at the previous chunks again.
+ * The document is built as the values arrive, so the only input the parser
+ * ever holds onto is a single value that was cut in half.
+ *
+ * When a message is completed JSON_SUCCESS is returned, and consumed will
+ * tell you where the message ended in this chunk. Any bytes after that
+ * belong to the next message and should be fed back in.
+ *
+ * @param parser - The parser object that will be used to track the progress
+ *    of parsing process
+ *
+ * @param document - Where the completed document will be placed, this can
+ *    be NULL if the parser has callbacks set (see setJSONParserCallbacks)
+ *
+ * @param chunk - The next piece of the stream
+ *
+ * @param length - The number of bytes in the chunk
+ *
+ * @param consumed - The number of bytes that were used from this chunk
+ *
+ * @return JSON_SUCCESS if a message was completed, JSON_MESSAGE_INCOMPLETE if
+ *    more data is needed, JSON_INVALID_ARGUMENT if the parser has
+ *    PARSE_IN_SITU set (use feedJSONParserInSitu), an error otherwise. After
+ *    an error the message is thrown away and the parser is ready for the
+ *    next one.
+ */
+JSONError_t feedJSONParser(JSONParser_t* parser, JSONKeyValue_t** document, const char* chunk, size_t length, size_t* consumed){
+   if (!parser || (!document && !parser->callbacks) || !consumed || (!chunk && length > 0)){
+      PUSH_ERROR(parser, JSON_NULL_ARGUMENT, -1);
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
-   else {
-      *lastIndex = -1;
+
+   if (parser->options & PARSE_IN_SITU){
+      //The parser would write to a chunk it was promised it would only read
+      PUSH_ERROR(parser, JSON_INVALID_ARGUMENT, -1);
+      json_errno = JSON_INVALID_ARGUMENT;
+      return JSON_INVALID_ARGUMENT;
    }
-   
-   resetParser(parser);
-   parser->messagesParsed++;
-   return JSON_SUCCESS;
-}
 
-/*-----------------------------------------------------------------
- * Implement private helper functions
- *----------------------------------------------------------------*/
+   return feedChunk(parser, document, chunk, length, consumed);
+}
 
 /**
- * This is a helper function to parse a single string value out of the
- * message and into memory. The string created by this function
- * is dynamicly allocated, and needs to be freed when you are done with it
- * 
- * @param parser - The parser object that is keeping track of this specific document
- * @param message - The JSON message 
- * @param size - The length of the message
- * @param result - The string that is parsed out will be put here
- * @return JSON_SUCCESS if the string was parsed correctly, error otherwise (see stack trace)
+ * Feeds the next chunk of a stream into a parser that is allowed to write
+ * to it. This is feedJSONParser() for parsers with PARSE_IN_SITU set, every
+ * chunk must outlive the documents that borrow keys and strings from it.
+ * A value cut in two by the end of a chunk is put back together in the
+ * parsers own buffer, and copied out of there.
+ *
+ * @param parser - The parser object that will be used to track the progress
+ *    of parsing process
+ * @param document - Where the completed document will be placed (see feedJSONParser)
+ * @param chunk - The next piece of the stream, it must be writable
+ * @param length - The number of bytes in the chunk
+ * @param consumed - The number of bytes that were used from this chunk
+ * @return JSON_SUCCESS if a message was completed, JSON_MESSAGE_INCOMPLETE if
+ *    more data is needed, an error otherwise.
  */
-static JSONError_t parseJSONString(JSONParser_t* parser, const char* message, int size, char** result) {
-   if (!parser){
+JSONError_t feedJSONParserInSitu(JSONParser_t* parser, JSONKeyValue_t** document, char* chunk, size_t length, size_t* consumed){
+   if (!parser || (!document && !parser->callbacks) || !consumed || (!chunk && length > 0)){
       PUSH_ERROR(parser, JSON_NULL_ARGUMENT, -1);
       json_errno = JSON_NULL_ARGUMENT;
       return JSON_NULL_ARGUMENT;
    }
-   
-   int tempSize = 256;
-   char* temp = (char*) calloc(sizeof(char), (tempSize + 1));
-   
-   if(!temp){
-      PUSH_ERROR(parser, JSON_NULL_ARGUMENT, errno);
-      json_errno = JSON_MALLOC_FAIL;
-      return JSON_MALLOC_FAIL;
+
+   return feedChunk(parser, document, chunk, length, consumed);
+}
+
+/**
+ * Parses the first JSON message in a buffer without building a document.
+ * Instead, the callbacks are called for each object, array, key and value
+ * as the parser finds them, in the order they appear in the message. The
+ * message goes through exactly the same checks as parseJSONBuffer(), and
+ * no memory is allocated for any of the values.
+ *
+ * Keys are passed with their escape sequences converted, strings are passed
+ * as they appear in the message (use convertString() if you need them
+ * converted), or converted as well with PARSE_DECODE_STRINGS. The pointers
+ * are only good until the callback returns.
+ * Returning false from a callback stops the parser with JSON_CALLBACK_ABORTED.
+ *
+ * @param parser - The parser object that will be used to track the progress
+ *    of parsing process
+ *
+ * @param callbacks - The functions to call, any that are NULL are skipped
+ *
+ * @param message - The start of the JSON message
+ *
+ * @param length - The number of bytes available in the message buffer
+ *
+ * @param consumed - The number of bytes used by this message (see parseJSONBuffer)
+ *
+ * @return JSON_SUCCESS if the message was parsed correctly, an error otherwise.
+ */
+JSONError_t parseJSONEvents(JSONParser_t* parser, const JSONCallbacks_t* callbacks, const char* message, size_t length, size_t* consumed){
+   if (!parser || !callbacks){
+      PUSH_ERROR(parser, JSON_NULL_ARGUMENT, -1);
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
-   
-   int tempIndex = 0;
-   
-   //Scan and copy the string into memory exactly as is
-   while(parser->index < size && message[parser->index] != '"'){
-      //Since the JSON standard states that we can have escaped sequences, we need
-      //To copy them to memory correctly. 
-      if (message[parser->index] == '\\'){
-         //We can have escaped unicode sequences of the style '\uXXXX'
-         if (message[parser->index + 1] == 'u' || message[parser->index + 1] == 'U'){
-            if (tempIndex + 6 >= tempSize){
-               tempSize *= 2;
-               temp = (char*)realloc(temp, tempSize + 1);
-               if (!temp){
-                  PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
-                  json_errno = JSON_MALLOC_FAIL;
-                  return JSON_MALLOC_FAIL;
-               }
-               continue;   //Now that we have more memory, continue to parse the string
-            }
-            
-            temp[tempIndex++] = message[parser->index++];   //'/'
-            temp[tempIndex++] = message[parser->index++];   //'u'
-            for (int i = 0; i < 4; i++){
-               if (isxdigit(message[parser->index])){
-                  temp[tempIndex++] = message[parser->index++];   //Hex
-               }
-               else {
-                  PUSH_ERROR(parser, JSON_INVALID_UNICODE_SEQ, -1);
-                  json_errno = JSON_INVALID_UNICODE_SEQ;
-                  return JSON_INVALID_UNICODE_SEQ;
-               }
-            }
-            
-            continue; //Since we are already 1 character past the end of the escape sequence, we can continue parsing from here
-         }
-         else{
-            if (tempIndex + 2 >= tempSize){
-               tempSize *= 2;
-               temp = (char*)realloc(temp, tempSize + 1);
-               if (!temp){
-                  PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
-                  json_errno = JSON_MALLOC_FAIL;
-                  return JSON_MALLOC_FAIL;
-               }
-               continue;   //Now that we have more memory, continue to parse the string
-            }
-         }
-         
-         temp[tempIndex++] = message[parser->index++];   //'/'
-         temp[tempIndex++] = message[parser->index];     //escaped character
-      }
-      //For normal characters, we just copy them into memory
-      else {
-         if (tempIndex + 1 >= tempSize){
-            tempSize *= 2;
-            temp = (char*)realloc(temp, tempSize + 1);
-            if (!temp){
-               PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
-               json_errno = JSON_MALLOC_FAIL;
-               return JSON_MALLOC_FAIL;
-            }
-            continue;   //Now that we have more memory, continue to parse the string
-         }
-         
-         temp[tempIndex++] = message[parser->index];
-      }
-      
-      parser->index++;
+
+   const JSONCallbacks_t* oldCallbacks = parser->callbacks;
+   JSONKeyValue_t* unused = NULL;
+
+   parser->callbacks = callbacks;
+   JSONError_t returnStatus = parseJSONBuffer(parser, &unused, message, length, consumed);
+   parser->callbacks = oldCallbacks;
+
+   return returnStatus;
+}
+
+/**
+ * Sets the callbacks the parser will use instead of building a document.
+ * This is how events are used with feedJSONParser(), the callbacks are
+ * called as each chunk is parsed. Pass NULL to go back to building
+ * documents. This can only be changed between messages.
+ *
+ * @param parser - The parser that will use the callbacks
+ * @param callbacks - The functions to call, or NULL
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, or JSON_BAD_PARSER_STATE if the
+ *    parser is in the middle of a message
+ */
+JSONError_t setJSONParserCallbacks(JSONParser_t* parser, const JSONCallbacks_t* callbacks){
+   if (!parser){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
-   
-   if (parser->index >= size){
-      free(temp);
-      PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
-      json_errno = JSON_MESSAGE_INCOMPLETE;
-      return JSON_MESSAGE_INCOMPLETE;
+
+   if (parser->depth > 0 || parser->tokenType != TOKEN_NONE){
+      PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+      json_errno = JSON_BAD_PARSER_STATE;
+      return JSON_BAD_PARSER_STATE;
    }
-   
-   temp[tempIndex] = '\0';
-   
-   tempSize = strlen(temp) + 1;
-   
-   //shrink the memory of the string to only what it needs
-   temp = (char*)realloc(temp, sizeof(char) * tempSize);
-   *result = temp;
-   
+
+   parser->callbacks = callbacks;
    return JSON_SUCCESS;
 }
+
 /**
- * This is a helper function to parse a number from a JSON message. the 
- * JSON standard states that all numbers should be treated like IEEE 753 64 bit
- * double percesion numbers. That is exatly how C doubles work. They can 
- * be in either normal, or scientific notation. They cannot however be in
- * base 16 (which makes no sence for a double anyway).
- * 
- * @param parser - The parser object that is keeping track of this specific document
- * @param message - The JSON message 
- * @param size - The length of the message
- * @param result - The number that is parsed out will be put here
- * @return JSON_SUCCESS if the number was parsed correctly, error otherwise (see stack trace)
+ * Sets the options that change how the parser builds documents. With
+ * PARSE_ARENA every pair, key, and string of a document comes out of a
+ * single arena that belongs to the document. Disposing of the document
+ * with disposeOfPair() frees the whole arena at once instead of walking
+ * the tree, or the document can be handed back with recycleJSONDocument()
+ * so its arena is used again for the next message. 
+ *
+ * With PARSE_IN_SITU keys and strings are not copied, they point straight
+ * into the message. The parser writes the null terminators (and converts
+ * escaped keys) right in the message, so the message must be writable and
+ * must outlive the documents parsed from it. Messages have to be passed to
+ * parseJSONBufferInSitu(), feedJSONParserInSitu(), or an iterator made with
+ * initJSONDocumentIteratorInSitu(), the functions that take a const message
+ * reject it with JSON_INVALID_ARGUMENT. If an error occurs the message may
+ * already have been changed. 
+ *
+ * With PARSE_INTERN_KEYS each distinct key is only stored once, and every
+ * pair with that key points to the same copy. Combined with PARSE_ARENA
+ * the keys are kept once per document, in the documents arena, and the
+ * parsers table forgets them when the document is done. Otherwise
+ * the parser keeps the keys for as long as it lives, so the documents must
+ * be disposed of before the parser is. Use setJSONParserKeyTable() to
+ * share keys between parsers instead. 
+ *
+ * With PARSE_DECODE_STRINGS strings are stored as the UTF-8 text they
+ * stand for, with their escape sequences (surrogate pairs included)
+ * expanded as they are copied out of the message. The output module
+ * escapes them again. Without it strings are kept the way they are in the
+ * message, and convertString() has to be used on them. 
+ *
+ * With PARSE_STRICT_UTF8 every key and string is checked as it is parsed,
+ * and the message is rejected with JSON_INVALID_UTF8 if one holds bytes
+ * that are not well formed UTF-8. The parsers index is left on the first
+ * byte that is not (or on the closing quote of a string that was cut in
+ * two by the end of a chunk). Strings inside of objects and arrays that a
+ * projection skips are not checked. This can only be changed between
+ * messages.
+ *
+ * @param parser - The parser the options are for
+ * @param options - PARSE_DEFAULT, or a combination of JSONParseOptions_t values
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, or JSON_BAD_PARSER_STATE if the
+ *    parser is in the middle of a message
  */
-static JSONError_t parseJSONNumber(JSONParser_t* parser, const char* message, int size, double* result){
-   int tempSize = 48;
-   char temp[tempSize];
-   int tempIndex = 0;
-   
-   while(parser->index < size && tempIndex < tempSize){
-      if (isdigit(message[parser->index])){
-         temp[tempIndex++] = message[parser->index];
-      }
-      else if (message[parser->index] == '-'){
-         temp[tempIndex++] = message[parser->index];
-      }
-      else if (message[parser->index] == '+'){
-         temp[tempIndex++] = message[parser->index];
-      }
-      else if (message[parser->index] == 'e'){
-         temp[tempIndex++] = message[parser->index];
-      }
-      else if (message[parser->index] == 'E'){
-         temp[tempIndex++] = message[parser->index];
-      }
-      else if (message[parser->index] == '.'){
-         temp[tempIndex++] = message[parser->index];
-      }
-      else {
-         //Need to step back to last character to ensure we dont skip any commas
-         //or bracket characters
-         parser->index--;
-         break;
-      }
-      
-      parser->index++;
+JSONError_t setJSONParserOptions(JSONParser_t* parser, int options){
+   if (!parser){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
-   
-   if (parser->index >= size){
-      PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
-      json_errno = JSON_MESSAGE_INCOMPLETE;
-      return JSON_MESSAGE_INCOMPLETE;
+
+   if (parser->depth > 0 || parser->tokenType != TOKEN_NONE){
+      PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+      json_errno = JSON_BAD_PARSER_STATE;
+      return JSON_BAD_PARSER_STATE;
    }
-   
-   temp[tempIndex] = '\0';
-   
-   errno = 0;
-   double newNum = strtod(temp, NULL);
-   
-   if (errno){
-      if (errno == ERANGE){
-         PUSH_ERROR(parser, JSON_NUMBER_OUT_OF_RANGE, errno);
-         json_errno = JSON_NUMBER_OUT_OF_RANGE;
-         return JSON_NUMBER_OUT_OF_RANGE;
+
+   if (!(options & PARSE_ARENA)){
+      if (parser->ownsKeyTable){
+         //The keys may be in an arena that is about to go away
+         resetJSONKeyTable(parser->keyTable, NULL);
       }
-      else{
-         PUSH_ERROR(parser, JSON_INTERNAL_FAILURE, errno);
-         json_errno = JSON_INTERNAL_FAILURE;
-         return JSON_INTERNAL_FAILURE;
+      disposeOfJSONArena(parser->arena);
+      parser->arena = NULL;
+   }
+   else {
+      //Documents will come from the arena, the spare pairs are not needed
+      disposeOfSparePairs(parser);
+   }
+
+   if ((options & PARSE_INTERN_KEYS) && !parser->keyTable){
+      parser->keyTable = newJSONKeyTable();
+      if (!parser->keyTable){
+         PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+         json_errno = JSON_MALLOC_FAIL;
+         return JSON_MALLOC_FAIL;
       }
-      
+      parser->ownsKeyTable = true;
    }
-   
-   *result = newNum;
+   else if (!(options & PARSE_INTERN_KEYS) && parser->ownsKeyTable){
+      disposeOfJSONKeyTable(parser->keyTable);
+      parser->keyTable = NULL;
+      parser->ownsKeyTable = false;
+   }
+
+   parser->options = options;
    return JSON_SUCCESS;
 }
 
 /**
- * This is a helper function that will parse boolean values from a JSON message.
- * a boolean can only be 'true' or 'false' and no other values. 
- * 
- * @param parser - The parser object that is keeping track of this specific document
- * @param message - The JSON message 
- * @param size - The length of the message
- * @param result - The boolean that is parsed out will be put here
- * @return JSON_SUCCESS if the boolean was parsed correctly, error otherwise (see stack trace)
+ * Interns keys in a table that belongs to the caller. The table can be
+ * shared by many parsers (one at a time), and it has to outlive every
+ * document parsed with it. With a shared table the lookup keys can be
+ * interned once up front, so getInternedChildPair() can find pairs with a
+ * pointer compare. Pass NULL to stop using the table.
+ *
+ * @param parser - The parser that will intern its keys
+ * @param table - The key table, or NULL
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, or JSON_BAD_PARSER_STATE if the
+ *    parser is in the middle of a message
  */
-static JSONError_t parseJSONBoolean(JSONParser_t* parser, const char* message, int size, bool* result){
-   int tempSize = 6;
-   char temp[tempSize + 1];
-   int tempIndex = 0;
-   
-   while(parser->index < size && tempIndex < tempSize){
-      if (isalpha(message[parser->index])){
-         temp[tempIndex++] = message[parser->index];
-      }
-      else {
-         //Need to step back to last letter to ensure we dont skip any commas
-         //or bracket characters
-         parser->index--;
-         break;
-      }
-      parser->index++;
+JSONError_t setJSONParserKeyTable(JSONParser_t* parser, JSONKeyTable_t* table){
+   if (!parser){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
-   
-   if (parser->index >= size){
-      PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
-      json_errno = JSON_MESSAGE_INCOMPLETE;
-      return JSON_MESSAGE_INCOMPLETE;
+
+   if (parser->depth > 0 || parser->tokenType != TOKEN_NONE){
+      PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+      json_errno = JSON_BAD_PARSER_STATE;
+      return JSON_BAD_PARSER_STATE;
+   }
+
+   if (parser->ownsKeyTable){
+      disposeOfJSONKeyTable(parser->keyTable);
+   }
+
+   parser->keyTable = table;
+   parser->ownsKeyTable = false;
+
+   if (!table){
+      //Go back to the parsers own table if it should have one
+      return setJSONParserOptions(parser, parser->options);
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Sets how deeply objects and arrays can be nested in a message before
+ * the parser gives up with JSON_MESSAGE_TOO_LARGE. The parser does not 
+ * recurse, so the limit only bounds the memory used by its frame stack,
+ * which grows as deeper messages come in. The default is MAX_DEPTH. This
+ * can only be changed between messages. validateJSONBuffer() has no
+ * parser, it always holds messages to MAX_DEPTH.
+ *
+ * @param parser - The parser the limit is for
+ * @param maxDepth - The deepest a message can nest, at least 1
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, JSON_INVALID_ARGUMENT, or 
+ *    JSON_BAD_PARSER_STATE if the parser is in the middle of a message
+ */
+JSONError_t setJSONParserMaxDepth(JSONParser_t* parser, int maxDepth){
+   if (!parser){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (maxDepth < 1){
+      PUSH_ERROR(parser, JSON_INVALID_ARGUMENT, -1);
+      json_errno = JSON_INVALID_ARGUMENT;
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   if (parser->depth > 0 || parser->tokenType != TOKEN_NONE){
+      PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+      json_errno = JSON_BAD_PARSER_STATE;
+      return JSON_BAD_PARSER_STATE;
+   }
+
+   parser->maxDepth = maxDepth;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Limits the documents the parser builds to the key paths in a projection
+ * (see jsonprojection.h). Only the values at the end of those paths, and
+ * the objects and arrays that hold them, are built. Objects and arrays on
+ * the way to a path are kept even when nothing in them matched, so the
+ * document keeps its shape. Anything else is stepped over by counting
+ * brackets, it is not allocated, unescaped, or converted, and it is only
+ * checked for brackets that match. With callbacks, only the events for
+ * the projected values are sent.
+ *
+ * The projection belongs to the caller, it can be shared by many parsers
+ * and has to outlive them. Pass NULL to build whole documents again. This
+ * can only be changed between messages.
+ *
+ * @param parser - The parser that will use the projection
+ * @param projection - The key paths to build, or NULL
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, or JSON_BAD_PARSER_STATE if the
+ *    parser is in the middle of a message
+ */
+JSONError_t setJSONParserProjection(JSONParser_t* parser, const JSONProjection_t* projection){
+   if (!parser){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (parser->depth > 0 || parser->tokenType != TOKEN_NONE){
+      PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+      json_errno = JSON_BAD_PARSER_STATE;
+      return JSON_BAD_PARSER_STATE;
+   }
+
+   parser->projection = projection;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Gives the parser a thread pool to parse large arrays with. When
+ * parseJSONBuffer() (or parseJSONMessage()) is given a message that is
+ * an array of at least PARALLEL_MIN_SIZE bytes, the elements of the array
+ * are split into ranges that are parsed on the threads of the pool, and
+ * joined back into one array. The document is the same one that would be
+ * built without the pool. Anything else is parsed on the calling thread,
+ * as are arrays parsed with callbacks, a projection, PARSE_INTERN_KEYS, or
+ * a key table from setJSONParserKeyTable(), since the keys have to be
+ * interned in the parsers own table.
+ *
+ * Finding out if an array is large enough means scanning up to
+ * PARALLEL_MIN_SIZE bytes of it first, so only give a pool to parsers
+ * that are used for large messages. The pool belongs to the caller, it
+ * can be shared by many parsers and has to outlive them. Pass NULL to
+ * stop using the pool. This can only be changed between messages.
+ *
+ * @param parser - The parser that will use the pool
+ * @param pool - The threads to parse with, or NULL
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, or JSON_BAD_PARSER_STATE if the
+ *    parser is in the middle of a message
+ */
+JSONError_t setJSONParserThreadPool(JSONParser_t* parser, JSONThreadPool_t* pool){
+   if (!parser){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (parser->depth > 0 || parser->tokenType != TOKEN_NONE){
+      PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+      json_errno = JSON_BAD_PARSER_STATE;
+      return JSON_BAD_PARSER_STATE;
+   }
+
+   parser->pool = pool;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Disposes of a document that is no longer needed. If the document was
+ * built in an arena, the arena is rewound and kept by the parser for the
+ * next message, so once the arena has grown to fit the messages being
+ * parsed no more memory is allocated for them. A document that was built
+ * with malloc has its pairs and values kept by the parser instead, and
+ * the next message is built from them before any more are allocated. 
+ * Only its keys and strings are freed. Any other document is disposed of
+ * with disposeOfPair().
+ *
+ * @param parser - The parser that will parse the next message
+ * @param document - The root of a document, it can not be used after this
+ */
+void recycleJSONDocument(JSONParser_t* parser, JSONKeyValue_t* document){
+   JSONArena_t* arena = getDocumentArena(document);
+
+   if (parser && !arena){
+      keepSparePairs(parser, document);
+      return;
+   }
+
+   if (!parser || !arena || parser->arena || !(parser->options & PARSE_ARENA)){
+      disposeOfPair(document);
+      return;
+   }
+
+   resetJSONArena(arena);
+   parser->arena = arena;
+}
+
+/**
+ * Prepares an iterator that will walk every JSON message in a buffer of
+ * concatenated messages. The buffer is only ever scanned once from front
+ * to back, so walking N messages is a single linear pass. 
+ * 
+ * @param iterator - The iterator to initialize
+ * @param parser - The parser that will be used for each message
+ * @param message - The buffer holding one or more JSON messages
+ * @param length - The number of bytes in the buffer
+ * @return JSON_SUCCESS, or JSON_NULL_ARGUMENT
+ */
+JSONError_t initJSONDocumentIterator(JSONDocumentIterator_t* iterator, JSONParser_t* parser, const char* message, size_t length){
+   if (!iterator || !parser || !message){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
    }
    
-   temp[tempIndex] = '\0';
+   iterator->parser = parser;
+   iterator->message = message;
+   iterator->length = length;
+   iterator->offset = 0;
+   iterator->inSitu = false;
    
-   if (strcmp(temp, "true") == 0){
-      *result = true;
-      return JSON_SUCCESS;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Prepares an iterator over a buffer the parser is allowed to write to,
+ * so a parser with PARSE_IN_SITU can be used with it. Each message is
+ * parsed with parseJSONBufferInSitu(), see initJSONDocumentIterator().
+ * 
+ * @param iterator - The iterator to initialize
+ * @param parser - The parser that will be used for each message
+ * @param message - The buffer holding one or more JSON messages, it must be writable
+ * @param length - The number of bytes in the buffer
+ * @return JSON_SUCCESS, or JSON_NULL_ARGUMENT
+ */
+JSONError_t initJSONDocumentIteratorInSitu(JSONDocumentIterator_t* iterator, JSONParser_t* parser, char* message, size_t length){
+   JSONError_t returnStatus = initJSONDocumentIterator(iterator, parser, message, length);
+   if (returnStatus == JSON_SUCCESS){
+      iterator->inSitu = true;
    }
-   else if (strcmp(temp, "false") == 0){
-      *result = false;
-      return JSON_SUCCESS;
+   
+   return returnStatus;
+}
+
+/**
+ * Checks to see if there is anything left in the buffer to be parsed
+ * 
+ * @param iterator - The iterator being walked
+ * @return true if nextJSONDocument() should be called again
+ */
+bool hasNextJSONDocument(JSONDocumentIterator_t* iterator){
+   if (!iterator){
+      return false;
+   }
+   
+   return iterator->offset < iterator->length;
+}
+
+/**
+ * Parses the next message out of the buffer and steps the iterator past
+ * it. If an error occurs the iterator is left pointing at the message 
+ * that failed, and the parser holds the details of the problem. 
+ * 
+ * @param iterator - The iterator being walked
+ * @param document - Where the newly built document will be placed
+ * @return JSON_SUCCESS if the message was parsed correctly, an error otherwise.
+ */
+JSONError_t nextJSONDocument(JSONDocumentIterator_t* iterator, JSONKeyValue_t** document){
+   if (!iterator || !document){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+   
+   size_t consumed = 0;
+   JSONError_t returnStatus;
+   if (iterator->inSitu){
+      //The buffer was handed to initJSONDocumentIteratorInSitu() as writable
+      returnStatus = parseJSONBufferInSitu(iterator->parser, document, 
+                                           (char*)&iterator->message[iterator->offset], 
+                                           iterator->length - iterator->offset, &consumed);
    }
    else {
-      //not true or false
-      PUSH_ERROR(parser, JSON_INVALID_VALUE, -1);
-      json_errno = JSON_INVALID_VALUE;
-      return JSON_INVALID_VALUE;
+      returnStatus = parseJSONBuffer(iterator->parser, document, 
+                                     &iterator->message[iterator->offset], 
+                                     iterator->length - iterator->offset, &consumed);
+   }
+   if (returnStatus != JSON_SUCCESS){
+      return returnStatus;
    }
    
+   iterator->offset += consumed;
+   return JSON_SUCCESS;
 }
 
+/*-----------------------------------------------------------------
+ * Implement private helper functions
+ *----------------------------------------------------------------*/
+
 /**
- * This function is special since we only need to know if it sucessfully parsed
- * the null value or not. Therefor there is no value to be returned. 
- * 
+ * Parses the first message in a buffer, see parseJSONBuffer() and
+ * parseJSONBufferInSitu(), which check their arguments first.
+ *
  * @param parser - The parser object that is keeping track of this specific document
- * @param message - The JSON message 
- * @param size - The length of the message
- * @return JSON_SUCCESS if the null was parsed correctly, error otherwise (see stack trace)
+ * @param document - Where the newly built document will be placed
+ * @param message - The start of the JSON message
+ * @param length - The number of bytes available in the message buffer
+ * @param consumed - The number of bytes used by this message
+ * @return JSON_SUCCESS if the message was parsed correctly, an error otherwise.
  */
-static JSONError_t parseJSONNull(JSONParser_t* parser, const char* message, int size) {
-   int tempSize = 5;
-   char temp[tempSize + 1];
-   int tempIndex = 0;
+static JSONError_t parseBuffer(JSONParser_t* parser, JSONKeyValue_t** document, const char* message, size_t length, size_t* consumed){
+   if (parser->depth > 0 || parser->tokenType != TOKEN_NONE){
+      //The parser is in the middle of a streamed message
+      PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+      json_errno = JSON_BAD_PARSER_STATE;
+      return JSON_BAD_PARSER_STATE;
+   }
+
+   parser->index = 0;
+   parser->commentState = COMMENT_NONE;
+   JSONError_t returnStatus;
    
-   while(parser->index < size && tempIndex < tempSize) {
-      if (isalpha(message[parser->index])) {
-         temp[tempIndex++] = message[parser->index];
-      }
-      else {
-         //Need to step back to last letter to ensure we dont skip any commas
-         //or bracket characters
-         parser->index--;
-         break;
+   //Seek forward to first character in the message
+   skipWhiteSpace(parser, message, length);
+   
+   //If we never found the first character and ran out of message
+   if (parser->index >= length){
+      PUSH_ERROR(parser, JSON_INVALID_MESSAGE, -1);
+      json_errno = JSON_INVALID_MESSAGE;
+      return JSON_INVALID_MESSAGE;
+   }
+   
+   //Large arrays can be split up between the threads of the parsers pool,
+   //anything that can not be is parsed here
+   returnStatus = JSON_FAIL;
+   if (parser->pool && message[parser->index] == '['){
+      returnStatus = parseJSONArrayInParallel(parser, message, length, document);
+      if (returnStatus != JSON_SUCCESS && returnStatus != JSON_FAIL){
+         //The threads have already written to the message, it can not be parsed again
+         PUSH_ERROR(parser, returnStatus, -1);
+         json_errno = returnStatus;
       }
-      
-      parser->index++;
    }
+
+   if (returnStatus == JSON_FAIL){
+      returnStatus = runParser(parser, message, length, document);
+   }
+
+   if (returnStatus != JSON_SUCCESS){
+      if (returnStatus == JSON_MESSAGE_INCOMPLETE){
+         parser->incompleteMessages++;
+         PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
+         json_errno = JSON_MESSAGE_INCOMPLETE;
+      }
    
-   if (parser->index >= size){
-      PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
-      json_errno = JSON_MESSAGE_INCOMPLETE;
-      return JSON_MESSAGE_INCOMPLETE;
+      //Nothing can be resumed from a single buffer, so throw away the pieces
+      releaseMessage(parser);
+      return returnStatus;
    }
    
-   temp[tempIndex] = '\0';
+   //Look forward down the message to see if another JSON message starts
+   //if it does, report the offset of that message in consumed
+   skipWhiteSpace(parser, message, length);
    
-   if (strcmp(temp, "null") == 0) {
-      return JSON_SUCCESS;
+   if (parser->index < length && (message[parser->index] == '{' || message[parser->index] == '[')){
+      *consumed = parser->index;
    }
-   
    else {
-      PUSH_ERROR(parser, JSON_INVALID_TYPE, -1);
-      json_errno = JSON_INVALID_VALUE;
-      return JSON_INVALID_VALUE;
+      //Anything else is not the start of another message
+      *consumed = length;
    }
    
+   resetParser(parser);
+   parser->messagesParsed++;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Runs the next chunk of a stream through the parser, see feedJSONParser()
+ * and feedJSONParserInSitu(), which check their arguments first.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param document - Where the completed document will be placed
+ * @param chunk - The next piece of the stream
+ * @param length - The number of bytes in the chunk
+ * @param consumed - The number of bytes that were used from this chunk
+ * @return JSON_SUCCESS if a message was completed, JSON_MESSAGE_INCOMPLETE if
+ *    more data is needed, an error otherwise.
+ */
+static JSONError_t feedChunk(JSONParser_t* parser, JSONKeyValue_t** document, const char* chunk, size_t length, size_t* consumed){
+   parser->index = 0;
+   *consumed = length;
+
+   if (parser->depth == 0 && parser->tokenType == TOKEN_NONE){
+      //Waiting for a message to begin
+      skipWhiteSpace(parser, chunk, length);
+      if (parser->index >= length){
+         json_errno = JSON_MESSAGE_INCOMPLETE;
+         return JSON_MESSAGE_INCOMPLETE;
+      }
+   }
+
+   JSONError_t returnStatus = runParser(parser, chunk, length, document);
+   if (returnStatus == JSON_MESSAGE_INCOMPLETE){
+      //Remember that we stopped in the middle of a message
+      parser->state |= RESUME;
+      parser->incompleteMessages++;
+      json_errno = JSON_MESSAGE_INCOMPLETE;
+      return JSON_MESSAGE_INCOMPLETE;
+   }
+   else if (returnStatus != JSON_SUCCESS){
+      releaseMessage(parser);
+      return returnStatus;
+   }
+
+   countLines(parser, chunk);
+   *consumed = parser->index;
+   parser->state = (OPEN_PREN | OPEN_BRACKET);
+   parser->messagesParsed++;
+   return JSON_SUCCESS;
 }
 
 /**
- * This helper function will parse out a nested JSON object. the JSON standard
- * states that an object contains a set of unordered key:value pairs. Those
- * pairs could include other nested objects. This JSON parser only allows
- * 256 layers of depth. 
+ * Runs the parser over a message, or the next chunk of one. Line numbers
+ * are not tracked while the message is being walked, the new lines are
+ * counted when the parser stops (or when an error is reported).
  * 
  * @param parser - The parser object that is keeping track of this specific document
  * @param message - The JSON message 
  * @param size - The length of the message
- * @param result - The object that is parsed out will be put here
- * @return JSON_SUCCESS if the object was parsed correctly, error otherwise (see stack trace)
+ * @param document - The completed document is placed here
+ * @return JSON_SUCCESS when the document is complete, JSON_MESSAGE_INCOMPLETE
+ *    if the message ran out first, error otherwise (see stack trace)
  */
-static JSONError_t parseJSONObject(JSONParser_t* parser, const char* message, int size, JSONValue_t** result) {
-   if (parser->depth >= MAX_DEPTH){
-      PUSH_ERROR(parser, JSON_MESSAGE_TOO_LARGE, -1);
-      json_errno = JSON_MESSAGE_TOO_LARGE;
-      return JSON_MESSAGE_TOO_LARGE;
-   }
-   
-   JSONValue_t* newObj = (JSONValue_t*)calloc(1, sizeof(JSONValue_t));
-   
-   if (!newObj){
-      PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
-      json_errno = JSON_MALLOC_FAIL;
-      return JSON_MALLOC_FAIL;
+static JSONError_t runParser(JSONParser_t* parser, const char* message, size_t size, JSONKeyValue_t** document) {
+   parser->message = message;
+   parser->lineIndex = parser->index;
+
+   JSONError_t returnStatus = walkMessage(parser, message, size, document);
+   if (returnStatus == JSON_MESSAGE_INCOMPLETE){
+      parser->index = size;
+      countLines(parser, message);
    }
-   
+
+   parser->message = NULL;
+   return returnStatus;
+}
+
+/**
+ * This is the heart of the parser. The structural scanner finds every
+ * character that matters in the message, and this walks them in order
+ * using the parser state to decide if each one is allowed where it was 
+ * found. White space and the inside of strings are never looked at here.
+ * Objects and arrays are tracked on the parsers frame stack instead of the
+ * C stack, which is what allows the parser to stop at the end of a chunk 
+ * and pick up again later.
+ * 
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param message - The JSON message 
+ * @param size - The length of the message
+ * @param document - The completed document is placed here
+ * @return JSON_SUCCESS when the document is complete, JSON_MESSAGE_INCOMPLETE
+ *    if the message ran out first, error otherwise (see stack trace)
+ */
+static JSONError_t walkMessage(JSONParser_t* parser, const char* message, size_t size, JSONKeyValue_t** document) {
    JSONError_t returnStatus;
-   
-   
-   parser->state &= CLEAR_STATE;
-   parser->state |= (KEY | QUOTE | CLOSE_PREN | CHARACTER);
-   
-   while(parser->index < size){
-      if (isspace(message[parser->index])){
-         if (message[parser->index] == '\n'){
-            parser->lineNumber++;
+   JSONScanner_t scanner;
+   size_t position;
+#if defined(__GNUC__)
+   static const void* const handlers[CLASS_COUNT] = {
+      &&other, &&quote, &&number, &&boolean, &&null, &&openObject, &&openArray, 
+      &&closeObject, &&closeArray, &&colon, &&comma
+   };
+#endif
+
+   if (parser->tokenType != TOKEN_NONE){
+      //Finish the value that was cut off by the last chunk
+      returnStatus = resumeToken(parser, message, size);
+      if (returnStatus){
+         return returnStatus;
+      }
+   }
+
+   initJSONScanner(&scanner, message, parser->index, size);
+
+   while(nextStructural(&scanner, &position)){
+      parser->index = position;
+
+      if (parser->skipDepth > 0){
+         //In an object or array that is not in the projection
+         returnStatus = skipContainer(parser, &scanner, message, size, position);
+         if (returnStatus){
+            return returnStatus;
          }
-         //we can ignore white space
+         continue;
       }
-      else if (isalpha(message[parser->index])){
-         //We found a boolean (should be true or false) or null, they are not quoted
-         if (message[parser->index] == 'n'){
-            if ((parser->state & CHARACTER) && (parser->state & VALUE)){
-               //Found a null (maybe)
-               returnStatus = parseJSONNull(parser, message, size);
-               if (!returnStatus){
-                  JSONKeyValue_t* newPair = newJSONPair(NIL, parser->keyStack[parser->keyStackIndex - 1], NULL);
-                  addKeyValuePair(newObj, newPair);
-                  free(newPair);
-                  parser->keyStackIndex--;
-                  free(parser->keyStack[parser->keyStackIndex]);
-                  parser->keyStack[parser->keyStackIndex] = NULL;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_PREN);
-               }
-               else {
-                  return returnStatus;
-               }
-            }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_VALUE, -1);
-               json_errno = JSON_UNEXPECTED_VALUE;
-               return JSON_UNEXPECTED_VALUE;
+
+      int characterClass = characterClasses[(unsigned char)message[position]];
+      int context = (parser->depth == 0) ? IN_ROOT :
+                    (parser->frames[parser->depth - 1].type == OBJECT) ? IN_OBJECT : IN_ARRAY;
+      const ParserTransition_t* transition = &transitions[context][characterClass];
+
+      if ((parser->state & transition->required) != transition->required){
+         PUSH_ERROR(parser, transition->error, -1);
+         json_errno = transition->error;
+         return transition->error;
+      }
+
+      DISPATCH(characterClass){
+         HANDLER(quote, CLASS_QUOTE): {
+            //Found beginning of either a key or string value. The next
+            //position in the index is always the closing quote
+            size_t start = parser->index + 1;
+            size_t end;
+            if (!nextStructural(&scanner, &end)){
+               return holdToken(parser, TOKEN_STRING, &message[start], size - start);
             }
-         }
-         else if (message[parser->index] == 't' || message[parser->index] == 'f'){
-            if ((parser->state & CHARACTER) && (parser->state & VALUE)) {
-               //Found boolean (maybe)
-               bool boolVal;
-               returnStatus = parseJSONBoolean(parser, message, size, &boolVal);
-               if (!returnStatus){
-                  JSONKeyValue_t* newPair = newJSONPair(BOOLEAN, parser->keyStack[parser->keyStackIndex - 1], newJSONBoolean(boolVal));
-                  addKeyValuePair(newObj, newPair);
-                  free(newPair);
-                  parser->keyStackIndex--;
-                  free(parser->keyStack[parser->keyStackIndex]);
-                  parser->keyStack[parser->keyStackIndex] = NULL;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_PREN);
-               }
-               else {
+
+            parser->index = end;
+            if ((parser->options & PARSE_STRICT_UTF8) && scanner.nonASCIIEnd > start){
+               //Only strings the scanner saw bytes above 0x7F in have to be checked
+               returnStatus = checkStringUTF8(parser, &message[start], end - start);
+               if (returnStatus){
                   return returnStatus;
                }
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_VALUE, -1);
-               json_errno = JSON_UNEXPECTED_VALUE;
-               return JSON_UNEXPECTED_VALUE;
-            }
-         }
-         else {
-            //Found some other random character that we weren't expecting
-            PUSH_ERROR(parser, JSON_UNEXPECTED_CHARACTER, -1);
-            json_errno = JSON_UNEXPECTED_CHARACTER;
-            return JSON_UNEXPECTED_CHARACTER;
-         }
-      }
-      else if (isdigit(message[parser->index])){
-         //We found a number value, they are not quoted
-         if (parser->state & DIGIT){
-            double value;
-            returnStatus = parseJSONNumber(parser, message, size, &value);
-            if (!returnStatus){
-               JSONKeyValue_t* newPair = newJSONPair(NUMBER, parser->keyStack[parser->keyStackIndex - 1], newJSONNumber(value));
-               addKeyValuePair(newObj, newPair);
-               free(newPair);
-               parser->keyStackIndex--;
-               free(parser->keyStack[parser->keyStackIndex]);
-               parser->keyStack[parser->keyStackIndex] = NULL;
-               
-               parser->state &= CLEAR_STATE;
-               parser->state |= (COMMA | CLOSE_PREN);
-            }
-            else {
+
+            returnStatus = parseToken(parser, TOKEN_STRING, &message[start], end - start);
+            if (returnStatus){
                return returnStatus;
             }
+            continue;
          }
-         else {
-            PUSH_ERROR(parser, JSON_UNEXPECTED_NUMBER, -1);
-            json_errno = JSON_UNEXPECTED_NUMBER;
-            return JSON_UNEXPECTED_NUMBER;
-         }
-      }
-      else if (ispunct(message[parser->index])){
-         if (message[parser->index] == '"'){
-            //Found beginning of either a key or string value
-            parser->index++;
-            if (parser->state & KEY){
-               //If we are expecting a key, we will read it in and place it on the stack
-               returnStatus = parseJSONKey(parser, message, size);
-               if (returnStatus){
-                  return returnStatus;
-               }
-               
-               parser->state &= CLEAR_STATE;
-               parser->state |= (DELIMITER);
+
+         HANDLER(number, CLASS_NUMBER): {
+            //We found a number value, they are not quoted
+            size_t start = parser->index;
+            size_t end = findNumberEnd(message, start, size);
+            if (end >= size){
+               return holdToken(parser, TOKEN_NUMBER, &message[start], size - start);
             }
-            else if (parser->state & VALUE) {
-               char* value;
-               returnStatus = parseJSONString(parser, message, size, &value);
-               if (!returnStatus){
-                  JSONKeyValue_t* newPair = newJSONPair(STRING, parser->keyStack[parser->keyStackIndex - 1], newJSONString(value));
-                  addKeyValuePair(newObj, newPair);
-                  free(newPair);
-                  free(value);
-                  parser->keyStackIndex--;
-                  free(parser->keyStack[parser->keyStackIndex]);
-                  parser->keyStack[parser->keyStackIndex] = NULL;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_PREN);
-               }
-               else {
-                  return returnStatus;
-               }
+
+            parser->index = end;
+            returnStatus = parseToken(parser, TOKEN_NUMBER, &message[start], end - start);
+            if (returnStatus){
+               return returnStatus;
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_STRING, -1);
-               json_errno = JSON_UNEXPECTED_STRING;
-               return JSON_UNEXPECTED_STRING;
+
+            returnStatus = checkValueEnd(parser, message, size);
+            if (returnStatus){
+               return returnStatus;
             }
+            continue;
          }
-         else if (message[parser->index] == '{') {
-            //Found the beginning of a JSON object
-            if ((parser->state & VALUE) && (parser->state & OPEN_PREN)){
-               parser->depth++;
-               parser->index++;
-               JSONValue_t* objVal;
-               returnStatus = parseJSONObject(parser, message, size, &objVal);
-               if (!returnStatus){
-                  JSONKeyValue_t* newPair = newJSONPair(OBJECT, parser->keyStack[parser->keyStackIndex - 1], objVal);
-                  addKeyValuePair(newObj, newPair);
-                  free(newPair);
-                  parser->keyStackIndex--;
-                  free(parser->keyStack[parser->keyStackIndex]);
-                  parser->keyStack[parser->keyStackIndex] = NULL;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_PREN);
-               }
-               else {
+
+         HANDLER(boolean, CLASS_BOOLEAN):
+         HANDLER(null, CLASS_NULL): {
+            //We found a boolean (should be true or false) or null, they are not quoted
+            size_t start = parser->index;
+            size_t length = matchLiteral(&message[start], size - start);
+            if (length){
+               //The literal and the character after it have already been checked
+               parser->index = start + length;
+               returnStatus = parseToken(parser, TOKEN_LITERAL, &message[start], length);
+               if (returnStatus){
                   return returnStatus;
                }
+               continue;
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_OBJECT, -1);
-               json_errno = JSON_UNEXPECTED_OBJECT;
-               return JSON_UNEXPECTED_OBJECT;
+
+            size_t end = findLiteralEnd(message, start, size);
+            if (end >= size){
+               return holdToken(parser, TOKEN_LITERAL, &message[start], size - start);
             }
-         }
-         else if (message[parser->index] == ':'){
-            //Found the delimiter between a key:value pair
-            if (parser->state & DELIMITER){
-               parser->state &= CLEAR_STATE;
-               parser->state |= (VALUE | QUOTE | OPEN_PREN | OPEN_BRACKET | DIGIT | CHARACTER);
+
+            parser->index = end;
+            returnStatus = parseToken(parser, TOKEN_LITERAL, &message[start], end - start);
+            if (returnStatus){
+               return returnStatus;
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_DELIMITER, -1);
-               json_errno = JSON_UNEXPECTED_DELIMITER;
-               return JSON_UNEXPECTED_DELIMITER;
+
+            returnStatus = checkValueEnd(parser, message, size);
+            if (returnStatus){
+               return returnStatus;
             }
+            continue;
          }
-         else if (message[parser->index] == '['){
-            //Found the beginning of an array
-            if ((parser->state & VALUE) && (parser->state & OPEN_BRACKET)){
-               parser->index++;
-               JSONKeyValue_t* arrVal;
-               returnStatus = parseJSONArray(parser, message, size, &arrVal);
-               if (!returnStatus){
-                  arrVal->key = calloc(strlen(parser->keyStack[parser->keyStackIndex - 1]) + 1, sizeof(char));
-                  strcpy(arrVal->key, parser->keyStack[parser->keyStackIndex - 1]);
-                  addKeyValuePair(newObj, arrVal);
-                  free(arrVal);
-                  parser->keyStackIndex--;
-                  free(parser->keyStack[parser->keyStackIndex]);
-                  parser->keyStack[parser->keyStackIndex] = NULL;
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_PREN);
-               }
-               else {
-                  return returnStatus;
-               }
+
+         HANDLER(openObject, CLASS_OPEN_OBJECT):
+         HANDLER(openArray, CLASS_OPEN_ARRAY): {
+            //Found the beginning of an object or array
+            returnStatus = openContainer(parser, (characterClass == CLASS_OPEN_OBJECT) ? OBJECT : ARRAY);
+            if (returnStatus){
+               return returnStatus;
             }
+
+            parser->state = transition->next;
+            continue;
          }
-         else if (message[parser->index] == ']'){
-            PUSH_ERROR(parser, JSON_ARRAY_BRACKET_MISMATCH, -1);
-            json_errno = JSON_ARRAY_BRACKET_MISMATCH;
-            return JSON_ARRAY_BRACKET_MISMATCH;
-         }
-         else if (message[parser->index] == '}'){
-            if (parser->state & CLOSE_PREN){
+
+         HANDLER(closeObject, CLASS_CLOSE_OBJECT):
+         HANDLER(closeArray, CLASS_CLOSE_ARRAY): {
+            returnStatus = closeContainer(parser, document);
+            if (returnStatus == JSON_SUCCESS){
                //Done here
-               parser->depth--;
-               break;
+               parser->index++;
+               return JSON_SUCCESS;
             }
-            else {
-               PUSH_ERROR(parser, JSON_OBJECT_BRACKET_MISMATCH, -1);
-               json_errno = JSON_OBJECT_BRACKET_MISMATCH;
-               return JSON_OBJECT_BRACKET_MISMATCH;
+            else if (returnStatus != JSON_MESSAGE_INCOMPLETE){
+               return returnStatus;
             }
+            continue;
          }
-         else if (message[parser->index] == ','){
-            if (parser->state & COMMA){
-               parser->state &= CLEAR_STATE;
-               parser->state |= (KEY | QUOTE | CHARACTER);
-            }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_COMMA, -1);
-               json_errno = JSON_UNEXPECTED_COMMA;
-               return JSON_UNEXPECTED_COMMA;
-            }
+
+         HANDLER(colon, CLASS_COLON):
+         HANDLER(comma, CLASS_COMMA): {
+            //Found the delimiter between a key:value pair, or the seperator
+            //before another key or value
+            parser->state = transition->next;
+            continue;
+         }
+
+         HANDLER(other, CLASS_OTHER): {
+            //Never allowed anywhere, so the transition has already failed
+            PUSH_ERROR(parser, JSON_UNEXPECTED_CHARACTER, -1);
+            json_errno = JSON_UNEXPECTED_CHARACTER;
+            return JSON_UNEXPECTED_CHARACTER;
          }
       }
-      
-      parser->index++;
    }
-   
+
+   return JSON_MESSAGE_INCOMPLETE;
+}
+
+/**
+ * Steps over the rest of an object or array that is not in the parsers
+ * projection. Only the brackets are counted, nothing is allocated and 
+ * none of the keys or values are looked at. The closing quote of each 
+ * string is stepped over along with the opening quote, so brackets inside
+ * of strings are never counted.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param scanner - The scanner walking the message
+ * @param message - The JSON message
+ * @param size - The length of the message
+ * @param position - Where the next structural character is
+ * @return JSON_SUCCESS once the object or array has ended, JSON_MESSAGE_INCOMPLETE
+ *    if the message ran out first, error otherwise (see stack trace)
+ */
+static JSONError_t skipContainer(JSONParser_t* parser, JSONScanner_t* scanner, const char* message, size_t size, size_t position){
+   do {
+      switch (message[position]){
+         case '{' : case '[' :
+            if (parser->depth + parser->skipDepth >= parser->maxDepth){
+               parser->index = position;
+               PUSH_ERROR(parser, JSON_MESSAGE_TOO_LARGE, -1);
+               json_errno = JSON_MESSAGE_TOO_LARGE;
+               return JSON_MESSAGE_TOO_LARGE;
+            }
+            parser->skipDepth++;
+            break;
+
+         case '}' : case ']' :
+            if (--parser->skipDepth == 0){
+               parser->index = position;
+               nextValueState(parser);
+               return JSON_SUCCESS;
+            }
+            break;
+
+         case '"' : {
+            //The next position in the index is always the closing quote
+            size_t start = position + 1;
+            if (!nextStructural(scanner, &position)){
+               return holdToken(parser, TOKEN_STRING, &message[start], size - start);
+            }
+            break;
+         }
+
+         default :
+            break;
+      }
+   } while (nextStructural(scanner, &position));
+
+   return JSON_MESSAGE_INCOMPLETE;
+}
+
+/**
+ * Makes sure a key or string is well formed UTF-8, for PARSE_STRICT_UTF8.
+ * The string was just found by the scanner, so it is still in the cache.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param token - The contents of the string (without the quotes)
+ * @param length - The length of the string
+ * @return JSON_SUCCESS, or JSON_INVALID_UTF8 with the parsers index on the
+ *    first byte that is not well formed
+ */
+static JSONError_t checkStringUTF8(JSONParser_t* parser, const char* token, size_t length){
+   size_t invalid = findInvalidUTF8(token, 0, length);
+   if (invalid >= length){
+      return JSON_SUCCESS;
+   }
+
+   if (token != parser->token){
+      parser->index = (size_t)(token - parser->message) + invalid;
+   }
+   PUSH_ERROR(parser, JSON_INVALID_UTF8, -1);
+   json_errno = JSON_INVALID_UTF8;
+   return JSON_INVALID_UTF8;
+}
+
+/**
+ * Makes sure a number or unquoted value is followed by white space or a
+ * structural character. The scanner only indexes the first character of
+ * each value, so anything stuck onto the end of one (like "truex") has to
+ * be caught here.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param message - The JSON message
+ * @param size - The length of the message
+ * @return JSON_SUCCESS, or JSON_UNEXPECTED_CHARACTER
+ */
+static JSONError_t checkValueEnd(JSONParser_t* parser, const char* message, size_t size){
    if (parser->index >= size){
-      PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
-      json_errno = JSON_MESSAGE_INCOMPLETE;
-      return JSON_MESSAGE_INCOMPLETE;
+      return JSON_SUCCESS;
+   }
+
+   if (!(characterTraits[(unsigned char)message[parser->index]] & TRAIT_DELIMITER)){
+      PUSH_ERROR(parser, JSON_UNEXPECTED_CHARACTER, -1);
+      json_errno = JSON_UNEXPECTED_CHARACTER;
+      return JSON_UNEXPECTED_CHARACTER;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Finishes a value that was cut off by the end of the last chunk. The
+ * rest of the value is found at the front of this chunk, added to the
+ * token buffer, and then parsed as a single value.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param message - The new chunk of the message
+ * @param size - The length of the chunk
+ * @return JSON_SUCCESS if the value was completed, JSON_MESSAGE_INCOMPLETE if the
+ *    value continues past this chunk too, error otherwise (see stack trace)
+ */
+static JSONError_t resumeToken(JSONParser_t* parser, const char* message, size_t size){
+   TokenType_t type = parser->tokenType;
+   size_t end;
+
+   if (type == TOKEN_STRING){
+      //If the held part ends in an odd number of backslashes, the first
+      //character of this chunk has been escaped
+      bool escaped = false;
+      for (size_t i = parser->tokenLength; i > 0 && parser->token[i - 1] == '\\'; i--){
+         escaped = !escaped;
+      }
+      end = findStringEnd(message, 0, size, escaped);
+   }
+   else if (type == TOKEN_NUMBER){
+      end = findNumberEnd(message, 0, size);
+   }
+   else {
+      end = findLiteralEnd(message, 0, size);
+   }
+
+   JSONError_t returnStatus = holdToken(parser, type, message, (end < size) ? end : size);
+   if (returnStatus != JSON_MESSAGE_INCOMPLETE || end >= size){
+      //Either out of memory, or still not done
+      parser->index = size;
+      return returnStatus;
+   }
+
+   parser->tokenType = TOKEN_NONE;
+   parser->state &= ~RESUME;
+
+   //Strings stop on the closing quote, numbers and literals stop on
+   //the character after them
+   parser->index = (type == TOKEN_STRING) ? end + 1 : end;
+
+   if (type == TOKEN_STRING && (parser->options & PARSE_STRICT_UTF8) && parser->skipDepth == 0){
+      returnStatus = checkStringUTF8(parser, parser->token, parser->tokenLength);
+      if (returnStatus){
+         return returnStatus;
+      }
+   }
+
+   returnStatus = parseToken(parser, type, parser->token, parser->tokenLength);
+   if (returnStatus || type == TOKEN_STRING){
+      return returnStatus;
+   }
+
+   return checkValueEnd(parser, message, size);
+}
+
+/**
+ * Holds onto part of a value that has been cut off by the end of a chunk.
+ * The value is copied into the parsers token buffer, which grows as needed
+ * and is reused for every value that gets cut off.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param type - The kind of value being held
+ * @param token - The part of the value found in this chunk
+ * @param length - The length of the part
+ * @return JSON_MESSAGE_INCOMPLETE, or JSON_MALLOC_FAIL
+ */
+static JSONError_t holdToken(JSONParser_t* parser, TokenType_t type, const char* token, size_t length){
+   if (parser->tokenType == TOKEN_NONE){
+      //Starting a new value
+      parser->tokenLength = 0;
+   }
+
+   JSONError_t returnStatus = reserveToken(parser, parser->tokenLength + length + 1);
+   if (returnStatus){
+      return returnStatus;
+   }
+
+   memcpy(&parser->token[parser->tokenLength], token, length);
+   parser->tokenLength += length;
+   parser->token[parser->tokenLength] = '\0';
+   parser->tokenType = type;
+
+   return JSON_MESSAGE_INCOMPLETE;
+}
+
+/**
+ * Hands a complete value to the parser function for its type. Strings
+ * become keys or string values depending on what the parser was looking
+ * for. Values that are not in the parsers projection are dropped without
+ * being parsed.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param type - The kind of value being parsed
+ * @param token - The complete value
+ * @param length - The length of the value
+ * @return JSON_SUCCESS if the value was parsed correctly, error otherwise (see stack trace)
+ */
+static JSONError_t parseToken(JSONParser_t* parser, TokenType_t type, const char* token, size_t length){
+   const JSONProjectionStep_t* step = NULL;
+
+   if (parser->skipDepth > 0){
+      //A string that was cut off in an object or array being skipped
+      return JSON_SUCCESS;
+   }
+
+   if (type == TOKEN_STRING && (parser->state & KEY)){
+      return parseJSONKey(parser, token, length);
+   }
+
+   if (skipsValue(parser, &step) || step){
+      //Only objects and arrays are kept on the way to a projected value,
+      //so the key that led here goes with it
+      dropPendingKey(parser);
+      nextValueState(parser);
+      return JSON_SUCCESS;
+   }
+
+   switch (type){
+      case TOKEN_STRING :
+         return parseJSONString(parser, token, length);
+
+      case TOKEN_NUMBER :
+         return parseJSONNumber(parser, token, length);
+
+      case TOKEN_LITERAL :
+         return parseJSONLiteral(parser, token, length);
+
+      default :
+         PUSH_ERROR(parser, JSON_BAD_PARSER_STATE, -1);
+         json_errno = JSON_BAD_PARSER_STATE;
+         return JSON_BAD_PARSER_STATE;
+   }
+}
+
+/**
+ * This is a helper function to parse a single string value out of the
+ * message and into the document. The string is kept in its escaped form,
+ * use convertString() to expand the escape sequences, or parse with
+ * PARSE_DECODE_STRINGS (see parseDecodedString()). The string created
+ * by this function is dynamicly allocated, and is freed with the document.
+ * With PARSE_IN_SITU the string is left where it is in the message, unless
+ * it holds control characters that have to be escaped.
+ * 
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param token - The contents of the string (without the quotes)
+ * @param length - The length of the string
+ * @return JSON_SUCCESS if the string was parsed correctly, error otherwise (see stack trace)
+ */
+static JSONError_t parseJSONString(JSONParser_t* parser, const char* token, size_t length) {
+   if (parser->options & PARSE_DECODE_STRINGS){
+      return parseDecodedString(parser, token, length);
+   }
+
+   //Control characters have to be escaped in the document, so find out how
+   //much room they will need. Only escapes and control characters need to
+   //be looked at, the scanner skips over everything else in bulk.
+   size_t specialCharCount = 0;
+   size_t i = findEscapeOrControl(token, 0, length);
+   while (i < length){
+      if (token[i] == '\\'){
+         //We can have escaped unicode sequences of the style '\uXXXX'
+         if (token[i + 1] == 'u' || token[i + 1] == 'U'){
+            for (size_t j = i + 2; j < i + 6; j++){
+               if (j >= length || !(characterTraits[(unsigned char)token[j]] & TRAIT_HEX)){
+                  PUSH_ERROR(parser, JSON_INVALID_UNICODE_SEQ, -1);
+                  json_errno = JSON_INVALID_UNICODE_SEQ;
+                  return JSON_INVALID_UNICODE_SEQ;
+               }
+            }
+         }
+         
+         i += 2;  //The escaped character is copied as is
+      }
+      else {
+         if (token[i] == '\b' || token[i] == '\f' || token[i] == '\n' || token[i] == '\r' || token[i] == '\t'){
+            specialCharCount++;
+         }
+
+         i++;
+      }
+
+      i = findEscapeOrControl(token, i, length);
+   }
+   
+   if (parser->callbacks){
+      //Nothing needs to be copied, the string is passed straight from the message
+      const JSONCallbacks_t* callbacks = parser->callbacks;
+      nextValueState(parser);
+      return emitEvent(parser, !callbacks->string || callbacks->string(callbacks->context, token, length));
+   }
+
+   if (!specialCharCount && canBorrow(parser, token)){
+      //Nothing has to be changed, the closing quote becomes the terminator
+      JSONKeyValue_t* pair = newValuePair(parser, STRING);
+      if (!pair){
+         return JSON_MALLOC_FAIL;
+      }
+
+      char* borrowed = (char*)token;
+      borrowed[length] = '\0';
+      pair->value->sVal = borrowed;
+      pair->flags |= PAIR_STRING_BORROWED;
+      return attachValue(parser, pair);
+   }
+
+   size_t tempSize = sizeof(char) * (length + specialCharCount + 1);
+   char* temp = (parser->arena) ? (char*)allocateFromArena(parser->arena, tempSize) : (char*)malloc(tempSize);
+   if(!temp){
+      PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+      json_errno = JSON_MALLOC_FAIL;
+      return JSON_MALLOC_FAIL;
+   }
+   
+   if (specialCharCount){
+      //Copy the runs between the special characters in bulk
+      size_t tempIndex = 0;
+      size_t start = 0;
+      while (start < length){
+         size_t end = findEscapeOrControl(token, start, length);
+         memcpy(&temp[tempIndex], &token[start], end - start);
+         tempIndex += end - start;
+         if (end >= length){
+            break;
+         }
+
+         switch (token[end]){
+            case '\\' :
+               //Escape sequences are kept as they are
+               temp[tempIndex++] = token[end++];
+               if (end < length){
+                  temp[tempIndex++] = token[end++];
+               }
+               break;
+            case '\b' : temp[tempIndex++] = '\\'; temp[tempIndex++] = 'b'; end++; break;
+            case '\f' : temp[tempIndex++] = '\\'; temp[tempIndex++] = 'f'; end++; break;
+            case '\n' : temp[tempIndex++] = '\\'; temp[tempIndex++] = 'n'; end++; break;
+            case '\r' : temp[tempIndex++] = '\\'; temp[tempIndex++] = 'r'; end++; break;
+            case '\t' : temp[tempIndex++] = '\\'; temp[tempIndex++] = 't'; end++; break;
+            default : temp[tempIndex++] = token[end++]; break;
+         }
+
+         start = end;
+      }
+      temp[tempIndex] = '\0';
+   }
+   else {
+      memcpy(temp, token, length);
+      temp[length] = '\0';
+   }
+   
+   JSONKeyValue_t* pair = newValuePair(parser, STRING);
+   if (!pair){
+      if (!parser->arena){
+         free(temp);
+      }
+      return JSON_MALLOC_FAIL;
+   }
+   
+   pair->value->sVal = temp;
+   return attachValue(parser, pair);
+}
+   
+/**
+ * Parses a string with PARSE_DECODE_STRINGS. The escape sequences are
+ * expanded while the string is copied out of the message, so it is only
+ * read once and allocated once. The pair is marked PAIR_STRING_DECODED so
+ * the output module knows to escape it again. With PARSE_IN_SITU the string
+ * is decoded right in the message, and callbacks get it decoded in the
+ * token buffer.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param token - The contents of the string (without the quotes)
+ * @param length - The length of the string
+ * @return JSON_SUCCESS if the string was parsed correctly, error otherwise (see stack trace)
+ */
+static JSONError_t parseDecodedString(JSONParser_t* parser, const char* token, size_t length){
+   char* decoded = NULL;
+   int flags = PAIR_STRING_DECODED;
+
+   if (parser->callbacks){
+      //Escape sequences only ever get shorter, see parseJSONKey()
+      JSONError_t returnStatus = reserveToken(parser, length + 1);
+      if (returnStatus){
+         return returnStatus;
+      }
+
+      decoded = parser->token;
+   }
+   else if (canBorrow(parser, token)){
+      //The closing quote makes room for the null terminator
+      decoded = (char*)token;
+      flags |= PAIR_STRING_BORROWED;
+   }
+   else if (parser->arena){
+      decoded = (char*)allocateFromArena(parser->arena, sizeof(char) * (length + 1));
+   }
+   else {
+      decoded = (char*)malloc(sizeof(char) * (length + 1));
+   }
+
+   if (!decoded){
+      PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+      json_errno = JSON_MALLOC_FAIL;
+      return JSON_MALLOC_FAIL;
+   }
+
+   size_t decodedLength;
+   JSONError_t returnStatus = unescapeJSONString(token, length, decoded, &decodedLength);
+   if (returnStatus){
+      if (!parser->callbacks && !parser->arena && !(flags & PAIR_STRING_BORROWED)){
+         free(decoded);
+      }
+      PUSH_ERROR(parser, returnStatus, -1);
+      json_errno = returnStatus;
+      return returnStatus;
+   }
+
+   if (parser->callbacks){
+      const JSONCallbacks_t* callbacks = parser->callbacks;
+      nextValueState(parser);
+      return emitEvent(parser, !callbacks->string || callbacks->string(callbacks->context, decoded, decodedLength));
+   }
+
+   JSONKeyValue_t* pair = newValuePair(parser, STRING);
+   if (!pair){
+      if (!parser->arena && !(flags & PAIR_STRING_BORROWED)){
+         free(decoded);
+      }
+      return JSON_MALLOC_FAIL;
+   }
+
+   pair->value->sVal = decoded;
+   pair->flags |= flags;
+   return attachValue(parser, pair);
+}
+
+/**
+ * This is a helper function to parse a number from a JSON message. the 
+ * JSON standard states that all numbers should be treated like IEEE 753 64 bit
+ * double percesion numbers. That is exatly how C doubles work. They can 
+ * be in either normal, or scientific notation. They cannot however be in
+ * base 16 (which makes no sence for a double anyway).
+ * The number is checked against the JSON grammar and converted by
+ * stringToNumber(), which always gives the correctly rounded double.
+ * 
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param token - The characters of the number
+ * @param length - The number of characters
+ * @return JSON_SUCCESS if the number was parsed correctly, error otherwise (see stack trace)
+ */
+static JSONError_t parseJSONNumber(JSONParser_t* parser, const char* token, size_t length){
+   double newNum;
+
+   JSONError_t returnStatus = stringToNumber(token, length, &newNum);
+   if (returnStatus){
+      PUSH_ERROR(parser, returnStatus, -1);
+      json_errno = returnStatus;
+      return returnStatus;
+   }
+
+   if (parser->callbacks){
+      const JSONCallbacks_t* callbacks = parser->callbacks;
+      nextValueState(parser);
+      return emitEvent(parser, !callbacks->number || callbacks->number(callbacks->context, newNum));
+   }
+
+   JSONKeyValue_t* pair = newValuePair(parser, NUMBER);
+   if (!pair){
+      return JSON_MALLOC_FAIL;
+   }
+
+   pair->value->nVal = newNum;
+   return attachValue(parser, pair);
+}
+
+/**
+ * This is a helper function that will parse the unquoted values out of a
+ * JSON message. a boolean can only be 'true' or 'false' and no other values,
+ * and the only other unquoted value is 'null'.
+ * 
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param token - The characters of the value
+ * @param length - The number of characters
+ * @return JSON_SUCCESS if the value was parsed correctly, error otherwise (see stack trace)
+ */
+static JSONError_t parseJSONLiteral(JSONParser_t* parser, const char* token, size_t length){
+   bool isNull = false;
+   bool value = false;
+   
+   if (length == 4 && memcmp(token, "true", 4) == 0){
+      value = true;
+   }
+   else if (length == 5 && memcmp(token, "false", 5) == 0){
+      value = false;
+   }
+   else if (length == 4 && memcmp(token, "null", 4) == 0){
+      isNull = true;
+   }
+   else {
+      //not true, false, or null
+      PUSH_ERROR(parser, JSON_INVALID_VALUE, -1);
+      json_errno = JSON_INVALID_VALUE;
+      return JSON_INVALID_VALUE;
+   }
+   
+   if (parser->callbacks){
+      const JSONCallbacks_t* callbacks = parser->callbacks;
+      nextValueState(parser);
+      if (isNull){
+         return emitEvent(parser, !callbacks->null || callbacks->null(callbacks->context));
+      }
+
+      return emitEvent(parser, !callbacks->boolean || callbacks->boolean(callbacks->context, value));
+   }
+
+   JSONKeyValue_t* pair = newValuePair(parser, (isNull) ? NIL : BOOLEAN);
+   if (!pair){
+      return JSON_MALLOC_FAIL;
+   }
+
+   if (!isNull){
+      pair->value->bVal = value;
+   }
+   
+   return attachValue(parser, pair);
+}
+
+/**
+ * This helper function will parse out an key for a key:value pair and 
+ * hold it as the parsers pending key until its value is attached. When the parser has callbacks
+ * the key is converted in the token buffer and handed to the key callback
+ * instead. Keys that are interned are also converted in the token buffer,
+ * and then replaced with the copy from the key table. Keys whose values
+ * are not in the parsers projection are dropped without being copied.
+ * Keys on the way to a projected value are only sent to the key callback
+ * once the value turns out to be an object or array.
+ * 
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param token - The characters of the key (without the quotes)
+ * @param length - The number of characters
+ * @return JSON_SUCCESS if the key was parsed correctly, error otherwise (see stack trace)
+ */
+static JSONError_t  parseJSONKey(JSONParser_t* parser, const char* token, size_t length){
+   const JSONProjectionStep_t* step = parser->frames[parser->depth - 1].step;
+   bool escaped = (step && memchr(token, '\\', length));
+   char* key = NULL;
+
+   if (step && !escaped){
+      parser->pendingStep = findJSONProjectionStep(step, token, length);
+      if (!parser->pendingStep){
+         //The value will be skipped, so the key is not needed
+         parser->state &= CLEAR_STATE;
+         parser->state |= (DELIMITER);
+         return JSON_SUCCESS;
+      }
+   }
+
+   if (parser->callbacks){
+      //Escape sequences only ever get shorter, so the key can be converted
+      //in the token buffer even when the key is already sitting in it
+      JSONError_t returnStatus = reserveToken(parser, length + 1);
+      if (returnStatus){
+         return returnStatus;
+      }
+
+      key = parser->token;
+   }
+   else {
+      parser->keyFlags = 0;
+      if (parser->keyTable){
+         //The key is converted in the token buffer, and then looked up
+         JSONError_t returnStatus = reserveToken(parser, length + 1);
+         if (returnStatus){
+            return returnStatus;
+         }
+
+         key = parser->token;
+         parser->keyFlags = PAIR_KEY_INTERNED;
+      }
+      else if (canBorrow(parser, token)){
+         //The key is converted in place, it only ever gets shorter and the
+         //closing quote makes room for the null terminator
+         key = (char*)token;
+         parser->keyFlags = PAIR_KEY_BORROWED;
+      }
+      else if (parser->arena){
+         key = (char*)allocateFromArena(parser->arena, sizeof(char) * (length + 1));
+      }
+      else {
+         key = (char*)malloc(sizeof(char) * (length + 1));
+      }
+      
+      if (!key){
+         PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+         json_errno = JSON_MALLOC_FAIL;
+         return JSON_MALLOC_FAIL;
+      }
+   }
+   
+   size_t keyIndex = 0;
+
+   //Keys can have escape sequences in them, we have to make sure they are
+   //converted properly.
+   JSONError_t returnStatus = unescapeJSONString(token, length, key, &keyIndex);
+   if (returnStatus){
+      if (!parser->callbacks && !parser->arena && !parser->keyFlags){
+         free(key);
+      }
+      if (returnStatus == JSON_UNEXPECTED_CHARACTER){
+         returnStatus = JSON_INVALID_KEY;
+      }
+      PUSH_ERROR(parser, returnStatus, -1);
+      json_errno = returnStatus;
+      return returnStatus;
+   }
+
+   if (escaped){
+      //Escaped keys can only be matched once they are converted
+      parser->pendingStep = findJSONProjectionStep(step, key, keyIndex);
+      if (!parser->pendingStep){
+         if (!parser->callbacks && !parser->arena && !parser->keyFlags){
+            free(key);
+         }
+         parser->state &= CLEAR_STATE;
+         parser->state |= (DELIMITER);
+         return JSON_SUCCESS;
+      }
+   }
+
+   if (!parser->callbacks && parser->keyTable){
+      key = (char*)internJSONKey(parser->keyTable, key, keyIndex);
+      if (!key){
+         PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+         json_errno = JSON_MALLOC_FAIL;
+         return JSON_MALLOC_FAIL;
+      }
+   }
+
+   parser->state &= CLEAR_STATE;
+   parser->state |= (DELIMITER);
+
+   if (parser->callbacks){
+      const JSONCallbacks_t* callbacks = parser->callbacks;
+      if (parser->pendingStep && !parser->pendingStep->keepAll){
+         //The value is only sent if it is an object or array, so the key
+         //waits in the token buffer until the value shows up
+         parser->pendingKey = key;
+         parser->pendingKeyLength = keyIndex;
+         return JSON_SUCCESS;
+      }
+      return emitEvent(parser, !callbacks->key || callbacks->key(callbacks->context, key, keyIndex));
+   }
+
+   //Hold the key until its value shows up. Nested objects and arrays are
+   //attached as soon as they open, so there is never more than one
+   parser->pendingKey = key;
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Starts a new object or array. The new pair is attached to the document
+ * right away, and pushed onto the frame stack so the values that follow
+ * are added to it. With callbacks only the type is pushed. If it is not 
+ * in the parsers projection nothing is pushed, and it is skipped instead.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param type - OBJECT or ARRAY
+ * @return JSON_SUCCESS, or an error (see stack trace)
+ */
+static JSONError_t openContainer(JSONParser_t* parser, JSONType_t type){
+   if (parser->depth >= parser->maxDepth){
+      PUSH_ERROR(parser, JSON_MESSAGE_TOO_LARGE, -1);
+      json_errno = JSON_MESSAGE_TOO_LARGE;
+      return JSON_MESSAGE_TOO_LARGE;
+   }
+
+   const JSONProjectionStep_t* step = NULL;
+   if (skipsValue(parser, &step)){
+      parser->skipDepth = 1;
+      return JSON_SUCCESS;
+   }
+
+   if (parser->depth >= parser->frameCapacity){
+      JSONError_t returnStatus = growFrames(parser);
+      if (returnStatus){
+         return returnStatus;
+      }
+   }
+
+   JSONParserFrame_t* frame = &parser->frames[parser->depth];
+
+   if (parser->callbacks){
+      const JSONCallbacks_t* callbacks = parser->callbacks;
+      if (parser->pendingKey){
+         //The key was held back until its value turned out to be kept
+         char* key = parser->pendingKey;
+         parser->pendingKey = NULL;
+         JSONError_t returnStatus = emitEvent(parser, !callbacks->key || callbacks->key(callbacks->context, key, parser->pendingKeyLength));
+         if (returnStatus){
+            return returnStatus;
+         }
+      }
+
+      bool keepGoing = (type == OBJECT) ?
+                       (!callbacks->startObject || callbacks->startObject(callbacks->context)) :
+                       (!callbacks->startArray || callbacks->startArray(callbacks->context));
+
+      frame->type = type;
+      frame->pair = NULL;
+      frame->tail = NULL;
+      frame->step = step;
+      parser->depth++;
+
+      return emitEvent(parser, keepGoing);
+   }
+   
+   JSONKeyValue_t* pair = NULL;
+   if (parser->depth == 0 && (parser->options & PARSE_ARENA)){
+      //The root of the document owns the arena everything else comes from
+      if (!parser->arena){
+         parser->arena = newJSONArena(0);
+      }
+
+      pair = (parser->arena) ? newArenaDocument(parser->arena, type) : NULL;
+      if (!pair){
+         PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+         json_errno = JSON_MALLOC_FAIL;
+         return JSON_MALLOC_FAIL;
+      }
+
+      if (parser->ownsKeyTable){
+         //Each document keeps its own keys
+         resetJSONKeyTable(parser->keyTable, parser->arena);
+      }
+   }
+   else {
+      pair = newValuePair(parser, type);
+      if (!pair){
+         return JSON_MALLOC_FAIL;
+      }
+   }
+   pair->length = 0;
+
+   if (parser->depth == 0){
+      //This is the root of a new document
+      parser->document = pair;
+   }
+   else {
+      attachValue(parser, pair);
+   }
+
+   frame->type = type;
+   frame->pair = pair;
+   frame->tail = NULL;
+   frame->step = step;
+   parser->depth++;
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Makes room for more open objects and arrays. The frame stack starts
+ * small and doubles each time it fills up, so shallow messages never 
+ * need much, and it is kept between messages.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @return JSON_SUCCESS, or JSON_MALLOC_FAIL
+ */
+static JSONError_t growFrames(JSONParser_t* parser){
+   int capacity = (parser->frameCapacity) ? parser->frameCapacity * 2 : FRAME_STACK_SIZE;
+   JSONParserFrame_t* frames = (JSONParserFrame_t*)realloc(parser->frames, capacity * sizeof(JSONParserFrame_t));
+   if (!frames){
+      PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+      json_errno = JSON_MALLOC_FAIL;
+      return JSON_MALLOC_FAIL;
+   }
+
+   parser->frames = frames;
+   parser->frameCapacity = capacity;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Finishes the object or array on the top of the frame stack, and sets
+ * the state up for whatever comes after it in the parent.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param document - The completed document is placed here if this was the root
+ * @return JSON_SUCCESS if this finished the whole document, JSON_MESSAGE_INCOMPLETE
+ *    if the message continues, error otherwise (see stack trace)
+ */
+static JSONError_t closeContainer(JSONParser_t* parser, JSONKeyValue_t** document){
+   parser->depth--;
+
+   JSONType_t type = parser->frames[parser->depth].type;
+   parser->frames[parser->depth].pair = NULL;
+   parser->frames[parser->depth].tail = NULL;
+
+   if (parser->callbacks){
+      const JSONCallbacks_t* callbacks = parser->callbacks;
+      bool keepGoing = (type == OBJECT) ?
+                       (!callbacks->endObject || callbacks->endObject(callbacks->context)) :
+                       (!callbacks->endArray || callbacks->endArray(callbacks->context));
+
+      JSONError_t returnStatus = emitEvent(parser, keepGoing);
+      if (returnStatus){
+         return returnStatus;
+      }
+   }
+
+   if (parser->depth == 0){
+      if (document && parser->document){
+         *document = parser->document;
+         if (getDocumentArena(parser->document)){
+            //The arena belongs to the document now, and so do the keys
+            //that were interned in it
+            parser->arena = NULL;
+            if (parser->ownsKeyTable){
+               resetJSONKeyTable(parser->keyTable, NULL);
+            }
+         }
+      }
+
+      parser->document = NULL;
+      return JSON_SUCCESS;
+   }
+
+   nextValueState(parser);
+   return JSON_MESSAGE_INCOMPLETE;
+}
+
+/**
+ * Links a value onto the end of the object or array on the top of the
+ * frame stack. Values in an object take the pending key.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param pair - The value being added
+ * @return JSON_SUCCESS
+ */
+static JSONError_t attachValue(JSONParser_t* parser, JSONKeyValue_t* pair){
+   JSONParserFrame_t* frame = &parser->frames[parser->depth - 1];
+
+   if (frame->type == OBJECT){
+      pair->key = parser->pendingKey;
+      pair->flags |= parser->keyFlags;
+      parser->pendingKey = NULL;
+   }
+
+   if (frame->tail){
+      frame->tail->next = pair;
+   }
+   else {
+      frame->pair->value->oVal = pair;
+   }
+
+   frame->tail = pair;
+   frame->pair->length++;
+
+   nextValueState(parser);
+   return JSON_SUCCESS;
+}
+
+/**
+ * Decides if the value that is starting is in the parsers projection. In
+ * an object the step was found with the values key, in an array every
+ * element takes the "[*]" step.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param step - Set to where the value is in the projection, or NULL if
+ *    everything under the value is kept
+ * @return true if the value is not in the projection, and has to be skipped
+ */
+static bool skipsValue(JSONParser_t* parser, const JSONProjectionStep_t** step){
+   *step = NULL;
+
+   if (!parser->projection){
+      return false;
+   }
+
+   if (parser->depth == 0){
+      *step = &parser->projection->root;
+      return false;
+   }
+
+   JSONParserFrame_t* frame = &parser->frames[parser->depth - 1];
+   if (!frame->step){
+      return false;
+   }
+
+   const JSONProjectionStep_t* next;
+   if (frame->type == OBJECT){
+      next = parser->pendingStep;
+      parser->pendingStep = NULL;
+   }
+   else {
+      next = findJSONProjectionStep(frame->step, NULL, 0);
+   }
+
+   if (!next){
+      return true;
+   }
+
+   *step = (next->keepAll) ? NULL : next;
+   return false;
+}
+
+/**
+ * Sets the state up for whatever can come after a value in the object
+ * or array on the top of the frame stack.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ */
+static void nextValueState(JSONParser_t* parser){
+   parser->state &= CLEAR_STATE;
+   if (parser->frames[parser->depth - 1].type == OBJECT){
+      parser->state |= (COMMA | CLOSE_PREN);
+   }
+   else {
+      parser->state |= (COMMA | CLOSE_BRACKET);
+   }
+}
+
+/**
+ * Checks the return value of a callback. A callback returns false when
+ * it wants the parser to stop.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param keepGoing - What the callback returned
+ * @return JSON_SUCCESS, or JSON_CALLBACK_ABORTED
+ */
+static JSONError_t emitEvent(JSONParser_t* parser, bool keepGoing){
+   if (!keepGoing){
+      PUSH_ERROR(parser, JSON_CALLBACK_ABORTED, -1);
+      json_errno = JSON_CALLBACK_ABORTED;
+      return JSON_CALLBACK_ABORTED;
    }
-   
-   *result = newObj;
+
    return JSON_SUCCESS;
 }
 
 /**
- * This helper function will parse out a JSON array value from the JSON message.
- * The JSON standard states that a JSON array is an ordered collection of
- * values without keys. They can be a mix of types. 
- * 
+ * Makes sure the token buffer can hold at least size bytes. The buffer
+ * only ever grows, so once it is large enough no more memory is needed.
+ *
  * @param parser - The parser object that is keeping track of this specific document
- * @param message - The JSON message 
- * @param size - The length of the message
- * @param result - The array that is parsed out will be put here
- * @return JSON_SUCCESS if the array was parsed correctly, error otherwise (see stack trace)
- */
-static JSONError_t parseJSONArray(JSONParser_t* parser, const char* message, int size, JSONKeyValue_t** result){
-   int arraySize = 12;
-   void** elements = (void**) malloc(sizeof(void*) * (arraySize + 1));
-   JSONType_t* types = (JSONType_t*) malloc(sizeof(JSONType_t) * (arraySize + 1));
-   int index = 0;
-   JSONError_t returnStatus;
-   
-   JSONKeyValue_t* array;
-   
-   if (!elements || !types){
+ * @param size - The number of bytes needed
+ * @return JSON_SUCCESS, or JSON_MALLOC_FAIL
+ */
+static JSONError_t reserveToken(JSONParser_t* parser, size_t size){
+   if (size <= parser->tokenSize){
+      return JSON_SUCCESS;
+   }
+
+   size_t newSize = (parser->tokenSize) ? parser->tokenSize : 64;
+   while (newSize < size){
+      newSize *= 2;
+   }
+
+   char* newToken = (char*)realloc(parser->token, newSize);
+   if (!newToken){
       PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
       json_errno = JSON_MALLOC_FAIL;
       return JSON_MALLOC_FAIL;
    }
-   
-   parser->state &= CLEAR_STATE;
-   parser->state |= (VALUE | QUOTE | CHARACTER | DIGIT | CLOSE_BRACKET | OPEN_PREN);
-   
-   while(parser->index < size){
-      if (isspace(message[parser->index])){
-         if (message[parser->index] == '\n'){
-            parser->lineNumber++;
-         }
-         //we can ignore white space
+
+   parser->token = newToken;
+   parser->tokenSize = newSize;
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Creates a new pair and value for the parser to fill in. NULL values
+ * do not get a value. When the document is being built in an arena the
+ * pair comes from the arena.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param type - The type of the new pair
+ * @return The new pair, or NULL if memory could not be allocated
+ */
+static JSONKeyValue_t* newValuePair(JSONParser_t* parser, JSONType_t type){
+   if (parser->arena){
+      JSONKeyValue_t* pair = newArenaPair(parser->arena, type);
+      if (!pair){
+         PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+         json_errno = JSON_MALLOC_FAIL;
       }
-      else if (isalpha(message[parser->index])){
-         if (message[parser->index] == 'n'){
-            if ((parser->state & CHARACTER) && (parser->state & VALUE)){
-               returnStatus = parseJSONNull(parser, message, size);
-               if (!returnStatus){
-                  elements[index] = NULL;
-                  types[index] = NIL;
-                  index++;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_BRACKET);
-               }
-               else {
-                  return returnStatus;
-               }
-            }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_NULL, -1);
-               json_errno = JSON_UNEXPECTED_NULL;
-               return JSON_UNEXPECTED_NULL;
-            }
-         }
-         else if (message[parser->index] == 't' || message[parser->index] == 'f'){
-            //We found a boolean (should be true or false) they are not quoted
-            if (parser->state & VALUE && parser->state & CHARACTER){
-               bool* boolVal = (bool*)malloc(sizeof(bool));
-               returnStatus = parseJSONBoolean(parser, message, size, boolVal);
-               if (!returnStatus){
-                  elements[index] = boolVal;
-                  types[index] = BOOLEAN;
-                  index++;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_BRACKET);
-               }
-               else {
-                  return returnStatus;
-               }
-            }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_BOOLEAN, -1);
-               json_errno = JSON_UNEXPECTED_BOOLEAN;
-               return JSON_UNEXPECTED_BOOLEAN;
-            }
-         }
-         else {
-            PUSH_ERROR(parser, JSON_UNEXPECTED_CHARACTER, -1);
-            json_errno = JSON_UNEXPECTED_CHARACTER;
-            return JSON_UNEXPECTED_CHARACTER;
+
+      return pair;
+   }
+
+   JSONKeyValue_t* pair = parser->sparePairs;
+   if (pair){
+      parser->sparePairs = pair->next;
+      memset(pair, 0, sizeof(JSONKeyValue_t));
+   }
+   else {
+      pair = (JSONKeyValue_t*)calloc(1, sizeof(JSONKeyValue_t));
+      if (!pair){
+         PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+         json_errno = JSON_MALLOC_FAIL;
+         return NULL;
+      }
+   }
+
+   if (type != NIL && parser->spareValues){
+      pair->value = parser->spareValues;
+      parser->spareValues = (JSONValue_t*)pair->value->oVal;
+      memset(pair->value, 0, sizeof(JSONValue_t));
+   }
+   else if (type != NIL){
+      pair->value = (JSONValue_t*)calloc(1, sizeof(JSONValue_t));
+      if (!pair->value){
+         free(pair);
+         PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
+         json_errno = JSON_MALLOC_FAIL;
+         return NULL;
+      }
+   }
+
+   pair->type = type;
+   pair->length = 1;
+
+   return pair;
+}
+
+/**
+ * Takes apart a document that was built with malloc, and keeps its pairs
+ * and values so newValuePair() can build the next document out of them.
+ * The keys and strings are freed, they are not the same size from one
+ * message to the next. The tree is walked without recursing, the children
+ * of each object and array are put in front of the pairs left to visit.
+ *
+ * @param parser - The parser that will keep the pairs
+ * @param document - The root of the document, it can not be used after this
+ */
+static void keepSparePairs(JSONParser_t* parser, JSONKeyValue_t* document){
+   if (!document){
+      return;
+   }
+
+   if ((document->flags & PAIR_IN_ARENA) || (parser->options & PARSE_ARENA)){
+      //The pairs would never be used, documents come from the arena
+      disposeOfPair(document);
+      return;
+   }
+
+   document->next = NULL;
+   JSONKeyValue_t* pending = document;
+   while (pending){
+      JSONKeyValue_t* pair = pending;
+      pending = pair->next;
+
+      if ((pair->type == OBJECT || pair->type == ARRAY) && pair->value->oVal){
+         JSONKeyValue_t* last = pair->value->oVal;
+         while (last->next){
+            last = last->next;
          }
+         last->next = pending;
+         pending = pair->value->oVal;
+      }
+      else if (pair->type == STRING && !(pair->flags & PAIR_STRING_BORROWED)){
+         free(pair->value->sVal);
+      }
+
+      if (pair->key && !(pair->flags & (PAIR_KEY_BORROWED | PAIR_KEY_INTERNED))){
+         free(pair->key);
+      }
+
+      if (pair->value){
+         pair->value->oVal = (JSONKeyValue_t*)parser->spareValues;
+         parser->spareValues = pair->value;
+      }
+
+      pair->next = parser->sparePairs;
+      parser->sparePairs = pair;
+   }
+}
+
+/**
+ * Frees the pairs and values kept from recycled documents
+ *
+ * @param parser - The parser that is keeping them
+ */
+static void disposeOfSparePairs(JSONParser_t* parser){
+   while (parser->sparePairs){
+      JSONKeyValue_t* next = parser->sparePairs->next;
+      free(parser->sparePairs);
+      parser->sparePairs = next;
+   }
+
+   while (parser->spareValues){
+      JSONValue_t* next = (JSONValue_t*)parser->spareValues->oVal;
+      free(parser->spareValues);
+      parser->spareValues = next;
+   }
+}
+
+/**
+ * Checks if a key or string can point straight into the message instead
+ * of being copied. That is only allowed with PARSE_IN_SITU, and only when
+ * the characters are in the message itself and not in the token buffer
+ * (where a value cut off by the end of a chunk is put back together).
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param token - The characters of the key or string
+ * @return true if the key or string can be borrowed from the message
+ */
+static bool canBorrow(JSONParser_t* parser, const char* token){
+   return (parser->options & PARSE_IN_SITU) && token != parser->token;
+}
+
+/**
+ * Finds the closing quote of a string.
+ *
+ * @param message - The JSON message
+ * @param index - The first character inside of the string
+ * @param size - The length of the message
+ * @param escaped - true if the first character has been escaped
+ * @return The index of the closing quote, or size if the message ran out
+ */
+static size_t findStringEnd(const char* message, size_t index, size_t size, bool escaped){
+   while(index < size){
+      if (escaped){
+         escaped = false;
+         index++;
+         continue;
+      }
+
+      index = findQuoteOrEscape(message, index, size);
+      if (index >= size){
+         break;
+      }
+      else if (message[index] == '"'){
+         return index;
       }
-      else if (isdigit(message[parser->index])) {
-         //We found a number value, they are not quoted
-         if (parser->state & DIGIT){
-            double* value = (double*)malloc(sizeof(double));
-            returnStatus = parseJSONNumber(parser, message, size, value);
-            if (!returnStatus){
-               elements[index] = value;
-               types[index] = NUMBER;
-               index++;
-               
-               parser->state &= CLEAR_STATE;
-               parser->state |= (COMMA | CLOSE_BRACKET);
+
+      //Found a backslash, the next character is escaped
+      escaped = true;
+      index++;
+   }
+
+   return size;
+}
+
+/**
+ * Finds the end of a number value.
+ *
+ * @param message - The JSON message
+ * @param index - The first character of the number
+ * @param size - The length of the message
+ * @return The index of the first character after the number, or size if
+ *    the message ran out
+ */
+static size_t findNumberEnd(const char* message, size_t index, size_t size){
+   while(index < size && (characterTraits[(unsigned char)message[index]] & TRAIT_NUMBER)){
+      index++;
+   }
+
+   return index;
+}
+
+/**
+ * Finds the end of an unquoted value (true, false, or null).
+ *
+ * @param message - The JSON message
+ * @param index - The first character of the value
+ * @param size - The length of the message
+ * @return The index of the first character after the value, or size if
+ *    the message ran out
+ */
+static size_t findLiteralEnd(const char* message, size_t index, size_t size){
+   while(index < size && (characterTraits[(unsigned char)message[index]] & TRAIT_LETTER)){
+      index++;
+   }
+
+   return index;
+}
+
+/**
+ * Reads 8 bytes of the message as one word. The bytes are copied in the
+ * order they are in memory, so comparing two words read this way does not
+ * depend on the byte order of the machine.
+ *
+ * @param bytes - At least 8 bytes
+ * @return The bytes as a word
+ */
+static inline uint64_t readWord(const char* bytes){
+   uint64_t word;
+   memcpy(&word, bytes, sizeof(word));
+   return word;
+}
+
+/**
+ * Checks for true, false, or null with a single 8 byte load instead of
+ * finding the end of the literal one letter at a time and comparing it
+ * afterwards. The literal only counts when the character after it can end
+ * a value, so trueish, nul, and true1 are left for findLiteralEnd() and
+ * checkValueEnd() to report. 
+ *
+ * @param token - The first character of the literal
+ * @param available - How many bytes are left in the message
+ * @return The length of the literal, or 0 if it could not be matched
+ */
+static size_t matchLiteral(const char* token, size_t available){
+   if (available < sizeof(uint64_t)){
+      return 0;
+   }
+
+   //The constants are built the same way as the word, and folded away by the compiler
+   uint64_t word = readWord(token);
+   size_t length;
+   if ((word & readWord("\xff\xff\xff\xff\0\0\0")) == readWord("true\0\0\0")){
+      length = 4;
+   }
+   else if ((word & readWord("\xff\xff\xff\xff\xff\0\0")) == readWord("false\0\0")){
+      length = 5;
+   }
+   else if ((word & readWord("\xff\xff\xff\xff\0\0\0")) == readWord("null\0\0\0")){
+      length = 4;
+   }
+   else {
+      return 0;
+   }
+
+   return (characterTraits[(unsigned char)token[length]] & TRAIT_DELIMITER) ? length : 0;
+}
+
+/**
+ * Throws away everything the parser was holding for the message it was
+ * working on. This is used when a message can not be completed.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ */
+static void releaseMessage(JSONParser_t* parser){
+   if (getDocumentArena(parser->document)){
+      //Everything came from the arena, keep it for the next message
+      resetJSONArena(parser->arena);
+   }
+   else {
+      keepSparePairs(parser, parser->document);
+   }
+   parser->document = NULL;
+
+   dropPendingKey(parser);
+   parser->pendingStep = NULL;
+   parser->skipDepth = 0;
+
+   for (int i = 0; i < parser->depth; i++){
+      parser->frames[i].pair = NULL;
+      parser->frames[i].tail = NULL;
+   }
+
+   parser->depth = 0;
+   parser->tokenType = TOKEN_NONE;
+   parser->tokenLength = 0;
+   parser->commentState = COMMENT_NONE;
+   parser->state = (OPEN_PREN | OPEN_BRACKET);
+}
+
+/**
+ * Lets go of the key that was waiting for its value. Keys that are
+ * borrowed, interned, from the arena, or held in the token buffer for the
+ * key callback belong to something else, so only malloced keys are freed.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ */
+static void dropPendingKey(JSONParser_t* parser){
+   if (parser->pendingKey && !parser->callbacks && !parser->arena && !parser->keyFlags){
+      free(parser->pendingKey);
+   }
+   parser->pendingKey = NULL;
+   parser->keyFlags = 0;
+}
+
+/**
+ * Steps the parser past any white space and comments in front of a message.
+ * Both block comments and single line comments are skipped. The parser
+ * index will be left on the first meaningful character, or at size if
+ * the message ran out first. A comment that is cut off by the end of the
+ * message is remembered so the next chunk can finish skipping it.
+ *
+ * @param parser - The parser object that is keeping track of this specific document
+ * @param message - The JSON message
+ * @param size - The length of the message
+ */
+static void skipWhiteSpace(JSONParser_t* parser, const char* message, size_t size){
+   while(parser->index < size){
+      char current = message[parser->index];
+
+      switch (parser->commentState){
+         case COMMENT_SLASH :
+            if (current == '*'){
+               parser->commentState = COMMENT_BLOCK;
             }
-            else {
-               return returnStatus;
+            else if (current == '/'){
+               parser->commentState = COMMENT_LINE;
             }
-         }
-         else {
-            PUSH_ERROR(parser, JSON_UNEXPECTED_NUMBER, -1);
-            json_errno = JSON_UNEXPECTED_NUMBER;
-            return JSON_UNEXPECTED_NUMBER;
-         }
-      }
-      else if (ispunct(message[parser->index])){
-         if (message[parser->index] == '"') {
-            //Found beginning of a string value (No keys in arrays)
-            if (parser->state & QUOTE) {
-               parser->index++;
-               char* value;
-               returnStatus = parseJSONString(parser, message, size, &value);
-               if (!returnStatus) {
-                  elements[index] = value;
-                  types[index] = STRING;
-                  index++;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_BRACKET);
-               }
-               else {
-                  return returnStatus;
+            else {
+               //Not a comment after all, let the '/' be reported as an
+               //invalid message
+               parser->commentState = COMMENT_NONE;
+               if (parser->index > 0){
+                  parser->index--;
                }
+               return;
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_STRING, -1);
-               json_errno = JSON_UNEXPECTED_STRING;
-               return JSON_UNEXPECTED_STRING;
+            break;
+
+         case COMMENT_BLOCK :
+            if (current == '*'){
+               parser->commentState = COMMENT_STAR;
             }
-         }
-         else if (message[parser->index] == '{') {
-            //Found the beginning of a JSON object
-            if ((parser->state & VALUE) && (parser->state & OPEN_PREN)){
-               parser->depth++;
-               parser->index++;
-               JSONValue_t* objVal;
-               returnStatus = parseJSONObject(parser, message, size, &objVal);
-               if (!returnStatus){
-                  elements[index] = objVal;
-                  types[index] = OBJECT;
-                  index++;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_BRACKET);
-               }
-               else {
-                  return returnStatus;
-               }
+            else if (current == '\n'){
+               parser->lineNumber++;
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_OBJECT, -1);
-               json_errno = JSON_UNEXPECTED_OBJECT;
-               return JSON_UNEXPECTED_OBJECT;
+            break;
+
+         case COMMENT_STAR :
+            if (current == '/'){
+               //Found end of comment
+               parser->commentState = COMMENT_NONE;
             }
-         }
-         else if (message[parser->index] == '['){
-            //Found the beginning of an array
-            if ((parser->state & VALUE) && (parser->state & OPEN_BRACKET)){
-               parser->index++;
-               JSONKeyValue_t* arrVal;
-               returnStatus = parseJSONArray(parser, message, size, &arrVal);
-               if (!returnStatus){
-                  elements[index] = arrVal;
-                  types[index] = ARRAY;
-                  index++;
-                  
-                  parser->state &= CLEAR_STATE;
-                  parser->state |= (COMMA | CLOSE_BRACKET);
-               }
-               else {
-                  return returnStatus;
+            else if (current != '*'){
+               parser->commentState = COMMENT_BLOCK;
+               if (current == '\n'){
+                  parser->lineNumber++;
                }
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_ARRAY, -1);
-               json_errno = JSON_UNEXPECTED_ARRAY;
-               return JSON_UNEXPECTED_ARRAY;
-            }
-         }
-         else if (message[parser->index] == ']'){
-            if (parser->state & CLOSE_BRACKET){
-               //Done here
-               break;
+            break;
+
+         case COMMENT_LINE :
+            if (current == '\n'){
+               parser->commentState = COMMENT_NONE;
+               parser->lineNumber++;
             }
-            else{
-               PUSH_ERROR(parser, JSON_ARRAY_BRACKET_MISMATCH, -1);
-               json_errno = JSON_ARRAY_BRACKET_MISMATCH;
-               return JSON_ARRAY_BRACKET_MISMATCH;
+            break;
+
+         default :
+            if (current == '/'){
+               parser->commentState = COMMENT_SLASH;
             }
-         }
-         else if (message[parser->index] == ','){
-            if (parser->state & COMMA){
-               //Found seperator, we should expect another value
-               parser->state &= CLEAR_STATE;
-               parser->state |= (VALUE | QUOTE | CHARACTER | DIGIT | OPEN_PREN | OPEN_BRACKET);
+            else if ((unsigned char)current > ' ' && (unsigned char)current < 0x7F){
+               //We found the first character in the message
+               return;
             }
-            else {
-               PUSH_ERROR(parser, JSON_UNEXPECTED_COMMA, -1);
-               json_errno = JSON_UNEXPECTED_COMMA;
-               return JSON_UNEXPECTED_COMMA;
+            else if (current == '\n') {
+               parser->lineNumber++;
             }
-         }
-         else if (message[parser->index] == '}'){
-            PUSH_ERROR(parser, JSON_OBJECT_BRACKET_MISMATCH, -1);
-            json_errno = JSON_OBJECT_BRACKET_MISMATCH;
-            return JSON_OBJECT_BRACKET_MISMATCH;
-         }
-         else {
-            PUSH_ERROR(parser, JSON_UNEXPECTED_CHARACTER, -1);
-            json_errno = JSON_UNEXPECTED_CHARACTER;
-            return JSON_UNEXPECTED_CHARACTER;
-         }
-      }
-      
-      if (index >= arraySize){
-         arraySize *= 2;
-         elements = (void**) realloc(elements, sizeof(void*) * (arraySize + 1));
-         types = (JSONType_t*) realloc(types, sizeof(JSONType_t) * (arraySize + 1));
-         
-         if (!elements || ! types){
-            PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
-            json_errno = JSON_MALLOC_FAIL;
-            return JSON_MALLOC_FAIL;
-         }
+            break;
       }
-      
+
       parser->index++;
    }
-   
-   if (parser->index >= size){
-      PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
-      json_errno = JSON_MESSAGE_INCOMPLETE;
-      return JSON_MESSAGE_INCOMPLETE;
-   }
-   
-   array = newJSONArray(elements, types, index);
-   
-   //Need to free the booleans, numbers, and strings
-   for (int i = 0; i < array->length; i++){
-      if (types[i] == NUMBER || types[i] == BOOLEAN || types[i] == STRING){
-         free(elements[i]);
-      }
-   }
-   
-   free(elements);
-   free(types);
-   
-   *result= array;
-   return JSON_SUCCESS;
 }
 
 /**
- * This helper function will parse out an key for a key:value pair and 
- * push it onto the key stack of the parser. 
- * 
+ * Brings the line number up to date by counting the new lines between
+ * the last place they were counted and the current position.
+ *
  * @param parser - The parser object that is keeping track of this specific document
- * @param message - The JSON message 
- * @param size - The length of the message
- * @return JSON_SUCCESS if the key was parsed correctly, error otherwise (see stack trace)
+ * @param message - The message the parser is working on
  */
-static JSONError_t  parseJSONKey(JSONParser_t* parser, const char* message, int size){
-   char temp[0x100];
-   int tempIndex = 0;
-   
-   //Keys can have escape sequences in them, we have to make sure they are
-   //converted properly. 
-   while(parser->index < size && message[parser->index] != '"') {
-      if (message[parser->index] == '\\'){
-         parser->index++;
-         switch (message[parser->index]){
-            case 'n':   //newline
-               temp[tempIndex++] = '\n';
-               break;
-               
-            case 't':   //tab
-               temp[tempIndex++] = '\t';
-               break;
-            
-            case 'b':   //backspace
-               temp[tempIndex++] = '\b';
-               break;
-               
-            case '\\':  //backslash
-               temp[tempIndex++] = '\\';
-               break;
-               
-            case 'f':   //formfeed
-               temp[tempIndex++] = '\f';
-               break;
-               
-            case '"':   //quote charcter
-               temp[tempIndex++] = '"';
-               break;
-               
-            default:
-               return JSON_INVALID_KEY;
-         }
-      }
-      else{
-         temp[tempIndex++] = message[parser->index];
-      }
-      
-      parser->index++;
-   }
-   
-   if (parser->index >= size){
-      PUSH_ERROR(parser, JSON_MESSAGE_INCOMPLETE, -1);
-      json_errno = JSON_MESSAGE_INCOMPLETE;
-      return JSON_MESSAGE_INCOMPLETE;
-   }
-   
-   temp[tempIndex] = '\0';
-   int tempSize = strlen(temp);
-   //Create a string in the free store memory to hold the key
-   char* key = (char*)calloc((tempSize + 1), sizeof(char));
-   if (!key){
-      PUSH_ERROR(parser, JSON_MALLOC_FAIL, errno);
-      json_errno = JSON_MALLOC_FAIL;
-      return JSON_MALLOC_FAIL;
-   }
-   
-   //Copy the key and push it onto the stack
-   strcpy(key, temp);
-   if (parser->keyStackIndex < KEY_STACK_SIZE) { 
-      parser->keyStack[parser->keyStackIndex++] = key;
-   }
-   else {
-      return JSON_MESSAGE_TOO_LARGE;
+static void countLines(JSONParser_t* parser, const char* message){
+   if (!message || parser->index <= parser->lineIndex){
+      return;
    }
-   
-   return JSON_SUCCESS;
+
+   parser->lineNumber += countNewLines(message, parser->lineIndex, parser->index);
+   parser->lineIndex = parser->index;
 }
 
 /**
@@ -1175,14 +2645,16 @@ static void pushError(JSONParser_t* parser, JSONError_t error, const char* curre
   if (!parser){
      return;
   }
+
+  countLines(parser, parser->message);
   
   if (errNo > 0){
-     sprintf(parser->tracebackString, "%s:%s():%d %s (%s) [state = 0x%x, lineNum = %d, index = %d]", 
+     sprintf(parser->tracebackString, "%s:%s():%d %s (%s) [state = 0x%x, lineNum = %d, index = %zu]", 
              currentFile, currentFunction, line, json_strerror(error), strerror(errNo), 
              parser->state, parser->lineNumber, parser->index);
   }
   else {
-     sprintf(parser->tracebackString, "%s:%s():%d %s [state = 0x%x, lineNum = %d, index = %d]", 
+     sprintf(parser->tracebackString, "%s:%s():%d %s [state = 0x%x, lineNum = %d, index = %zu]", 
              currentFile, currentFunction, line, json_strerror(error), parser->state, 
              parser->lineNumber, parser->index);
   }
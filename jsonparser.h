@@ -3,6 +3,10 @@
 
 #include "jsoncommon.h"
 #include "jsonerror.h"
+#include "jsonmemory.h"
+#include "jsonkeys.h"
+#include "jsonprojection.h"
+#include "jsonthreads.h"
 
 #define PUSH_ERROR(parser, error, errNo) (pushError(parser, error, __func__, __FILE__, __LINE__, errNo))
 
@@ -10,6 +14,7 @@
 #define CLEAR_ITEM               0xFFFFFF00
 #define CLEAR_CHARACTER          0xFFFF00FF
 #define MAX_DEPTH                256
+#define FRAME_STACK_SIZE         16
 #define TRACE_LENGTH             512
 
 /**
@@ -39,23 +44,94 @@ typedef enum {
    
 } ParserState_t;
 
+/**
+ * Options that change how the parser builds documents. They can be
+ * combined with OR's and are set with setJSONParserOptions().
+ */
+typedef enum {
+   PARSE_DEFAULT =        0x00000000, /**< Every pair, key, and string is allocated on its own */
+   PARSE_ARENA =          0x00000001, /**< Each document is built in its own arena (see jsonmemory.h) */
+   PARSE_IN_SITU =        0x00000002, /**< Keys and strings point into the message, which the parser writes to (see parseJSONBufferInSitu) */
+   PARSE_INTERN_KEYS =    0x00000004, /**< Each distinct key is only stored once (see jsonkeys.h) */
+   PARSE_DECODE_STRINGS = 0x00000008, /**< Strings are stored as UTF-8 text with their escape sequences expanded */
+   PARSE_STRICT_UTF8 =    0x00000010  /**< Keys and strings that are not well formed UTF-8 are rejected with JSON_INVALID_UTF8 */
+} JSONParseOptions_t;
+
+/**
+ * One open object or array in the message being parsed. The parser keeps
+ * a stack of these instead of recursing, so it can stop at the end of a
+ * chunk and pick up where it left off when the next chunk arrives. The
+ * stack lives on the heap and grows as deeper messages come in, up to the
+ * parsers maximum depth (see setJSONParserMaxDepth).
+ */
+typedef struct {
+   JSONType_t type;        /**< OBJECT or ARRAY */
+   JSONKeyValue_t* pair;   /**< The object or array being filled in */
+   JSONKeyValue_t* tail;   /**< The last value added, new values are linked after it */
+   const JSONProjectionStep_t* step; /**< Where this is in the parsers projection, NULL if all of it is kept */
+} JSONParserFrame_t;
+
+/**
+ * The callbacks used to parse a message without building a document. Each
+ * one is given the context pointer, and returns true to keep parsing or
+ * false to stop. Any callback that is NULL is simply skipped. The key and
+ * string pointers point into the message (or the parsers token buffer) and
+ * are not null terminated, they are only good until the callback returns.
+ */
+typedef struct {
+   void* context;                                                    /**< Passed to every callback */
+   bool (*startObject)(void* context);                               /**< A '{' was found */
+   bool (*endObject)(void* context);                                 /**< A '}' was found */
+   bool (*startArray)(void* context);                                /**< A '[' was found */
+   bool (*endArray)(void* context);                                  /**< A ']' was found */
+   bool (*key)(void* context, const char* key, size_t length);       /**< The key of the next value in an object */
+   bool (*string)(void* context, const char* value, size_t length);  /**< A string value (still escaped) */
+   bool (*number)(void* context, double value);                      /**< A number value */
+   bool (*boolean)(void* context, bool value);                       /**< A true or false value */
+   bool (*null)(void* context);                                      /**< A null value */
+} JSONCallbacks_t;
+
 /**
  * The JSON Parser object is used to keep track of the document parsing process.
- * The parser maintains state information, and a key stack to maintain 
- * key value alignment. 
+ * The parser maintains state information, and the key waiting for its value
+ * to maintain key value alignment. 
  */
 typedef struct {
    int depth;     /**< Keeps track of how many brackets have been found */
-   int index;     /**< The current position in the message string */
+   size_t index;  /**< The current position in the message string */
    int lineNumber;            /**< The current line number of the document being parsed */ 
-   char* keyStack[KEY_STACK_SIZE];  /**< the key names in the key:value pairs */
-   int keyStackIndex;         /**< where we are in the key stack */
+   size_t lineIndex;          /**< How far into the message the lines have been counted */
+   const char* message;       /**< The message (or chunk) currently being parsed */
+   char* pendingKey;          /**< The key of the value that comes next in an object, if there is one */
+   int keyFlags;              /**< PAIR_KEY_BORROWED or PAIR_KEY_INTERNED if the pending key is not owned by its pair */
+   size_t pendingKeyLength;   /**< The length of a key held back for the key callback */
+   JSONKeyTable_t* keyTable;  /**< Where keys are interned, if they are */
+   bool ownsKeyTable;         /**< true if the parser created the key table */
+   JSONKeyValue_t* document;  /**< The root of the document being built */
+   JSONParserFrame_t* frames; /**< The objects and arrays that are still open */
+   int frameCapacity;         /**< How many frames fit in the frame stack before it has to grow */
+   int maxDepth;              /**< How deep a message can nest before it is rejected */
+   const JSONProjection_t* projection; /**< The key paths to build, NULL to build everything */
+   const JSONProjectionStep_t* pendingStep; /**< Where the pending key leads in the projection */
+   int skipDepth;             /**< How many brackets deep the parser is in a value it is skipping */
+   JSONThreadPool_t* pool;    /**< The threads large arrays are parsed with, NULL to parse everything here */
+   
+   char* token;               /**< Holds a value that was cut off by the end of a chunk */
+   size_t tokenLength;        /**< How much of the value is being held */
+   size_t tokenSize;          /**< The size of the token buffer */
+   int tokenType;             /**< What kind of value is being held, if any */
+   int commentState;          /**< Where we are in a comment between messages */
+   const JSONCallbacks_t* callbacks; /**< If set, events are sent here instead of building a document */
+   int options;               /**< How documents are built (see JSONParseOptions_t) */
+   JSONArena_t* arena;        /**< The arena for the next document when parsing with PARSE_ARENA */
+   JSONKeyValue_t* sparePairs; /**< Pairs from recycled documents, linked by next, used before malloc is */
+   JSONValue_t* spareValues;  /**< Values from recycled documents, linked by oVal, used before malloc is */
    
    ParserState_t state;       /**< What are we looking for in the message */
    
    //Some basic statistics
    int messagesParsed;        /**< How many messages have been parsed with this parser */
-   int incompleteMessages;    /**< How many incomplete messages were resumed */
+   int incompleteMessages;    /**< How many times a message ran out before it was complete */
    
    //Some debugging info
    char tracebackString[TRACE_LENGTH]; /**< Holds a plain text description of the problem, and where it occurred */
@@ -63,6 +139,19 @@ typedef struct {
    int outsideError;          /**< the errno.h errno value if there is one, -1 otherwise */
 } JSONParser_t;
 
+/**
+ * The document iterator walks a buffer that holds one or more JSON messages
+ * back to back. Each call to nextJSONDocument() parses the next message and
+ * steps past it, so the buffer is only ever scanned once. 
+ */
+typedef struct {
+   JSONParser_t* parser;   /**< The parser used for each message */
+   const char* message;    /**< The start of the buffer being walked */
+   size_t length;          /**< The total number of bytes in the buffer */
+   size_t offset;          /**< Where the next message begins */
+   bool inSitu;            /**< true if the buffer can be written to (see initJSONDocumentIteratorInSitu) */
+} JSONDocumentIterator_t;
+
 /*------------------------------------------------------------------
  * Define global functions
  *----------------------------------------------------------------*/
@@ -75,6 +164,22 @@ JSONParser_t* newJSONParser();
 JSONError_t initJSONParser(JSONParser_t* parser);
 void resetParser(JSONParser_t* parser);
 JSONError_t parseJSONMessage(JSONParser_t* parser, JSONKeyValue_t** document, const char* message, int* lastIndex);
+JSONError_t parseJSONBuffer(JSONParser_t* parser, JSONKeyValue_t** document, const char* message, size_t length, size_t* consumed);
+JSONError_t parseJSONBufferInSitu(JSONParser_t* parser, JSONKeyValue_t** document, char* message, size_t length, size_t* consumed);
+JSONError_t feedJSONParser(JSONParser_t* parser, JSONKeyValue_t** document, const char* chunk, size_t length, size_t* consumed);
+JSONError_t feedJSONParserInSitu(JSONParser_t* parser, JSONKeyValue_t** document, char* chunk, size_t length, size_t* consumed);
+JSONError_t parseJSONEvents(JSONParser_t* parser, const JSONCallbacks_t* callbacks, const char* message, size_t length, size_t* consumed);
+JSONError_t setJSONParserCallbacks(JSONParser_t* parser, const JSONCallbacks_t* callbacks);
+JSONError_t setJSONParserOptions(JSONParser_t* parser, int options);
+JSONError_t setJSONParserKeyTable(JSONParser_t* parser, JSONKeyTable_t* table);
+JSONError_t setJSONParserMaxDepth(JSONParser_t* parser, int maxDepth);
+JSONError_t setJSONParserProjection(JSONParser_t* parser, const JSONProjection_t* projection);
+JSONError_t setJSONParserThreadPool(JSONParser_t* parser, JSONThreadPool_t* pool);
+void recycleJSONDocument(JSONParser_t* parser, JSONKeyValue_t* document);
+JSONError_t initJSONDocumentIterator(JSONDocumentIterator_t* iterator, JSONParser_t* parser, const char* message, size_t length);
+JSONError_t initJSONDocumentIteratorInSitu(JSONDocumentIterator_t* iterator, JSONParser_t* parser, char* message, size_t length);
+bool hasNextJSONDocument(JSONDocumentIterator_t* iterator);
+JSONError_t nextJSONDocument(JSONDocumentIterator_t* iterator, JSONKeyValue_t** document);
 void disposeOfJSONParser(JSONParser_t* parser);
 
 #ifdef __cplusplus
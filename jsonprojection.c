@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jsontools.h"
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static JSONError_t walkPath(JSONProjection_t* projection, const char* path, bool add);
+static JSONProjectionStep_t* addStep(JSONProjection_t* projection, JSONProjectionStep_t* parent, const char* key, size_t length);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Creates a new, empty projection. A parser using an empty projection
+ * only builds the root object or array, everything in it is skipped.
+ *
+ * @return The new projection, or NULL if memory could not be allocated
+ */
+JSONProjection_t* newJSONProjection(){
+   JSONProjection_t* projection = (JSONProjection_t*)malloc(sizeof(JSONProjection_t));
+   if (!projection){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   memset(projection, 0, sizeof(JSONProjection_t));
+   projection->storage = newJSONArena(0);
+   if (!projection->storage){
+      free(projection);
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   return projection;
+}
+
+/**
+ * Adds a key path to a projection. A path is a list of keys separated by
+ * '.', and "[*]" stands for every element of an array, so "items[*].sku"
+ * keeps the sku of every item. A path can start with "[*]" when the
+ * message is an array. Keys that hold '.' or '[' can not be used in a
+ * path. Once a path ends on a value, everything under that value is kept.
+ *
+ * @param projection - The projection the path is added to
+ * @param path - The key path, it has to be null terminated
+ * @return JSON_SUCCESS, JSON_NULL_ARGUMENT, JSON_INVALID_ARGUMENT if the
+ *    path is not written correctly, or JSON_MALLOC_FAIL
+ */
+JSONError_t addJSONProjectionPath(JSONProjection_t* projection, const char* path){
+   if (!projection || !path){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   //Check the whole path first, so a bad path does not leave half of
+   //itself in the projection
+   JSONError_t returnStatus = walkPath(projection, path, false);
+   if (!returnStatus){
+      returnStatus = walkPath(projection, path, true);
+   }
+
+   if (returnStatus){
+      json_errno = returnStatus;
+   }
+
+   return returnStatus;
+}
+
+/**
+ * Finds the step that follows another step for a key, or for the elements
+ * of an array.
+ *
+ * @param step - The step the key was found under
+ * @param key - The characters of the key, they do not need to be null
+ *    terminated. NULL finds the step for the elements of an array.
+ * @param length - The length of the key
+ * @return The step for the key, or NULL if no path goes that way
+ */
+const JSONProjectionStep_t* findJSONProjectionStep(const JSONProjectionStep_t* step, const char* key, size_t length){
+   if (!step){
+      return NULL;
+   }
+
+   for (const JSONProjectionStep_t* child = step->children; child; child = child->next){
+      if (!key){
+         if (!child->key){
+            return child;
+         }
+      }
+      else if (child->key && child->length == length && memcmp(child->key, key, length) == 0){
+         return child;
+      }
+   }
+
+   return NULL;
+}
+
+/**
+ * Frees the projection and all of its paths. It can not be used by a
+ * parser after this.
+ *
+ * @param projection - The projection that was created with newJSONProjection()
+ */
+void disposeOfJSONProjection(JSONProjection_t* projection){
+   if (!projection){
+      return;
+   }
+
+   disposeOfJSONArena(projection->storage);
+   free(projection);
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Walks a key path one step at a time, either just checking that it is
+ * written correctly, or adding its steps to the projection.
+ *
+ * @param projection - The projection the path is for
+ * @param path - The key path
+ * @param add - true to add the steps, false to only check the path
+ * @return JSON_SUCCESS, JSON_INVALID_ARGUMENT, or JSON_MALLOC_FAIL
+ */
+static JSONError_t walkPath(JSONProjection_t* projection, const char* path, bool add){
+   JSONProjectionStep_t* step = &projection->root;
+   bool afterDot = false;
+   size_t index = 0;
+
+   while (true){
+      const char* key = NULL;
+      size_t length = 0;
+
+      if (path[index] == '[' && !afterDot){
+         if (path[index + 1] != '*' || path[index + 2] != ']'){
+            return JSON_INVALID_ARGUMENT;
+         }
+         index += 3;
+
+         if (path[index] != '.' && path[index] != '[' && path[index] != '\0'){
+            //Nothing can be stuck onto the end of "[*]"
+            return JSON_INVALID_ARGUMENT;
+         }
+      }
+      else {
+         key = &path[index];
+         length = strcspn(key, ".[");
+         if (length == 0){
+            //Empty keys are not allowed, ("a..b", ".a", "a.", or "")
+            return JSON_INVALID_ARGUMENT;
+         }
+         index += length;
+      }
+
+      if (add){
+         step = addStep(projection, step, key, length);
+         if (!step){
+            return JSON_MALLOC_FAIL;
+         }
+      }
+
+      afterDot = (path[index] == '.');
+      if (afterDot){
+         index++;
+      }
+      else if (path[index] == '\0'){
+         break;
+      }
+   }
+
+   if (add){
+      step->keepAll = true;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Finds the step for a key under another step, adding it if this is the
+ * first path to go that way.
+ *
+ * @param projection - The projection the step belongs to
+ * @param parent - The step the new step follows
+ * @param key - The key, or NULL for the elements of an array
+ * @param length - The length of the key
+ * @return The step, or NULL if memory could not be allocated
+ */
+static JSONProjectionStep_t* addStep(JSONProjection_t* projection, JSONProjectionStep_t* parent, const char* key, size_t length){
+   JSONProjectionStep_t* step = (JSONProjectionStep_t*)findJSONProjectionStep(parent, key, length);
+   if (step){
+      return step;
+   }
+
+   step = (JSONProjectionStep_t*)allocateFromArena(projection->storage, sizeof(JSONProjectionStep_t));
+   if (!step){
+      return NULL;
+   }
+
+   memset(step, 0, sizeof(JSONProjectionStep_t));
+   if (key){
+      char* copy = (char*)allocateFromArena(projection->storage, length + 1);
+      if (!copy){
+         return NULL;
+      }
+
+      memcpy(copy, key, length);
+      copy[length] = '\0';
+      step->key = copy;
+      step->length = length;
+   }
+
+   step->next = parent->children;
+   parent->children = step;
+
+   return step;
+}
@@ -0,0 +1,52 @@
+#ifndef _JSON_PROJECTION_H
+#define _JSON_PROJECTION_H
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+#include "jsonmemory.h"
+
+/**
+ * One step of the key paths in a projection. The steps form a tree that
+ * starts at the root of the message, each step matches either a key in an
+ * object or every element of an array ([*]).
+ */
+typedef struct JSONProjectionStep_s {
+   const char* key;                       /**< The key this step matches, NULL for the elements of an array */
+   size_t length;                         /**< The length of the key */
+   bool keepAll;                          /**< A path ends here, so everything under this value is kept */
+   struct JSONProjectionStep_s* children; /**< The steps that can follow this one */
+   struct JSONProjectionStep_s* next;     /**< The next step that can follow the same parent */
+} JSONProjectionStep_t;
+
+/**
+ * A projection is a set of key paths like "user.id", "event.ts", and
+ * "items[*].sku". When a parser is given a projection (see
+ * setJSONParserProjection) it only builds the values found at the end of
+ * those paths, and the objects and arrays that lead to them. Everything
+ * else is stepped over without being allocated, unescaped, or converted,
+ * so the document is an ordinary document that is missing the parts that
+ * were not asked for.
+ */
+typedef struct {
+   JSONProjectionStep_t root; /**< The root of the message */
+   JSONArena_t* storage;      /**< Where the steps and their keys are kept */
+} JSONProjection_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONProjection_t* newJSONProjection();
+JSONError_t addJSONProjectionPath(JSONProjection_t* projection, const char* path);
+const JSONProjectionStep_t* findJSONProjectionStep(const JSONProjectionStep_t* step, const char* key, size_t length);
+void disposeOfJSONProjection(JSONProjection_t* projection);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
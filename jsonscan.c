@@ -0,0 +1,895 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_SCAN_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define JSON_SCAN_SWAR
+#endif
+
+//Helpers for testing 8 bytes at a time in a 64 bit word (SWAR)
+#define SWAR_ONES                0x0101010101010101ULL
+#define SWAR_HIGHS               0x8080808080808080ULL
+#define SWAR_BROADCAST(c)        (SWAR_ONES * (uint8_t)(c))
+#define SWAR_HAS_ZERO(v)         (((v) - SWAR_ONES) & ~(v) & SWAR_HIGHS)
+#define SWAR_HAS_LESS(v, n)      (((v) - SWAR_BROADCAST(n)) & ~(v) & SWAR_HIGHS)
+
+#include "jsonscan.h"
+
+/**
+ * The bit masks for one block of the message. Bit n of each mask
+ * describes byte n of the block.
+ */
+typedef struct {
+   uint64_t quote;      /**< '"' characters, escaped or not */
+   uint64_t backslash;  /**< '\' characters */
+   uint64_t operators;  /**< '{' '}' '[' ']' ':' and ',' characters */
+   uint64_t space;      /**< White space characters (the same ones as isspace()) */
+   uint64_t nonASCII;   /**< Bytes with the high bit set, parts of multibyte UTF-8 sequences */
+} JSONBlockMasks_t;
+
+typedef void (*ClassifyFunction_t)(const char* block, JSONBlockMasks_t* masks);
+typedef bool (*UTF8Function_t)(const char* message, size_t length);
+
+//The ways a pair of bytes can break UTF-8, the vector checks look up
+//which of these each byte allows and report the pairs where all three
+//lookups agree (see checkUTF8SSSE3)
+#define UTF8_TOO_SHORT           0x01  //A lead byte not followed by a continuation byte
+#define UTF8_TOO_LONG            0x02  //ASCII followed by a continuation byte
+#define UTF8_OVERLONG_3          0x04  //E0 followed by 80 to 9F
+#define UTF8_TOO_LARGE           0x08  //F4 followed by 90 or more, or F5 and up
+#define UTF8_SURROGATE           0x10  //ED followed by A0 to BF
+#define UTF8_OVERLONG_2          0x20  //C0 or C1
+#define UTF8_TOO_LARGE_1000      0x40  //F5 and up followed by 80 to 8F
+#define UTF8_OVERLONG_4          0x40  //F0 followed by 80 to 8F
+#define UTF8_TWO_CONTINUATIONS   0x80  //Two continuation bytes, unless a 3 or 4 byte lead came before them
+#define UTF8_CARRY               (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTINUATIONS)
+
+/**
+ * The errors each high nibble of the first byte of a pair can start
+ */
+static const uint8_t utf8FirstHigh[16] = {
+   UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+   UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+   UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS,
+   UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+   UTF8_TOO_SHORT,
+   UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+   UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+/**
+ * The errors each low nibble of the first byte of a pair can start
+ */
+static const uint8_t utf8FirstLow[16] = {
+   UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+   UTF8_CARRY | UTF8_OVERLONG_2,
+   UTF8_CARRY,
+   UTF8_CARRY,
+   UTF8_CARRY | UTF8_TOO_LARGE,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+   UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+/**
+ * The errors each high nibble of the second byte of a pair finishes
+ */
+static const uint8_t utf8SecondHigh[16] = {
+   UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+   UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+   UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+   UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+   UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+   UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+   UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+/**
+ * The traits of the characters that the parser and the validator look at
+ * one at a time. These do not change with the locale the way the ctype.h
+ * functions do.
+ */
+const unsigned char characterTraits[256] = {
+   [' '] = TRAIT_DELIMITER, ['\t'] = TRAIT_DELIMITER, ['\n'] = TRAIT_DELIMITER, ['\v'] = TRAIT_DELIMITER,
+   ['\f'] = TRAIT_DELIMITER, ['\r'] = TRAIT_DELIMITER, ['{'] = TRAIT_DELIMITER, ['}'] = TRAIT_DELIMITER,
+   ['['] = TRAIT_DELIMITER, [']'] = TRAIT_DELIMITER, [':'] = TRAIT_DELIMITER, [','] = TRAIT_DELIMITER,
+   ['"'] = TRAIT_DELIMITER,
+   ['+'] = TRAIT_NUMBER, ['-'] = TRAIT_NUMBER, ['.'] = TRAIT_NUMBER, ['0'] = TRAIT_NUMBER | TRAIT_HEX,
+   ['1'] = TRAIT_NUMBER | TRAIT_HEX, ['2'] = TRAIT_NUMBER | TRAIT_HEX, ['3'] = TRAIT_NUMBER | TRAIT_HEX, ['4'] = TRAIT_NUMBER | TRAIT_HEX,
+   ['5'] = TRAIT_NUMBER | TRAIT_HEX, ['6'] = TRAIT_NUMBER | TRAIT_HEX, ['7'] = TRAIT_NUMBER | TRAIT_HEX, ['8'] = TRAIT_NUMBER | TRAIT_HEX,
+   ['9'] = TRAIT_NUMBER | TRAIT_HEX,
+   ['A'] = TRAIT_LETTER | TRAIT_HEX, ['B'] = TRAIT_LETTER | TRAIT_HEX, ['C'] = TRAIT_LETTER | TRAIT_HEX, ['D'] = TRAIT_LETTER | TRAIT_HEX,
+   ['E'] = TRAIT_NUMBER | TRAIT_LETTER | TRAIT_HEX, ['F'] = TRAIT_LETTER | TRAIT_HEX, ['G'] = TRAIT_LETTER, ['H'] = TRAIT_LETTER,
+   ['I'] = TRAIT_LETTER, ['J'] = TRAIT_LETTER, ['K'] = TRAIT_LETTER, ['L'] = TRAIT_LETTER,
+   ['M'] = TRAIT_LETTER, ['N'] = TRAIT_LETTER, ['O'] = TRAIT_LETTER, ['P'] = TRAIT_LETTER,
+   ['Q'] = TRAIT_LETTER, ['R'] = TRAIT_LETTER, ['S'] = TRAIT_LETTER, ['T'] = TRAIT_LETTER,
+   ['U'] = TRAIT_LETTER, ['V'] = TRAIT_LETTER, ['W'] = TRAIT_LETTER, ['X'] = TRAIT_LETTER,
+   ['Y'] = TRAIT_LETTER, ['Z'] = TRAIT_LETTER,
+   ['a'] = TRAIT_LETTER | TRAIT_HEX, ['b'] = TRAIT_LETTER | TRAIT_HEX, ['c'] = TRAIT_LETTER | TRAIT_HEX, ['d'] = TRAIT_LETTER | TRAIT_HEX,
+   ['e'] = TRAIT_NUMBER | TRAIT_LETTER | TRAIT_HEX, ['f'] = TRAIT_LETTER | TRAIT_HEX, ['g'] = TRAIT_LETTER, ['h'] = TRAIT_LETTER,
+   ['i'] = TRAIT_LETTER, ['j'] = TRAIT_LETTER, ['k'] = TRAIT_LETTER, ['l'] = TRAIT_LETTER,
+   ['m'] = TRAIT_LETTER, ['n'] = TRAIT_LETTER, ['o'] = TRAIT_LETTER, ['p'] = TRAIT_LETTER,
+   ['q'] = TRAIT_LETTER, ['r'] = TRAIT_LETTER, ['s'] = TRAIT_LETTER, ['t'] = TRAIT_LETTER,
+   ['u'] = TRAIT_LETTER, ['v'] = TRAIT_LETTER, ['w'] = TRAIT_LETTER, ['x'] = TRAIT_LETTER,
+   ['y'] = TRAIT_LETTER, ['z'] = TRAIT_LETTER
+};
+
+/*----------------------------------------------------------------
+ * Define private helper functions
+ *---------------------------------------------------------------*/
+
+static void scanBlock(JSONScanner_t* scanner);
+static uint64_t findEscaped(uint64_t backslash, uint64_t* escaped);
+static uint64_t prefixXor(uint64_t bits);
+static void chooseClassifier(void);
+static void classifyBlock(const char* block, JSONBlockMasks_t* masks);
+static size_t skipASCII(const char* message, size_t index, size_t size);
+static size_t locateInvalidUTF8(const char* message, size_t index, size_t size);
+static bool checkUTF8(const char* message, size_t length);
+#ifdef JSON_SCAN_X86
+static void classifyBlockSSE2(const char* block, JSONBlockMasks_t* masks);
+static void classifyBlockAVX2(const char* block, JSONBlockMasks_t* masks);
+static bool checkUTF8SSSE3(const char* message, size_t length);
+static bool checkUTF8AVX2(const char* message, size_t length);
+#endif
+
+static ClassifyFunction_t classifier = NULL;
+static UTF8Function_t utf8Checker = NULL;
+static pthread_once_t classifierChosen = PTHREAD_ONCE_INIT;
+
+/*----------------------------------------------------------------
+ * Implement global functions
+ *--------------------------------------------------------------*/
+
+/**
+ * Prepares a scanner to index a message. The start of the message must
+ * not be inside of a string.
+ *
+ * @param scanner - The scanner to initialize
+ * @param message - The message to scan
+ * @param start - Where in the message to start scanning
+ * @param size - The length of the message
+ */
+void initJSONScanner(JSONScanner_t* scanner, const char* message, size_t start, size_t size){
+   pthread_once(&classifierChosen, chooseClassifier);
+
+   memset(scanner, 0, sizeof(JSONScanner_t));
+   scanner->message = message;
+   scanner->size = size;
+   scanner->scanned = start;
+   scanner->base = start;
+}
+
+/**
+ * Finds the position of the next byte in the index. New blocks are
+ * scanned as they are needed, so nothing past the block holding the
+ * returned position has been looked at yet.
+ *
+ * @param scanner - The scanner walking the message
+ * @param position - The position of the next byte in the index
+ * @return true if a position was found, false if the message ran out
+ */
+bool nextStructural(JSONScanner_t* scanner, size_t* position){
+   while (!scanner->index){
+      if (scanner->scanned >= scanner->size){
+         return false;
+      }
+
+      scanBlock(scanner);
+   }
+
+   *position = scanner->base + __builtin_ctzll(scanner->index);
+
+   //Clear the lowest bit
+   scanner->index &= (scanner->index - 1);
+   return true;
+}
+
+/**
+ * Copies positions out of the index in bulk. This is the same as calling
+ * nextStructural() over and over, but each block is emptied in one tight
+ * loop, which is what an index of the whole message wants. Blocks are only
+ * scanned while there is room for a whole block of positions.
+ *
+ * @param scanner - The scanner walking the message
+ * @param positions - Where the positions are written
+ * @param room - How many positions fit
+ * @return The number of positions written, 0 once the message runs out
+ *    (or if there is no room for a whole block)
+ */
+size_t nextStructurals(JSONScanner_t* scanner, uint32_t* positions, size_t room){
+   size_t count = 0;
+
+   while (room - count >= SCAN_BLOCK_SIZE){
+      if (!scanner->index){
+         if (scanner->scanned >= scanner->size){
+            break;
+         }
+
+         scanBlock(scanner);
+      }
+
+      uint64_t index = scanner->index;
+      uint32_t base = (uint32_t)scanner->base;
+      while (index){
+         positions[count++] = base + __builtin_ctzll(index);
+         index &= (index - 1);
+      }
+
+      scanner->index = 0;
+   }
+
+   return count;
+}
+
+/**
+ * Counts the new line characters in part of a message. The parser only
+ * needs the line number when something goes wrong, so rather than watching
+ * every byte for them, they are counted here after the fact.
+ *
+ * @param message - The message
+ * @param start - The first byte to look at
+ * @param end - One past the last byte to look at
+ * @return The number of '\n' characters found
+ */
+size_t countNewLines(const char* message, size_t start, size_t end){
+   size_t lines = 0;
+
+   while (start < end){
+      const char* found = (const char*)memchr(&message[start], '\n', end - start);
+      if (!found){
+         break;
+      }
+
+      lines++;
+      start = (found - message) + 1;
+   }
+
+   return lines;
+}
+
+/**
+ * Finds the next quote or backslash in a string. The bytes in between
+ * are plain characters that need no attention. This looks at 16 bytes
+ * at a time with SSE2, or 8 at a time in a 64 bit word otherwise.
+ *
+ * @param message - The message
+ * @param index - Where to start looking
+ * @param size - The length of the message
+ * @return The index of the quote or backslash, or size if there is none
+ */
+size_t findQuoteOrEscape(const char* message, size_t index, size_t size){
+#if defined(JSON_SCAN_X86) && defined(__SSE2__)
+   const __m128i quote = _mm_set1_epi8('"');
+   const __m128i backslash = _mm_set1_epi8('\\');
+
+   while (index + 16 <= size){
+      __m128i chunk = _mm_loadu_si128((const __m128i*)&message[index]);
+      int found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                 _mm_cmpeq_epi8(chunk, backslash)));
+      if (found){
+         return index + __builtin_ctz(found);
+      }
+
+      index += 16;
+   }
+#endif
+
+#ifdef JSON_SCAN_SWAR
+   while (index + 8 <= size){
+      uint64_t word;
+      memcpy(&word, &message[index], sizeof(word));
+
+      uint64_t found = SWAR_HAS_ZERO(word ^ SWAR_BROADCAST('"')) |
+                       SWAR_HAS_ZERO(word ^ SWAR_BROADCAST('\\'));
+      if (found){
+         return index + (__builtin_ctzll(found) >> 3);
+      }
+
+      index += 8;
+   }
+#endif
+
+   while (index < size && message[index] != '"' && message[index] != '\\'){
+      index++;
+   }
+
+   return index;
+}
+
+/**
+ * Finds the next backslash or control character (anything below ' ') in
+ * a string. These are the only bytes in a string that the parser has to
+ * do anything with, everything between them can be copied in bulk. This 
+ * looks at 16 bytes at a time with SSE2, or 8 at a time in a 64 bit word
+ * otherwise.
+ *
+ * @param message - The string
+ * @param index - Where to start looking
+ * @param size - The length of the string
+ * @return The index of the backslash or control character, or size if there is none
+ */
+size_t findEscapeOrControl(const char* message, size_t index, size_t size){
+#if defined(JSON_SCAN_X86) && defined(__SSE2__)
+   const __m128i backslash = _mm_set1_epi8('\\');
+   const __m128i lastControl = _mm_set1_epi8(0x1f);
+
+   while (index + 16 <= size){
+      __m128i chunk = _mm_loadu_si128((const __m128i*)&message[index]);
+
+      //Unsigned compare for chunk <= 0x1f
+      __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, lastControl), chunk);
+      int found = _mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(chunk, backslash)));
+      if (found){
+         return index + __builtin_ctz(found);
+      }
+
+      index += 16;
+   }
+#endif
+
+#ifdef JSON_SCAN_SWAR
+   while (index + 8 <= size){
+      uint64_t word;
+      memcpy(&word, &message[index], sizeof(word));
+
+      uint64_t found = SWAR_HAS_LESS(word, ' ') |
+                       SWAR_HAS_ZERO(word ^ SWAR_BROADCAST('\\'));
+      if (found){
+         return index + (__builtin_ctzll(found) >> 3);
+      }
+
+      index += 8;
+   }
+#endif
+
+   while (index < size && message[index] != '\\' && (unsigned char)message[index] >= ' '){
+      index++;
+   }
+
+   return index;
+}
+
+/**
+ * Finds the first byte that is not part of a well formed UTF-8 sequence.
+ * Overlong forms, surrogates (U+D800 to U+DFFF), and anything past U+10FFFF
+ * are not well formed, and neither is a sequence cut off by the end. The
+ * range is checked with the vector instructions the CPU has first, and only
+ * a range that is not well formed is walked a sequence at a time to find
+ * where it goes wrong.
+ *
+ * @param message - The characters to check
+ * @param index - Where to start looking
+ * @param size - Where to stop looking
+ * @return The index of the sequence that is not well formed, or size if there is none
+ */
+size_t findInvalidUTF8(const char* message, size_t index, size_t size){
+   //Most keys and strings are all ASCII, so they never get to the vectors.
+   //Otherwise the check starts on a lead byte, since ASCII came before it
+   index = skipASCII(message, index, size);
+   if (index >= size){
+      return size;
+   }
+
+   pthread_once(&classifierChosen, chooseClassifier);
+   if (utf8Checker(&message[index], size - index)){
+      return size;
+   }
+
+   return locateInvalidUTF8(message, index, size);
+}
+
+/*-----------------------------------------------------------------
+ * Implement private helper functions
+ *----------------------------------------------------------------*/
+
+/**
+ * Builds the index for the next 64 bytes of the message. The last block
+ * of the message is copied into a buffer padded with spaces so nothing
+ * past the end of the message is read.
+ *
+ * @param scanner - The scanner walking the message
+ */
+static void scanBlock(JSONScanner_t* scanner){
+   const char* block = &scanner->message[scanner->scanned];
+   size_t remaining = scanner->size - scanner->scanned;
+   char padded[SCAN_BLOCK_SIZE];
+   JSONBlockMasks_t masks;
+
+   if (remaining < SCAN_BLOCK_SIZE){
+      memset(padded, ' ', SCAN_BLOCK_SIZE);
+      memcpy(padded, block, remaining);
+      block = padded;
+   }
+
+   classifier(block, &masks);
+
+   //Quotes that have been escaped do not start or end a string
+   uint64_t escaped = findEscaped(masks.backslash, &scanner->escaped);
+   uint64_t quotes = masks.quote & ~escaped;
+
+   //Everything from an opening quote up to (but not including) its closing
+   //quote is inside of the string
+   uint64_t inString = prefixXor(quotes) ^ scanner->inString;
+   scanner->inString = (uint64_t)((int64_t)inString >> 63);
+
+   //Anything else outside of a string is part of a number or a literal,
+   //only the first byte of each one goes into the index
+   uint64_t scalar = ~(masks.operators | masks.space | quotes | inString);
+   uint64_t scalarStarts = scalar & ~((scalar << 1) | scanner->scalar);
+   scanner->scalar = scalar >> 63;
+
+   scanner->index = (masks.operators & ~inString) | quotes | scalarStarts;
+   if (masks.nonASCII){
+      //Strings that start after this are all ASCII, so they are well formed UTF-8
+      scanner->nonASCIIEnd = scanner->scanned + SCAN_BLOCK_SIZE - __builtin_clzll(masks.nonASCII);
+   }
+   scanner->base = scanner->scanned;
+   scanner->scanned += (remaining < SCAN_BLOCK_SIZE) ? remaining : SCAN_BLOCK_SIZE;
+}
+
+/**
+ * Finds the characters in a block that have been escaped by a backslash.
+ * A run of backslashes escapes the next character only when the run has
+ * an odd length, which is worked out for the whole block at once by
+ * splitting the runs into those starting on even and odd bits.
+ *
+ * @param backslash - The backslash characters in the block
+ * @param escaped - 1 if the first character of this block is escaped,
+ *    updated for the next block
+ * @return The characters in the block that are escaped
+ */
+static uint64_t findEscaped(uint64_t backslash, uint64_t* escaped){
+   const uint64_t evenBits = 0x5555555555555555ULL;
+
+   //If the first character is escaped it can not start a new escape
+   backslash &= ~(*escaped);
+   uint64_t followsEscape = (backslash << 1) | *escaped;
+
+   uint64_t oddStarts = backslash & ~evenBits & ~followsEscape;
+   uint64_t evenStarts;
+   *escaped = __builtin_add_overflow(oddStarts, backslash, &evenStarts);
+
+   uint64_t invertMask = evenStarts << 1;
+   return (evenBits ^ invertMask) & followsEscape;
+}
+
+/**
+ * Computes the running xor of the bits from the lowest bit up. Each bit
+ * of the result is set if an odd number of bits at or below it are set.
+ *
+ * @param bits - The bits to run over
+ * @return The prefix xor of the bits
+ */
+static uint64_t prefixXor(uint64_t bits){
+   bits ^= bits << 1;
+   bits ^= bits << 2;
+   bits ^= bits << 4;
+   bits ^= bits << 8;
+   bits ^= bits << 16;
+   bits ^= bits << 32;
+   return bits;
+}
+
+/**
+ * Picks the fastest way to classify a block, and to check UTF-8, that this
+ * CPU supports. This is only run once, by the first thread to start a
+ * scanner or check a string.
+ */
+static void chooseClassifier(void){
+   classifier = classifyBlock;
+   utf8Checker = checkUTF8;
+
+#ifdef JSON_SCAN_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")){
+      classifier = classifyBlockAVX2;
+      utf8Checker = checkUTF8AVX2;
+      return;
+   }
+
+   if (__builtin_cpu_supports("ssse3")){
+      utf8Checker = checkUTF8SSSE3;
+   }
+
+   if (__builtin_cpu_supports("sse2")){
+      classifier = classifyBlockSSE2;
+   }
+#endif
+}
+
+/**
+ * Classifies each byte in a block one at a time. This is used when the
+ * CPU has no vector instructions that we know how to use.
+ *
+ * @param block - The 64 bytes to classify
+ * @param masks - The masks for the block
+ */
+static void classifyBlock(const char* block, JSONBlockMasks_t* masks){
+   memset(masks, 0, sizeof(JSONBlockMasks_t));
+
+   for (int i = 0; i < SCAN_BLOCK_SIZE; i++){
+      uint64_t bit = 1ULL << i;
+
+      switch (block[i]){
+         case '"' :
+            masks->quote |= bit;
+            break;
+
+         case '\\' :
+            masks->backslash |= bit;
+            break;
+
+         case '{' : case '}' : case '[' : case ']' : case ':' : case ',' :
+            masks->operators |= bit;
+            break;
+
+         case ' ' : case '\t' : case '\n' : case '\v' : case '\f' : case '\r' :
+            masks->space |= bit;
+            break;
+
+         default :
+            if ((unsigned char)block[i] >= 0x80){
+               masks->nonASCII |= bit;
+            }
+            break;
+      }
+   }
+}
+
+/**
+ * Steps over a run of ASCII, 16 bytes at a time with SSE2, or 8 at a time
+ * in a 64 bit word otherwise.
+ *
+ * @param message - The characters to look at
+ * @param index - Where to start looking
+ * @param size - Where to stop looking
+ * @return The index of the first byte that is not ASCII, or size if there is none
+ */
+static size_t skipASCII(const char* message, size_t index, size_t size){
+#if defined(JSON_SCAN_X86) && defined(__SSE2__)
+   while (index + 16 <= size){
+      int found = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)&message[index]));
+      if (found){
+         return index + __builtin_ctz(found);
+      }
+
+      index += 16;
+   }
+#endif
+
+#ifdef JSON_SCAN_SWAR
+   while (index + 8 <= size){
+      uint64_t word;
+      memcpy(&word, &message[index], sizeof(word));
+
+      uint64_t found = word & SWAR_HIGHS;
+      if (found){
+         return index + (__builtin_ctzll(found) >> 3);
+      }
+
+      index += 8;
+   }
+#endif
+
+   while (index < size && (unsigned char)message[index] < 0x80){
+      index++;
+   }
+
+   return index;
+}
+
+/**
+ * Finds the first byte that is not part of a well formed UTF-8 sequence,
+ * one sequence at a time.
+ *
+ * @param message - The characters to check
+ * @param index - Where to start looking
+ * @param size - Where to stop looking
+ * @return The index of the sequence that is not well formed, or size if there is none
+ */
+static size_t locateInvalidUTF8(const char* message, size_t index, size_t size){
+   const unsigned char* bytes = (const unsigned char*)message;
+
+   while (index < size){
+      index = skipASCII(message, index, size);
+      if (index >= size){
+         break;
+      }
+
+      //The lead byte says how many continuation bytes follow, and the
+      //first of them has a tighter range for a few lead bytes
+      unsigned char lead = bytes[index];
+      unsigned char low = 0x80;
+      unsigned char high = 0xBF;
+      size_t length;
+
+      if (lead >= 0xC2 && lead <= 0xDF){
+         length = 2;
+      }
+      else if (lead >= 0xE0 && lead <= 0xEF){
+         length = 3;
+         low = (lead == 0xE0) ? 0xA0 : 0x80;
+         high = (lead == 0xED) ? 0x9F : 0xBF;
+      }
+      else if (lead >= 0xF0 && lead <= 0xF4){
+         length = 4;
+         low = (lead == 0xF0) ? 0x90 : 0x80;
+         high = (lead == 0xF4) ? 0x8F : 0xBF;
+      }
+      else {
+         return index;
+      }
+
+      if (size - index < length || bytes[index + 1] < low || bytes[index + 1] > high){
+         return index;
+      }
+
+      for (size_t i = 2; i < length; i++){
+         if ((bytes[index + i] & 0xC0) != 0x80){
+            return index;
+         }
+      }
+
+      index += length;
+   }
+
+   return size;
+}
+
+/**
+ * Checks that a range is well formed UTF-8 without any vector instructions.
+ *
+ * @param message - The characters to check
+ * @param length - How many characters to check
+ * @return true if the whole range is well formed
+ */
+static bool checkUTF8(const char* message, size_t length){
+   return locateInvalidUTF8(message, 0, length) == length;
+}
+
+#ifdef JSON_SCAN_X86
+
+/**
+ * Classifies a block 16 bytes at a time with SSE2. White space is found
+ * with a range check for '\t' through '\r' plus a compare for ' ', and
+ * since '[' ']' only differ from '{' '}' by the 0x20 bit, brackets and
+ * braces need just two compares.
+ *
+ * @param block - The 64 bytes to classify
+ * @param masks - The masks for the block
+ */
+__attribute__((target("sse2")))
+static void classifyBlockSSE2(const char* block, JSONBlockMasks_t* masks){
+   const __m128i quote = _mm_set1_epi8('"');
+   const __m128i backslash = _mm_set1_epi8('\\');
+   const __m128i openBrace = _mm_set1_epi8('{');
+   const __m128i closeBrace = _mm_set1_epi8('}');
+   const __m128i colon = _mm_set1_epi8(':');
+   const __m128i comma = _mm_set1_epi8(',');
+   const __m128i space = _mm_set1_epi8(' ');
+   const __m128i tab = _mm_set1_epi8('\t');
+   const __m128i controlRange = _mm_set1_epi8('\r' - '\t');
+   const __m128i lowerCase = _mm_set1_epi8(0x20);
+
+   memset(masks, 0, sizeof(JSONBlockMasks_t));
+
+   for (int i = 0; i < SCAN_BLOCK_SIZE; i += 16){
+      __m128i chunk = _mm_loadu_si128((const __m128i*)&block[i]);
+      __m128i folded = _mm_or_si128(chunk, lowerCase);
+
+      __m128i operators = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, openBrace),
+                                                    _mm_cmpeq_epi8(folded, closeBrace)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(chunk, colon),
+                                                    _mm_cmpeq_epi8(chunk, comma)));
+
+      __m128i control = _mm_sub_epi8(chunk, tab);
+      __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(control, controlRange), control),
+                                    _mm_cmpeq_epi8(chunk, space));
+
+      masks->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)) << i;
+      masks->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)) << i;
+      masks->operators |= (uint64_t)(uint16_t)_mm_movemask_epi8(operators) << i;
+      masks->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(spaces) << i;
+      masks->nonASCII |= (uint64_t)(uint16_t)_mm_movemask_epi8(chunk) << i;
+   }
+}
+
+/**
+ * Classifies a block 32 bytes at a time with AVX2, the same way
+ * classifyBlockSSE2() does.
+ *
+ * @param block - The 64 bytes to classify
+ * @param masks - The masks for the block
+ */
+__attribute__((target("avx2")))
+static void classifyBlockAVX2(const char* block, JSONBlockMasks_t* masks){
+   const __m256i quote = _mm256_set1_epi8('"');
+   const __m256i backslash = _mm256_set1_epi8('\\');
+   const __m256i openBrace = _mm256_set1_epi8('{');
+   const __m256i closeBrace = _mm256_set1_epi8('}');
+   const __m256i colon = _mm256_set1_epi8(':');
+   const __m256i comma = _mm256_set1_epi8(',');
+   const __m256i space = _mm256_set1_epi8(' ');
+   const __m256i tab = _mm256_set1_epi8('\t');
+   const __m256i controlRange = _mm256_set1_epi8('\r' - '\t');
+   const __m256i lowerCase = _mm256_set1_epi8(0x20);
+
+   memset(masks, 0, sizeof(JSONBlockMasks_t));
+
+   for (int i = 0; i < SCAN_BLOCK_SIZE; i += 32){
+      __m256i chunk = _mm256_loadu_si256((const __m256i*)&block[i]);
+      __m256i folded = _mm256_or_si256(chunk, lowerCase);
+
+      __m256i operators = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, openBrace),
+                                                          _mm256_cmpeq_epi8(folded, closeBrace)),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colon),
+                                                          _mm256_cmpeq_epi8(chunk, comma)));
+
+      __m256i control = _mm256_sub_epi8(chunk, tab);
+      __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(control, controlRange), control),
+                                       _mm256_cmpeq_epi8(chunk, space));
+
+      masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote)) << i;
+      masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)) << i;
+      masks->operators |= (uint64_t)(uint32_t)_mm256_movemask_epi8(operators) << i;
+      masks->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(spaces) << i;
+      masks->nonASCII |= (uint64_t)(uint32_t)_mm256_movemask_epi8(chunk) << i;
+   }
+}
+
+/**
+ * Checks that a range is well formed UTF-8, 16 bytes at a time with SSSE3.
+ * This is the lookup algorithm from Keiser and Lemire, "Validating UTF-8
+ * In Less Than One Instruction Per Byte". Every pair of neighbouring bytes
+ * is checked with three table lookups, one for each nibble of the first
+ * byte and one for the high nibble of the second. Each lookup gives the
+ * errors that nibble is part of, and a pair is broken when all three agree
+ * on one. The third and fourth bytes of a sequence are checked by looking
+ * two and three bytes back for the lead byte. Chunks of pure ASCII only
+ * need to check that the last chunk did not end in the middle of a
+ * sequence.
+ *
+ * @param message - The characters to check
+ * @param length - How many characters to check
+ * @return true if the whole range is well formed
+ */
+__attribute__((target("ssse3")))
+static bool checkUTF8SSSE3(const char* message, size_t length){
+   const __m128i firstHigh = _mm_loadu_si128((const __m128i*)utf8FirstHigh);
+   const __m128i firstLow = _mm_loadu_si128((const __m128i*)utf8FirstLow);
+   const __m128i secondHigh = _mm_loadu_si128((const __m128i*)utf8SecondHigh);
+   const __m128i nibble = _mm_set1_epi8(0x0F);
+   const __m128i highBit = _mm_set1_epi8((char)0x80);
+   const __m128i thirdByte = _mm_set1_epi8((char)(0xE0 - 0x80));
+   const __m128i fourthByte = _mm_set1_epi8((char)(0xF0 - 0x80));
+   //Only a lead byte in one of the last three places can be cut off
+   const __m128i cutOff = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+   __m128i previous = _mm_setzero_si128();
+   __m128i incomplete = _mm_setzero_si128();
+   __m128i error = _mm_setzero_si128();
+   char padded[16];
+
+   for (size_t index = 0; index < length; index += 16){
+      __m128i input;
+      if (index + 16 <= length){
+         input = _mm_loadu_si128((const __m128i*)&message[index]);
+      }
+      else {
+         //The end is padded with ASCII, which finds a sequence that was cut off
+         memset(padded, 0, sizeof(padded));
+         memcpy(padded, &message[index], length - index);
+         input = _mm_loadu_si128((const __m128i*)padded);
+      }
+
+      if (!_mm_movemask_epi8(input)){
+         error = _mm_or_si128(error, incomplete);
+         previous = input;
+         continue;
+      }
+
+      __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+      __m128i special = _mm_and_si128(_mm_and_si128(
+                           _mm_shuffle_epi8(firstHigh, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                           _mm_shuffle_epi8(firstLow, _mm_and_si128(prev1, nibble))),
+                           _mm_shuffle_epi8(secondHigh, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+      //Continuation bytes two or three after a lead byte are expected
+      __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+      __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+      __m128i expected = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(prev2, thirdByte),
+                                                    _mm_subs_epu8(prev3, fourthByte)), highBit);
+
+      error = _mm_or_si128(error, _mm_xor_si128(expected, special));
+      incomplete = _mm_subs_epu8(input, cutOff);
+      previous = input;
+   }
+
+   error = _mm_or_si128(error, incomplete);
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+/**
+ * Checks that a range is well formed UTF-8, 32 bytes at a time with AVX2,
+ * the same way checkUTF8SSSE3() does. The shuffles only work inside of
+ * each 16 byte lane, so the bytes before the chunk are lined up across the
+ * lanes with a permute first.
+ *
+ * @param message - The characters to check
+ * @param length - How many characters to check
+ * @return true if the whole range is well formed
+ */
+__attribute__((target("avx2")))
+static bool checkUTF8AVX2(const char* message, size_t length){
+   const __m256i firstHigh = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)utf8FirstHigh));
+   const __m256i firstLow = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)utf8FirstLow));
+   const __m256i secondHigh = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)utf8SecondHigh));
+   const __m256i nibble = _mm256_set1_epi8(0x0F);
+   const __m256i highBit = _mm256_set1_epi8((char)0x80);
+   const __m256i thirdByte = _mm256_set1_epi8((char)(0xE0 - 0x80));
+   const __m256i fourthByte = _mm256_set1_epi8((char)(0xF0 - 0x80));
+   const __m256i cutOff = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                           -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                           (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+   __m256i previous = _mm256_setzero_si256();
+   __m256i incomplete = _mm256_setzero_si256();
+   __m256i error = _mm256_setzero_si256();
+   char padded[32];
+
+   for (size_t index = 0; index < length; index += 32){
+      __m256i input;
+      if (index + 32 <= length){
+         input = _mm256_loadu_si256((const __m256i*)&message[index]);
+      }
+      else {
+         memset(padded, 0, sizeof(padded));
+         memcpy(padded, &message[index], length - index);
+         input = _mm256_loadu_si256((const __m256i*)padded);
+      }
+
+      if (!_mm256_movemask_epi8(input)){
+         error = _mm256_or_si256(error, incomplete);
+         previous = input;
+         continue;
+      }
+
+      //The last 16 bytes of the previous chunk, then the first 16 of this one
+      __m256i shifted = _mm256_permute2x128_si256(previous, input, 0x21);
+      __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+      __m256i special = _mm256_and_si256(_mm256_and_si256(
+                           _mm256_shuffle_epi8(firstHigh, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                           _mm256_shuffle_epi8(firstLow, _mm256_and_si256(prev1, nibble))),
+                           _mm256_shuffle_epi8(secondHigh, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+      __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+      __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+      __m256i expected = _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(prev2, thirdByte),
+                                                          _mm256_subs_epu8(prev3, fourthByte)), highBit);
+
+      error = _mm256_or_si256(error, _mm256_xor_si256(expected, special));
+      incomplete = _mm256_subs_epu8(input, cutOff);
+      previous = input;
+   }
+
+   error = _mm256_or_si256(error, incomplete);
+   return _mm256_testz_si256(error, error);
+}
+
+#endif
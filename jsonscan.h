@@ -0,0 +1,64 @@
+#ifndef _JSON_SCAN_H
+#define _JSON_SCAN_H
+
+#include <stdint.h>
+
+#include "jsoncommon.h"
+
+#define SCAN_BLOCK_SIZE          64
+
+//Traits of the characters inside of numbers, literals, and unicode escapes
+#define TRAIT_NUMBER             0x01
+#define TRAIT_LETTER             0x02
+#define TRAIT_HEX                0x04
+#define TRAIT_DELIMITER          0x08
+
+/**
+ * The structural scanner is the first stage of the parser. It looks at the
+ * message 64 bytes at a time and builds an index of every byte the parser
+ * actually needs to look at: the structural characters '{' '}' '[' ']' ':'
+ * and ',', the quotes that open and close strings, and the first character
+ * of every number, literal, or other run of characters outside of a string.
+ * Whitespace and the inside of strings never make it into the index. Escaped
+ * quotes are recognized, so the quote after an opening quote in the index is
+ * always the closing quote of that string.
+ *
+ * The index for a block is kept as a bit mask, bit n is set if the byte at
+ * base + n is in the index. This is a private part of the parser and is not
+ * installed with the other headers.
+ */
+typedef struct {
+   const char* message; /**< The message being scanned */
+   size_t size;         /**< The length of the message */
+   size_t scanned;      /**< How far into the message the scanner has gone */
+   size_t base;         /**< Where the current block starts in the message */
+   uint64_t index;      /**< The positions in the current block that have not been used yet */
+   uint64_t inString;   /**< All ones if the last block ended inside of a string */
+   uint64_t escaped;    /**< 1 if the first byte of the next block is escaped */
+   uint64_t scalar;     /**< 1 if the last block ended in the middle of a value */
+   size_t nonASCIIEnd;  /**< One past the last byte scanned that is not ASCII, 0 if there has not been one */
+} JSONScanner_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const unsigned char characterTraits[256];
+
+void initJSONScanner(JSONScanner_t* scanner, const char* message, size_t start, size_t size);
+bool nextStructural(JSONScanner_t* scanner, size_t* position);
+size_t nextStructurals(JSONScanner_t* scanner, uint32_t* positions, size_t room);
+size_t countNewLines(const char* message, size_t start, size_t end);
+size_t findQuoteOrEscape(const char* message, size_t index, size_t size);
+size_t findEscapeOrControl(const char* message, size_t index, size_t size);
+size_t findInvalidUTF8(const char* message, size_t index, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
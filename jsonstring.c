@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "jsontools.h"
+#include "jsonscan.h"
+#include "jsonstring.h"
+
+//The UTF-16 surrogates that \u escapes use for characters above 0xFFFF
+#define HIGH_SURROGATE_FIRST     0xD800
+#define HIGH_SURROGATE_LAST      0xDBFF
+#define LOW_SURROGATE_FIRST      0xDC00
+#define LOW_SURROGATE_LAST       0xDFFF
+
+/**
+ * The character each single letter escape stands for. Anything not
+ * listed is not a valid escape (\u is handled on its own).
+ */
+static const char unescapes[256] = {
+   ['"'] = '"', ['\\'] = '\\', ['/'] = '/', ['b'] = '\b', ['f'] = '\f',
+   ['n'] = '\n', ['r'] = '\r', ['t'] = '\t'
+};
+
+/**
+ * How each byte is written in a message. Bytes that are not listed are
+ * written as they are, the rest are written as a backslash followed by
+ * the listed letter, and 'u' means a \u00XX escape.
+ */
+static const char escapes[256] = {
+   [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+   [0x08] = 'b', [0x09] = 't', [0x0a] = 'n', [0x0b] = 'u', [0x0c] = 'f', [0x0d] = 'r', [0x0e] = 'u', [0x0f] = 'u',
+   [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u', [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+   [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+   ['"'] = '"', ['\\'] = '\\'
+};
+
+static const char hexDigits[] = "0123456789abcdef";
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static bool readHex(const char* token, size_t index, size_t length, uint32_t* value);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Expands the escape sequences in a string from a message into the UTF-8
+ * text they stand for. A \u escape of a high surrogate has to be followed
+ * by a \u escape of a low surrogate, and the pair is written as the one
+ * four byte character it stands for. Control characters are left as they
+ * are. A \u0000 is written as a null byte, so a string that holds one
+ * looks shorter than it is to the C string functions.
+ *
+ * Escapes only ever get shorter, so output can be the token itself to
+ * decode the string in place. Either way it needs room for length + 1
+ * bytes, and the decoded string is null terminated.
+ *
+ * @param token - The string as it is in the message (without the quotes)
+ * @param length - The length of the string in the message
+ * @param output - Where the decoded string is written
+ * @param written - The length of the decoded string
+ * @return JSON_SUCCESS, JSON_UNEXPECTED_CHARACTER if a backslash is followed
+ *    by a letter that is not an escape, or JSON_INVALID_UNICODE_SEQ if a \u
+ *    escape does not have four hex digits or has an unpaired surrogate
+ */
+JSONError_t unescapeJSONString(const char* token, size_t length, char* output, size_t* written){
+   size_t outputIndex = 0;
+   size_t start = 0;
+
+   while (start < length){
+      //Copy the run up to the next escape in bulk
+      size_t end = findEscapeOrControl(token, start, length);
+      if (&output[outputIndex] != &token[start]){
+         memmove(&output[outputIndex], &token[start], end - start);
+      }
+      outputIndex += end - start;
+      if (end >= length){
+         break;
+      }
+
+      if (token[end] != '\\'){
+         output[outputIndex++] = token[end];
+         start = end + 1;
+         continue;
+      }
+
+      if (end + 1 >= length){
+         return JSON_UNEXPECTED_CHARACTER;
+      }
+
+      char escape = unescapes[(unsigned char)token[end + 1]];
+      if (escape){
+         output[outputIndex++] = escape;
+         start = end + 2;
+         continue;
+      }
+
+      uint32_t codePoint;
+      if (token[end + 1] != 'u'){
+         return JSON_UNEXPECTED_CHARACTER;
+      }
+
+      size_t used = readUnicodeEscape(token, end, length, &codePoint);
+      if (!used){
+         return JSON_INVALID_UNICODE_SEQ;
+      }
+
+      outputIndex += writeUTF8(codePoint, &output[outputIndex]);
+      start = end + used;
+   }
+
+   output[outputIndex] = '\0';
+   *written = outputIndex;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Reads a \u escape. A high surrogate has to be followed right away by a
+ * \u escape of a low surrogate, and the two are read as the one character
+ * they stand for.
+ *
+ * @param token - The string
+ * @param index - The backslash that starts the escape
+ * @param length - The length of the string
+ * @param codePoint - The character the escape stands for
+ * @return How many bytes the escape takes up (6, or 12 for a surrogate
+ *    pair), or 0 if it does not have four hex digits or has an unpaired
+ *    surrogate
+ */
+size_t readUnicodeEscape(const char* token, size_t index, size_t length, uint32_t* codePoint){
+   uint32_t high;
+   if (!readHex(token, index + 2, length, &high)){
+      return 0;
+   }
+
+   if (high >= LOW_SURROGATE_FIRST && high <= LOW_SURROGATE_LAST){
+      return 0;
+   }
+
+   if (high < HIGH_SURROGATE_FIRST || high > HIGH_SURROGATE_LAST){
+      *codePoint = high;
+      return 6;
+   }
+
+   //The low half has to come right after the high half
+   uint32_t low;
+   index += 6;
+   if (index + 1 >= length || token[index] != '\\' || token[index + 1] != 'u' ||
+       !readHex(token, index + 2, length, &low) || low < LOW_SURROGATE_FIRST || low > LOW_SURROGATE_LAST){
+      return 0;
+   }
+
+   *codePoint = 0x10000 + ((high - HIGH_SURROGATE_FIRST) << 10) + (low - LOW_SURROGATE_FIRST);
+   return 12;
+}
+
+/**
+ * Finds how long a decoded string will be once it is escaped for a
+ * message, see escapeJSONString().
+ *
+ * @param string - The decoded string
+ * @return The length of the escaped string, without the null terminator
+ */
+size_t escapedJSONLength(const char* string){
+   size_t length = 0;
+
+   for (const unsigned char* c = (const unsigned char*)string; *c; c++){
+      char escape = escapes[*c];
+      length += (!escape) ? 1 : (escape == 'u') ? 6 : 2;
+   }
+
+   return length;
+}
+
+/**
+ * Escapes a decoded string so it can be written in a message. Quotes,
+ * backslashes, and control characters are escaped, everything else
+ * (including UTF-8) is written as it is.
+ *
+ * @param output - Where the escaped string is written, it needs room for
+ *    escapedJSONLength() + 1 bytes
+ * @param string - The decoded string
+ * @return The null terminator at the end of the escaped string
+ */
+char* escapeJSONString(char* output, const char* string){
+   for (const unsigned char* c = (const unsigned char*)string; *c; c++){
+      char escape = escapes[*c];
+      if (!escape){
+         *output++ = (char)*c;
+      }
+      else if (escape == 'u'){
+         memcpy(output, "\\u00", 4);
+         output[4] = hexDigits[*c >> 4];
+         output[5] = hexDigits[*c & 0x0F];
+         output += 6;
+      }
+      else {
+         output[0] = '\\';
+         output[1] = escape;
+         output += 2;
+      }
+   }
+
+   *output = '\0';
+   return output;
+}
+
+/**
+ * Writes one unicode character as UTF-8.
+ *
+ * @param codePoint - The character, up to 0x10FFFF
+ * @param output - Where the bytes are written, it needs room for 4
+ * @return The number of bytes written
+ */
+size_t writeUTF8(uint32_t codePoint, char* output){
+   if (codePoint <= 0x7F){
+      output[0] = (char)codePoint;
+      return 1;
+   }
+   else if (codePoint <= 0x7FF){
+      output[0] = (char)(0xC0 | (codePoint >> 6));
+      output[1] = (char)(0x80 | (codePoint & 0x3F));
+      return 2;
+   }
+   else if (codePoint <= 0xFFFF){
+      output[0] = (char)(0xE0 | (codePoint >> 12));
+      output[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+      output[2] = (char)(0x80 | (codePoint & 0x3F));
+      return 3;
+   }
+
+   output[0] = (char)(0xF0 | (codePoint >> 18));
+   output[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+   output[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+   output[3] = (char)(0x80 | (codePoint & 0x3F));
+   return 4;
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Reads the four hex digits of a \u escape.
+ *
+ * @param token - The string
+ * @param index - Where the digits start
+ * @param length - The length of the string
+ * @param value - The value of the digits
+ * @return false if there are not four hex digits
+ */
+static bool readHex(const char* token, size_t index, size_t length, uint32_t* value){
+   if (index + 4 > length){
+      return false;
+   }
+
+   uint32_t result = 0;
+   for (size_t i = index; i < index + 4; i++){
+      char c = token[i];
+      uint32_t digit;
+      if (c >= '0' && c <= '9'){
+         digit = (uint32_t)(c - '0');
+      }
+      else if (c >= 'a' && c <= 'f'){
+         digit = (uint32_t)(c - 'a' + 10);
+      }
+      else if (c >= 'A' && c <= 'F'){
+         digit = (uint32_t)(c - 'A' + 10);
+      }
+      else {
+         return false;
+      }
+      result = (result << 4) | digit;
+   }
+
+   *value = result;
+   return true;
+}
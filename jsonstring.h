@@ -0,0 +1,35 @@
+#ifndef _JSON_STRING_H
+#define _JSON_STRING_H
+
+#include <stdint.h>
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+
+/**
+ * Converts strings between the escaped form they have in a message and
+ * the UTF-8 text they stand for. The parser uses this to decode strings
+ * and keys, and the output module uses it to escape decoded strings again.
+ * This is a private part of the library and is not installed with the
+ * other headers.
+ */
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONError_t unescapeJSONString(const char* token, size_t length, char* output, size_t* written);
+size_t readUnicodeEscape(const char* token, size_t index, size_t length, uint32_t* codePoint);
+size_t escapedJSONLength(const char* string);
+char* escapeJSONString(char* output, const char* string);
+size_t writeUTF8(uint32_t codePoint, char* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,740 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "jsontools.h"
+#include "jsontape.h"
+
+#define TAPE_WORDS_SIZE          256
+#define TAPE_STRINGS_SIZE        1024
+#define TAPE_STACK_SIZE          16
+#define TAPE_LENGTH_SIZE         sizeof(uint32_t)
+
+/**
+ * An object or array that has not been closed yet.
+ */
+typedef struct {
+   size_t word;   /**< The word that opened it */
+   size_t count;  /**< How many values have been added to it so far */
+} TapeFrame_t;
+
+/**
+ * What the callbacks need while a tape is being written.
+ */
+typedef struct {
+   JSONTape_t* tape;    /**< The tape being written */
+   TapeFrame_t* stack;  /**< The objects and arrays that are still open */
+   size_t depth;        /**< How many of them there are */
+   size_t stackSize;    /**< How many fit in the stack before it has to grow */
+   JSONError_t error;   /**< Why a callback stopped the parser, if one did */
+} TapeBuilder_t;
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static bool tapeStartObject(void* context);
+static bool tapeEndObject(void* context);
+static bool tapeStartArray(void* context);
+static bool tapeEndArray(void* context);
+static bool tapeKey(void* context, const char* key, size_t length);
+static bool tapeString(void* context, const char* value, size_t length);
+static bool tapeNumber(void* context, double value);
+static bool tapeBoolean(void* context, bool value);
+static bool tapeNull(void* context);
+static bool openContainer(TapeBuilder_t* builder, int tag);
+static bool closeContainer(TapeBuilder_t* builder, int tag);
+static bool writeString(TapeBuilder_t* builder, int tag, const char* string, size_t length);
+static bool reserveWords(TapeBuilder_t* builder, size_t words);
+static void countValue(TapeBuilder_t* builder);
+static size_t firstValue(JSONTapeValue_t* value, size_t word);
+static const char* readTapeString(const JSONTape_t* tape, size_t word, size_t* length);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Creates an empty tape to parse messages into.
+ *
+ * @return The new tape, or NULL if it could not be allocated
+ */
+JSONTape_t* newJSONTape(){
+   JSONTape_t* tape = (JSONTape_t*)malloc(sizeof(JSONTape_t));
+   if (!tape){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   memset(tape, 0, sizeof(JSONTape_t));
+   return tape;
+}
+
+/**
+ * Parses the first JSON message in a buffer onto a tape, instead of
+ * building it into pairs. Whatever was on the tape before is replaced.
+ * The message is checked the same way parseJSONBuffer() checks it, with
+ * the parsers options, maximum depth, and projection. Strings are always
+ * decoded, as if PARSE_DECODE_STRINGS was set. The message is not needed
+ * once this returns.
+ *
+ * @param parser - The parser used to read the message
+ * @param tape - The tape to write the message to
+ * @param message - The start of the JSON message
+ * @param length - The number of bytes available in the message buffer
+ * @param consumed - The number of bytes used by this message, see parseJSONBuffer()
+ * @return JSON_SUCCESS, JSON_MALLOC_FAIL, JSON_MESSAGE_TOO_LARGE if the tape
+ *    would need more than TAPE_MAX_WORDS words, or the problem that was
+ *    found in the message. The tape is left empty if there was a problem.
+ */
+JSONError_t parseJSONTape(JSONParser_t* parser, JSONTape_t* tape, const char* message, size_t length, size_t* consumed){
+   if (!parser || !tape){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   TapeBuilder_t builder;
+   memset(&builder, 0, sizeof(TapeBuilder_t));
+   builder.tape = tape;
+   builder.stackSize = TAPE_STACK_SIZE;
+   builder.stack = (TapeFrame_t*)malloc(builder.stackSize * sizeof(TapeFrame_t));
+   if (!builder.stack){
+      json_errno = JSON_MALLOC_FAIL;
+      return JSON_MALLOC_FAIL;
+   }
+
+   JSONCallbacks_t callbacks = {
+      &builder, tapeStartObject, tapeEndObject, tapeStartArray, tapeEndArray,
+      tapeKey, tapeString, tapeNumber, tapeBoolean, tapeNull
+   };
+
+   tape->count = 0;
+   tape->stringsLength = 0;
+
+   //The parser hands callbacks decoded strings, which are copied straight
+   //onto the tape
+   int options = parser->options;
+   parser->options |= PARSE_DECODE_STRINGS;
+   JSONError_t returnStatus = parseJSONEvents(parser, &callbacks, message, length, consumed);
+   parser->options = options;
+
+   if (returnStatus == JSON_CALLBACK_ABORTED && builder.error){
+      returnStatus = builder.error;
+      json_errno = returnStatus;
+   }
+
+   if (returnStatus){
+      tape->count = 0;
+      tape->stringsLength = 0;
+   }
+
+   free(builder.stack);
+   return returnStatus;
+}
+
+/**
+ * Gets the outer value of the message on a tape.
+ *
+ * @param tape - The tape
+ * @return The root value, or a value that does not exist if the tape is empty
+ */
+JSONTapeValue_t getTapeRoot(const JSONTape_t* tape){
+   JSONTapeValue_t root = { tape, (tape && tape->count) ? 0 : TAPE_NO_VALUE, TAPE_NO_VALUE };
+   return root;
+}
+
+/**
+ * Checks if a value was found.
+ *
+ * @param value - The value returned by one of the tape lookups
+ * @return true if the value exists, false if the lookup did not find anything
+ */
+bool isTapeValue(JSONTapeValue_t value){
+   return value.tape && value.word != TAPE_NO_VALUE;
+}
+
+/**
+ * Gets the type of a value.
+ *
+ * @param value - The value
+ * @return The type of the value, NIL if the value does not exist
+ */
+JSONType_t getTapeType(JSONTapeValue_t value){
+   if (!isTapeValue(value)){
+      return NIL;
+   }
+
+   switch (TAPE_TAG(value.tape->words[value.word])){
+      case TAPE_OBJECT : return OBJECT;
+      case TAPE_ARRAY  : return ARRAY;
+      case TAPE_STRING : return STRING;
+      case TAPE_NUMBER : return NUMBER;
+      case TAPE_TRUE   :
+      case TAPE_FALSE  : return BOOLEAN;
+      default          : return NIL;
+   }
+}
+
+/**
+ * Finds the value with the given key in an object. The other values in
+ * the object are stepped over without looking inside them.
+ *
+ * @param parent - The object to look in
+ * @param key - The key of the value to find
+ * @return The value, or a value that does not exist if the parent is not
+ *    an object, or has no value with that key
+ */
+JSONTapeValue_t getTapeChild(JSONTapeValue_t parent, const char* key){
+   JSONTapeValue_t child = { parent.tape, TAPE_NO_VALUE, TAPE_NO_VALUE };
+
+   if (!key || getTapeType(parent) != OBJECT){
+      return child;
+   }
+
+   size_t keyLength = strlen(key);
+   for (child = getTapeFirst(parent); isTapeValue(child); child = getTapeNext(child)){
+      size_t length;
+      const char* childKey = readTapeString(child.tape, child.key, &length);
+      if (length == keyLength && memcmp(childKey, key, keyLength) == 0){
+         break;
+      }
+   }
+
+   return child;
+}
+
+/**
+ * Finds the value at an index of an array. The values in front of it are
+ * stepped over without looking inside them.
+ *
+ * @param parent - The array to look in
+ * @param index - The index of the value, starting at 0
+ * @return The value, or a value that does not exist if the parent is not
+ *    an array, or the index is past the end of it
+ */
+JSONTapeValue_t getTapeElement(JSONTapeValue_t parent, int index){
+   JSONTapeValue_t element = { parent.tape, TAPE_NO_VALUE, TAPE_NO_VALUE };
+
+   if (index < 0 || getTapeType(parent) != ARRAY || index >= getTapeLength(parent)){
+      return element;
+   }
+
+   element = getTapeFirst(parent);
+   while (index > 0){
+      element = getTapeNext(element);
+      index--;
+   }
+
+   return element;
+}
+
+/**
+ * Gets the first value in an object or array. Together with getTapeNext()
+ * this walks every value in it.
+ *
+ * @param parent - The object or array
+ * @return The first value, or a value that does not exist if the parent is
+ *    empty, or is not an object or array
+ */
+JSONTapeValue_t getTapeFirst(JSONTapeValue_t parent){
+   JSONTapeValue_t first = { parent.tape, TAPE_NO_VALUE, TAPE_NO_VALUE };
+   JSONType_t type = getTapeType(parent);
+
+   if (type == OBJECT || type == ARRAY){
+      first.word = firstValue(&first, parent.word + 1);
+   }
+
+   return first;
+}
+
+/**
+ * Gets the value that comes after this one in its object or array. An
+ * object or array is stepped over in one jump, no matter how much is in it.
+ *
+ * @param value - A value returned by getTapeFirst() or getTapeNext()
+ * @return The next value, or a value that does not exist if this was the last one
+ */
+JSONTapeValue_t getTapeNext(JSONTapeValue_t value){
+   JSONTapeValue_t next = { value.tape, TAPE_NO_VALUE, TAPE_NO_VALUE };
+
+   if (isTapeValue(value) && value.word != 0){
+      next.word = firstValue(&next, skipTapeValue(value.tape, value.word));
+   }
+
+   return next;
+}
+
+/**
+ * Finds the word just past a value, for walking the words of a tape
+ * directly. Objects and arrays are stepped over in one jump.
+ *
+ * @param tape - The tape
+ * @param word - The word a value starts at
+ * @return The word after the value
+ */
+size_t skipTapeValue(const JSONTape_t* tape, size_t word){
+   uint64_t tapeWord = tape->words[word];
+
+   switch (TAPE_TAG(tapeWord)){
+      case TAPE_OBJECT :
+      case TAPE_ARRAY  : return TAPE_SKIP(tapeWord);
+      case TAPE_NUMBER : return word + 2;
+      default          : return word + 1;
+   }
+}
+
+/**
+ * Counts the values in an object or array the same way the length of a
+ * pair is counted. Other values have a length of 1. The count is kept on
+ * the tape, so this does not walk the values unless there are more than
+ * TAPE_MAX_COUNT of them.
+ *
+ * @param value - The value
+ * @return The number of values in it, 0 if the value does not exist
+ */
+int getTapeLength(JSONTapeValue_t value){
+   JSONType_t type = getTapeType(value);
+
+   if (!isTapeValue(value)){
+      return 0;
+   }
+
+   if (type != OBJECT && type != ARRAY){
+      return 1;
+   }
+
+   int length = TAPE_COUNT(value.tape->words[value.word]);
+   if (length < TAPE_MAX_COUNT){
+      return length;
+   }
+
+   length = 0;
+   for (JSONTapeValue_t child = getTapeFirst(value); isTapeValue(child); child = getTapeNext(child)){
+      length++;
+   }
+
+   return length;
+}
+
+/**
+ * Gets the key of a value in an object.
+ *
+ * @param value - A value in an object
+ * @return The key (decoded and null terminated), or NULL if the value is
+ *    not in an object
+ */
+const char* getTapeKey(JSONTapeValue_t value){
+   if (!isTapeValue(value) || value.key == TAPE_NO_VALUE){
+      return NULL;
+   }
+
+   return readTapeString(value.tape, value.key, NULL);
+}
+
+/**
+ * Gets the string contents of a value. The string is decoded and null
+ * terminated, and stays on the tape until another message is parsed
+ * onto it. A string that holds a \u0000 looks shorter than it is to the
+ * C string functions, the length does not.
+ *
+ * @param value - The value that holds a string
+ * @param string - Will point to the string
+ * @param length - Will hold the length of the string, can be NULL
+ * @return JSON_SUCCESS, JSON_NO_MATCHING_PAIR if the value does not exist,
+ *    or JSON_INVALID_ARGUMENT if it is not a string
+ */
+JSONError_t getTapeString(JSONTapeValue_t value, const char** string, size_t* length){
+   if (!string){
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!isTapeValue(value)){
+      return JSON_NO_MATCHING_PAIR;
+   }
+
+   if (getTapeType(value) != STRING){
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   *string = readTapeString(value.tape, value.word, length);
+   return JSON_SUCCESS;
+}
+
+/**
+ * Gets the number contents of a value.
+ *
+ * @param value - The value that holds a number
+ * @param number - Will hold the number
+ * @return JSON_SUCCESS, JSON_NO_MATCHING_PAIR if the value does not exist,
+ *    or JSON_INVALID_ARGUMENT if it is not a number
+ */
+JSONError_t getTapeNumber(JSONTapeValue_t value, double* number){
+   if (!number){
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!isTapeValue(value)){
+      return JSON_NO_MATCHING_PAIR;
+   }
+
+   if (getTapeType(value) != NUMBER){
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   memcpy(number, &value.tape->words[value.word + 1], sizeof(double));
+   return JSON_SUCCESS;
+}
+
+/**
+ * Gets the boolean contents of a value.
+ *
+ * @param value - The value that holds true or false
+ * @param boolean - Will hold the value
+ * @return JSON_SUCCESS, JSON_NO_MATCHING_PAIR if the value does not exist,
+ *    or JSON_INVALID_ARGUMENT if it is not a boolean
+ */
+JSONError_t getTapeBoolean(JSONTapeValue_t value, bool* boolean){
+   if (!boolean){
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (!isTapeValue(value)){
+      return JSON_NO_MATCHING_PAIR;
+   }
+
+   if (getTapeType(value) != BOOLEAN){
+      return JSON_INVALID_ARGUMENT;
+   }
+
+   *boolean = TAPE_TAG(value.tape->words[value.word]) == TAPE_TRUE;
+   return JSON_SUCCESS;
+}
+
+/**
+ * Gets the string contents of a value without any error handling.
+ *
+ * @param value - The value that holds a string
+ * @return The string, or NULL if the value is not a string
+ * @see getTapeString
+ */
+const char* getTapeStringVal(JSONTapeValue_t value){
+   const char* string = NULL;
+
+   if (getTapeString(value, &string, NULL)){
+      return NULL;
+   }
+
+   return string;
+}
+
+/**
+ * Gets the number contents of a value without any error handling.
+ *
+ * @param value - The value that holds a number
+ * @return The number, or 0.0 if the value is not a number
+ * @see getTapeNumber
+ */
+double getTapeNumberVal(JSONTapeValue_t value){
+   double number = 0.0;
+
+   if (getTapeNumber(value, &number)){
+      return 0.0;
+   }
+
+   return number;
+}
+
+/**
+ * Gets the boolean contents of a value without any error handling.
+ *
+ * @param value - The value that holds a boolean
+ * @return The boolean, or false if the value is not a boolean
+ * @see getTapeBoolean
+ */
+bool getTapeBooleanVal(JSONTapeValue_t value){
+   bool boolean = false;
+
+   if (getTapeBoolean(value, &boolean)){
+      return false;
+   }
+
+   return boolean;
+}
+
+/**
+ * Frees a tape and everything on it.
+ *
+ * @param tape - The tape that was created by newJSONTape()
+ */
+void disposeOfJSONTape(JSONTape_t* tape){
+   if (!tape){
+      return;
+   }
+
+   free(tape->words);
+   free(tape->strings);
+   free(tape);
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+static bool tapeStartObject(void* context){
+   return openContainer((TapeBuilder_t*)context, TAPE_OBJECT);
+}
+
+static bool tapeEndObject(void* context){
+   return closeContainer((TapeBuilder_t*)context, TAPE_OBJECT_END);
+}
+
+static bool tapeStartArray(void* context){
+   return openContainer((TapeBuilder_t*)context, TAPE_ARRAY);
+}
+
+static bool tapeEndArray(void* context){
+   return closeContainer((TapeBuilder_t*)context, TAPE_ARRAY_END);
+}
+
+static bool tapeKey(void* context, const char* key, size_t length){
+   return writeString((TapeBuilder_t*)context, TAPE_KEY, key, length);
+}
+
+static bool tapeString(void* context, const char* value, size_t length){
+   countValue((TapeBuilder_t*)context);
+   return writeString((TapeBuilder_t*)context, TAPE_STRING, value, length);
+}
+
+/**
+ * Writes a number as its tag word and a word that holds its bits.
+ */
+static bool tapeNumber(void* context, double value){
+   TapeBuilder_t* builder = (TapeBuilder_t*)context;
+   if (!reserveWords(builder, 2)){
+      return false;
+   }
+
+   JSONTape_t* tape = builder->tape;
+   countValue(builder);
+   tape->words[tape->count] = (uint64_t)TAPE_NUMBER << TAPE_TAG_SHIFT;
+   memcpy(&tape->words[tape->count + 1], &value, sizeof(double));
+   tape->count += 2;
+   return true;
+}
+
+static bool tapeBoolean(void* context, bool value){
+   TapeBuilder_t* builder = (TapeBuilder_t*)context;
+   if (!reserveWords(builder, 1)){
+      return false;
+   }
+
+   countValue(builder);
+   builder->tape->words[builder->tape->count++] = (uint64_t)((value) ? TAPE_TRUE : TAPE_FALSE) << TAPE_TAG_SHIFT;
+   return true;
+}
+
+static bool tapeNull(void* context){
+   TapeBuilder_t* builder = (TapeBuilder_t*)context;
+   if (!reserveWords(builder, 1)){
+      return false;
+   }
+
+   countValue(builder);
+   builder->tape->words[builder->tape->count++] = (uint64_t)TAPE_NULL << TAPE_TAG_SHIFT;
+   return true;
+}
+
+/**
+ * Writes the word that opens an object or array. Its payload is filled
+ * in once the matching close is found.
+ *
+ * @param builder - The tape being written
+ * @param tag - TAPE_OBJECT or TAPE_ARRAY
+ * @return false if the tape or stack could not grow
+ */
+static bool openContainer(TapeBuilder_t* builder, int tag){
+   if (!reserveWords(builder, 1)){
+      return false;
+   }
+
+   if (builder->depth == builder->stackSize){
+      size_t stackSize = builder->stackSize * 2;
+      TapeFrame_t* stack = (TapeFrame_t*)realloc(builder->stack, stackSize * sizeof(TapeFrame_t));
+      if (!stack){
+         builder->error = JSON_MALLOC_FAIL;
+         return false;
+      }
+      builder->stack = stack;
+      builder->stackSize = stackSize;
+   }
+
+   JSONTape_t* tape = builder->tape;
+   countValue(builder);
+   builder->stack[builder->depth].word = tape->count;
+   builder->stack[builder->depth].count = 0;
+   builder->depth++;
+   tape->words[tape->count++] = (uint64_t)tag << TAPE_TAG_SHIFT;
+   return true;
+}
+
+/**
+ * Writes the word that closes an object or array, and goes back to fill
+ * in the count and the skip of the word that opened it.
+ *
+ * @param builder - The tape being written
+ * @param tag - TAPE_OBJECT_END or TAPE_ARRAY_END
+ * @return false if the tape could not grow
+ */
+static bool closeContainer(TapeBuilder_t* builder, int tag){
+   if (!reserveWords(builder, 1)){
+      return false;
+   }
+
+   JSONTape_t* tape = builder->tape;
+   TapeFrame_t* frame = &builder->stack[--builder->depth];
+   uint64_t count = (frame->count < TAPE_MAX_COUNT) ? frame->count : TAPE_MAX_COUNT;
+
+   tape->words[tape->count++] = ((uint64_t)tag << TAPE_TAG_SHIFT) | frame->word;
+   tape->words[frame->word] |= (count << TAPE_COUNT_SHIFT) | tape->count;
+   return true;
+}
+
+/**
+ * Copies a key or string to the end of the strings buffer, and writes the
+ * word that points to it.
+ *
+ * @param builder - The tape being written
+ * @param tag - TAPE_KEY or TAPE_STRING
+ * @param string - The decoded string
+ * @param length - The length of the string
+ * @return false if the string is too long, or the tape could not grow
+ */
+static bool writeString(TapeBuilder_t* builder, int tag, const char* string, size_t length){
+   JSONTape_t* tape = builder->tape;
+
+   if (length > UINT32_MAX){
+      builder->error = JSON_MESSAGE_TOO_LARGE;
+      return false;
+   }
+
+   size_t needed = tape->stringsLength + TAPE_LENGTH_SIZE + length + 1;
+   if (needed > tape->stringsSize){
+      size_t stringsSize = (tape->stringsSize) ? tape->stringsSize : TAPE_STRINGS_SIZE;
+      while (stringsSize < needed){
+         stringsSize *= 2;
+      }
+
+      char* strings = (char*)realloc(tape->strings, stringsSize);
+      if (!strings){
+         builder->error = JSON_MALLOC_FAIL;
+         return false;
+      }
+      tape->strings = strings;
+      tape->stringsSize = stringsSize;
+   }
+
+   if (!reserveWords(builder, 1)){
+      return false;
+   }
+
+   uint32_t stringLength = (uint32_t)length;
+   char* output = &tape->strings[tape->stringsLength];
+   memcpy(output, &stringLength, TAPE_LENGTH_SIZE);
+   memcpy(output + TAPE_LENGTH_SIZE, string, length);
+   output[TAPE_LENGTH_SIZE + length] = '\0';
+
+   tape->words[tape->count++] = ((uint64_t)tag << TAPE_TAG_SHIFT) | tape->stringsLength;
+   tape->stringsLength = needed;
+   return true;
+}
+
+/**
+ * Makes sure there is room for more words on the tape. The tape only ever
+ * grows, so once it is large enough no more memory is needed.
+ *
+ * @param builder - The tape being written
+ * @param words - How many words are about to be written
+ * @return false if the tape could not grow, or would be too long for the
+ *    skips to reach the end of it
+ */
+static bool reserveWords(TapeBuilder_t* builder, size_t words){
+   JSONTape_t* tape = builder->tape;
+   if (tape->count + words <= tape->capacity){
+      return true;
+   }
+
+   if (tape->count + words > TAPE_MAX_WORDS){
+      builder->error = JSON_MESSAGE_TOO_LARGE;
+      return false;
+   }
+
+   size_t capacity = (tape->capacity) ? tape->capacity * 2 : TAPE_WORDS_SIZE;
+   if (capacity > TAPE_MAX_WORDS){
+      capacity = TAPE_MAX_WORDS;
+   }
+
+   uint64_t* newWords = (uint64_t*)realloc(tape->words, capacity * sizeof(uint64_t));
+   if (!newWords){
+      builder->error = JSON_MALLOC_FAIL;
+      return false;
+   }
+
+   tape->words = newWords;
+   tape->capacity = capacity;
+   return true;
+}
+
+/**
+ * Adds one to the count of the object or array a new value is going in.
+ *
+ * @param builder - The tape being written
+ */
+static void countValue(TapeBuilder_t* builder){
+   if (builder->depth){
+      builder->stack[builder->depth - 1].count++;
+   }
+}
+
+/**
+ * Finds the value that starts at a word, stepping over its key if it has
+ * one.
+ *
+ * @param value - Its key is set to the key word, if there is one
+ * @param word - A word just inside an object or array, or just past a value in one
+ * @return The word the value starts at, or TAPE_NO_VALUE at the closing word
+ */
+static size_t firstValue(JSONTapeValue_t* value, size_t word){
+   int tag = TAPE_TAG(value->tape->words[word]);
+
+   if (tag == TAPE_OBJECT_END || tag == TAPE_ARRAY_END){
+      return TAPE_NO_VALUE;
+   }
+
+   if (tag == TAPE_KEY){
+      value->key = word;
+      return word + 1;
+   }
+
+   return word;
+}
+
+/**
+ * Reads a key or string off of the tape.
+ *
+ * @param tape - The tape
+ * @param word - The word of the key or string
+ * @param length - Will hold the length of the string, can be NULL
+ * @return The string
+ */
+static const char* readTapeString(const JSONTape_t* tape, size_t word, size_t* length){
+   const char* string = &tape->strings[TAPE_PAYLOAD(tape->words[word])];
+
+   if (length){
+      uint32_t stringLength;
+      memcpy(&stringLength, string, TAPE_LENGTH_SIZE);
+      *length = stringLength;
+   }
+
+   return string + TAPE_LENGTH_SIZE;
+}
@@ -0,0 +1,107 @@
+#ifndef _JSON_TAPE_H
+#define _JSON_TAPE_H
+
+#include <stdint.h>
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+#include "jsonparser.h"
+
+#define TAPE_NO_VALUE            ((size_t)-1)
+#define TAPE_TAG_SHIFT           56
+#define TAPE_PAYLOAD_MASK        0x00FFFFFFFFFFFFFFULL
+#define TAPE_COUNT_SHIFT         32
+#define TAPE_MAX_COUNT           0x00FFFFFF
+#define TAPE_MAX_WORDS           UINT32_MAX
+
+#define TAPE_TAG(word)           ((int)((word) >> TAPE_TAG_SHIFT))
+#define TAPE_PAYLOAD(word)       ((word) & TAPE_PAYLOAD_MASK)
+#define TAPE_SKIP(word)          ((size_t)((word) & UINT32_MAX))
+#define TAPE_COUNT(word)         ((int)(TAPE_PAYLOAD(word) >> TAPE_COUNT_SHIFT))
+
+/**
+ * What each word on a tape holds. The tag is in the top 8 bits of the
+ * word and the payload is in the other 56 bits.
+ */
+typedef enum {
+   TAPE_OBJECT =     '{', /**< Opens an object, the payload is its count and TAPE_SKIP() */
+   TAPE_OBJECT_END = '}', /**< Closes an object, the payload is the word that opened it */
+   TAPE_ARRAY =      '[', /**< Opens an array, the payload is its count and TAPE_SKIP() */
+   TAPE_ARRAY_END =  ']', /**< Closes an array, the payload is the word that opened it */
+   TAPE_KEY =        ':', /**< The key of the value that follows, the payload is where it is in the strings */
+   TAPE_STRING =     '"', /**< A string value, the payload is where it is in the strings */
+   TAPE_NUMBER =     'd', /**< A number value, the word after it holds the bits of the double */
+   TAPE_TRUE =       't', /**< A true value */
+   TAPE_FALSE =      'f', /**< A false value */
+   TAPE_NULL =       'n'  /**< A null value */
+} JSONTapeTag_t;
+
+/**
+ * A tape is a document stored as one flat array of 64 bit words and one
+ * buffer of strings, instead of pairs linked by pointers. The words are in
+ * the same order as the message, so walking the whole document is a
+ * sequential read. Each word that opens an object or array holds how many
+ * values are in it (in bits 32 to 55, saturating at TAPE_MAX_COUNT) and the
+ * word just past its closing word (in the low 32 bits, see TAPE_SKIP()),
+ * so a whole object or array can be stepped over in one jump.
+ *
+ * Keys and strings are stored decoded, one after another in strings. Each
+ * one is a 32 bit length, the bytes of the string, and a null terminator,
+ * and the payload of its word is the offset of the length.
+ *
+ * A tape can be parsed into again and again, it keeps its memory, so after
+ * the first few messages no more memory is needed.
+ */
+typedef struct {
+   uint64_t* words;        /**< The tape itself */
+   size_t count;           /**< How many words are on the tape */
+   size_t capacity;        /**< How many words fit before the tape has to grow */
+   char* strings;          /**< The keys and strings of the document */
+   size_t stringsLength;   /**< How many bytes of strings are in use */
+   size_t stringsSize;     /**< The size of the strings buffer */
+} JSONTape_t;
+
+/**
+ * One value on a tape. It is small enough to pass around by value. A value
+ * that was not found has its word set to TAPE_NO_VALUE, and every accessor
+ * handles that, so lookups can be chained without checking each step.
+ */
+typedef struct {
+   const JSONTape_t* tape; /**< The tape the value is on */
+   size_t word;            /**< The word the value starts at */
+   size_t key;             /**< The word of its key, TAPE_NO_VALUE if it is not in an object */
+} JSONTapeValue_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONTape_t* newJSONTape();
+JSONError_t parseJSONTape(JSONParser_t* parser, JSONTape_t* tape, const char* message, size_t length, size_t* consumed);
+JSONTapeValue_t getTapeRoot(const JSONTape_t* tape);
+bool isTapeValue(JSONTapeValue_t value);
+JSONType_t getTapeType(JSONTapeValue_t value);
+JSONTapeValue_t getTapeChild(JSONTapeValue_t parent, const char* key);
+JSONTapeValue_t getTapeElement(JSONTapeValue_t parent, int index);
+JSONTapeValue_t getTapeFirst(JSONTapeValue_t parent);
+JSONTapeValue_t getTapeNext(JSONTapeValue_t value);
+size_t skipTapeValue(const JSONTape_t* tape, size_t word);
+int getTapeLength(JSONTapeValue_t value);
+const char* getTapeKey(JSONTapeValue_t value);
+JSONError_t getTapeString(JSONTapeValue_t value, const char** string, size_t* length);
+JSONError_t getTapeNumber(JSONTapeValue_t value, double* number);
+JSONError_t getTapeBoolean(JSONTapeValue_t value, bool* boolean);
+const char* getTapeStringVal(JSONTapeValue_t value);
+double getTapeNumberVal(JSONTapeValue_t value);
+bool getTapeBooleanVal(JSONTapeValue_t value);
+void disposeOfJSONTape(JSONTape_t* tape);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jsontools.h"
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static void* runWorker(void* argument);
+static void stopWorkers(JSONThreadPool_t* pool, int started);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Creates a thread pool and starts its threads. The threads sleep until
+ * a job is given to the pool with runJSONThreadPool().
+ *
+ * @param threads - How many threads to start, 0 (or less) starts one for
+ *    each processor that is online
+ * @return The new pool, or NULL if memory could not be allocated or the
+ *    threads could not be started
+ */
+JSONThreadPool_t* newJSONThreadPool(int threads){
+   if (threads <= 0){
+      long processors = sysconf(_SC_NPROCESSORS_ONLN);
+      threads = (processors > 0) ? (int)processors : 1;
+   }
+
+   JSONThreadPool_t* pool = (JSONThreadPool_t*)malloc(sizeof(JSONThreadPool_t));
+   if (!pool){
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   memset(pool, 0, sizeof(JSONThreadPool_t));
+   pool->threads = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+   if (!pool->threads){
+      free(pool);
+      json_errno = JSON_MALLOC_FAIL;
+      return NULL;
+   }
+
+   pthread_mutex_init(&pool->lock, NULL);
+   pthread_cond_init(&pool->ready, NULL);
+   pthread_cond_init(&pool->done, NULL);
+
+   int started = 0;
+   for (started = 0; started < threads; ++started){
+      if (pthread_create(&pool->threads[started], NULL, runWorker, pool) != 0){
+         stopWorkers(pool, started);
+         json_errno = JSON_INTERNAL_FAILURE;
+         return NULL;
+      }
+   }
+
+   pool->threadCount = threads;
+   return pool;
+}
+
+/**
+ * Runs a job on the pool and waits for every one of its tasks to finish.
+ * If another thread is already running a job on the same pool, this waits
+ * for that job to finish first.
+ *
+ * @param pool - The pool to run the job on
+ * @param task - The function that is called for each task
+ * @param context - Passed to every call of the function
+ * @param count - The number of tasks in the job
+ * @return JSON_SUCCESS, or JSON_NULL_ARGUMENT
+ */
+JSONError_t runJSONThreadPool(JSONThreadPool_t* pool, JSONTask_t task, void* context, size_t count){
+   if (!pool || !task){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   if (count == 0){
+      return JSON_SUCCESS;
+   }
+
+   pthread_mutex_lock(&pool->lock);
+   while (pool->running){
+      pthread_cond_wait(&pool->done, &pool->lock);
+   }
+
+   pool->running = true;
+   pool->task = task;
+   pool->context = context;
+   pool->taskCount = count;
+   pool->nextTask = 0;
+   pool->finished = 0;
+   pthread_cond_broadcast(&pool->ready);
+
+   while (pool->finished < pool->taskCount){
+      pthread_cond_wait(&pool->done, &pool->lock);
+   }
+
+   //Let anyone waiting to post the next job know this one is done
+   pool->running = false;
+   pthread_cond_broadcast(&pool->done);
+   pthread_mutex_unlock(&pool->lock);
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Stops the threads of a pool and frees it. Any job that is running is
+ * finished first.
+ *
+ * @param pool - The pool that was created with newJSONThreadPool()
+ */
+void disposeOfJSONThreadPool(JSONThreadPool_t* pool){
+   if (!pool){
+      return;
+   }
+
+   stopWorkers(pool, pool->threadCount);
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * The loop each thread in the pool runs. It takes the next task of the
+ * current job, or sleeps until there is one.
+ *
+ * @param argument - The pool the thread belongs to
+ * @return NULL
+ */
+static void* runWorker(void* argument){
+   JSONThreadPool_t* pool = (JSONThreadPool_t*)argument;
+
+   pthread_mutex_lock(&pool->lock);
+   while (true){
+      while (!pool->stopping && pool->nextTask >= pool->taskCount){
+         pthread_cond_wait(&pool->ready, &pool->lock);
+      }
+
+      if (pool->nextTask >= pool->taskCount){
+         //Stopping, and there is nothing left to do
+         break;
+      }
+
+      size_t task = pool->nextTask++;
+      pthread_mutex_unlock(&pool->lock);
+
+      pool->task(pool->context, task);
+
+      pthread_mutex_lock(&pool->lock);
+      if (++pool->finished == pool->taskCount){
+         pthread_cond_broadcast(&pool->done);
+      }
+   }
+   pthread_mutex_unlock(&pool->lock);
+
+   return NULL;
+}
+
+/**
+ * Tells the threads of a pool to stop, waits for them, and frees the pool.
+ *
+ * @param pool - The pool to stop
+ * @param started - How many of its threads were started
+ */
+static void stopWorkers(JSONThreadPool_t* pool, int started){
+   pthread_mutex_lock(&pool->lock);
+   pool->stopping = true;
+   pthread_cond_broadcast(&pool->ready);
+   pthread_mutex_unlock(&pool->lock);
+
+   int i;
+   for (i = 0; i < started; ++i){
+      pthread_join(pool->threads[i], NULL);
+   }
+
+   pthread_cond_destroy(&pool->done);
+   pthread_cond_destroy(&pool->ready);
+   pthread_mutex_destroy(&pool->lock);
+   free(pool->threads);
+   free(pool);
+}
@@ -0,0 +1,53 @@
+#ifndef _JSON_THREADS_H
+#define _JSON_THREADS_H
+
+#include <pthread.h>
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+
+/**
+ * The work a thread pool does. The same function is called once for each
+ * task in a job, with the task number (0 to count - 1). Tasks run at the
+ * same time on different threads, in no particular order.
+ */
+typedef void (*JSONTask_t)(void* context, size_t task);
+
+/**
+ * A thread pool keeps a set of threads waiting for work, so jobs can be
+ * split up without starting new threads each time. A job is a number of
+ * tasks, and each thread takes the next task that has not been started
+ * until they are all done. The pool runs one job at a time.
+ */
+typedef struct {
+   pthread_t* threads;     /**< The threads in the pool */
+   int threadCount;        /**< How many threads there are */
+   pthread_mutex_t lock;   /**< Guards everything below */
+   pthread_cond_t ready;   /**< Signaled when a job is posted, or the pool is shutting down */
+   pthread_cond_t done;    /**< Signaled when the last task of a job is finished */
+   JSONTask_t task;        /**< The function for the job being run */
+   void* context;          /**< Passed to each task */
+   size_t taskCount;       /**< How many tasks are in the job */
+   size_t nextTask;        /**< The next task that has not been started */
+   size_t finished;        /**< How many tasks have been finished */
+   bool running;           /**< A job has been posted and is not finished */
+   bool stopping;          /**< The pool is being disposed of */
+} JSONThreadPool_t;
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONThreadPool_t* newJSONThreadPool(int threads);
+JSONError_t runJSONThreadPool(JSONThreadPool_t* pool, JSONTask_t task, void* context, size_t count);
+void disposeOfJSONThreadPool(JSONThreadPool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,6 +17,7 @@ static bool verify = false;
 static bool standardin = false;
 static char* key = NULL;
 static char* delimit = NULL;
+static int threads = 1;
 
 static struct option longOptions[] = {
   {"help",    no_argument,       NULL,   'h'},
@@ -24,11 +25,13 @@ static struct option longOptions[] = {
   {"verify",  no_argument,       NULL,   'r'},
   {"key",     required_argument, NULL,   'k'},
   {"delimit", required_argument, NULL,   'd'},
+  {"threads", required_argument, NULL,   'j'},
   { 0,        0,                 0,       0 }
 };
 
-static const char* shortOptions = "hvrk:d:";
+static const char* shortOptions = "hvrk:d:j:";
 static char* findValueForKey(char* key, char* delimit, JSONKeyValue_t* document);
+static JSONError_t printDocument(JSONKeyValue_t* document, int* exitcode);
 
 /**
   This function will print the help menu and exit with the
@@ -49,96 +52,11 @@ static void usageAndExit(FILE* term, char* programName, int exitCode){
   fprintf(term, "\t-k  --key     Print the value of the given key\n");
   fprintf(term, "\t              only for string, number, bool, or null\n");
   fprintf(term, "\t-d  --delimit Specify a seperator for multi-level keys\n");
+  fprintf(term, "\t-j  --threads Parse the messages in a file on this many threads\n");
+  fprintf(term, "\t              0 = one for each processor\n");
   exit(exitCode);
 }
 
-/**
-  This function is a custom memory reallocation function that will expand
-  a memory space pointed to by the pointer. This newly expanded space will 
-  be filled with zeros (if the new space is larger then the old space)
-
-  @param ptr - The origional pointer, or NULL for a new pointer
-  @param oldSize - The origional size of the memory allocated
-  @param newSize - The new size of the memory after allocation
-  @return The new pointer
-*/
-static void* crealloc(void* ptr, int oldSize, int newSize){
-  void* newPtr = NULL;
-  if (oldSize >= newSize){
-    newPtr = realloc(ptr, newSize);
-    if (!newPtr){
-      return NULL;
-    }
-  }
-  else {
-    newPtr = malloc(newSize);
-    if (!newPtr) return NULL;
-
-    memset(newPtr, 0, newSize);
-    if (ptr){
-      memcpy(newPtr, ptr, oldSize);
-    }
-  }
-
-  return newPtr;
-}
-
-/**
-  Read the message from standard in and return the message back to the
-  the caller as a char*
-  @return The json message from the console
-*/
-static char* readFromConsole(){
-  int charCount = 100;
-  int charIndex = 0;
-  char read = '\0';
-  char* input = (char*)crealloc(NULL, 0, charCount);
-  if (!input){
-    return NULL;
-  }
-
-  while((read = getchar()) != EOF){
-    input[charIndex++] = read;
-    if (charIndex >= charCount){
-      input = (char*)crealloc(input, (sizeof(char) * charCount), (sizeof(char) * charCount * 2));
-      charCount *= 2;
-      if (!input){
-        return NULL;
-      }
-    }
-  }
-
-  return input;
-}
-
-/**
-  Read the message from a file, and return the message back to the 
-  caller as a char*
-  @param fileName - The name of the file to read the message from
-  @return The json message from the file
-*/
-static char* readFromFile(const char* fileName, long long *dataRead){
-  FILE* jsonMessage = NULL;
-  jsonMessage = fopen(fileName, "r");
-  if (!jsonMessage){
-    return NULL;
-  }
-
-  fseek(jsonMessage, 0, SEEK_END);
-  long long fileSize = ftell(jsonMessage);
-  fseek(jsonMessage, 0, SEEK_SET);
-
-  char* message = (char*)crealloc(NULL, 0, (sizeof(char) * (fileSize + 1)));
-  if (!message){
-    return NULL;
-  }
-
-  *dataRead = fread(message, sizeof(char), fileSize, jsonMessage);
-  fclose(jsonMessage);
-
-  return message;
-}
-
 /**
   This function will parse through the command line options and
   set the proper variables. 
@@ -166,6 +84,9 @@ static int parseCommandlineOptions(int argc, char* argv[]){
       case 'd' :
          delimit = strdup(optarg);
          break;
+      case 'j' :
+         threads = atoi(optarg);
+         break;
       case '?' :
         break;
       default :
@@ -181,13 +102,50 @@ static char* findValueForKey(char* key, char* delimit, JSONKeyValue_t* document)
    return NULL;
 }
 
+/**
+  Prints a document, or the value of the key that was asked for
+
+  @param document - The document to print
+  @param exitcode - Set to 1 if the key was not found
+  @return JSON_SUCCESS, or the error from documentToString()
+*/
+static JSONError_t printDocument(JSONKeyValue_t* document, int* exitcode){
+  JSONError_t status = JSON_SUCCESS;
+
+  if (key){
+     char* value = findValueForKey(key, delimit, document);
+     if (!value){
+        fprintf(stdout, "key not found!\n");
+        *exitcode = 1;
+     }
+  }
+  else {
+     char* parsedDocument = NULL;
+     int messageLength;
+     status = documentToString(document, &parsedDocument, &messageLength);
+
+     if (status){
+       const char* errorReport = json_strerror(json_errno);
+       fprintf(stderr, "%s\n", errorReport);
+     }
+
+     fprintf(stdout, "%s\n", parsedDocument);
+
+     if (parsedDocument){
+       free(parsedDocument);
+     }
+  }
+
+  return status;
+}
+
 
 /**
   The main function for the program
 */
 int main(int argc, char* argv[]) {
   int exitcode = EXIT_SUCCESS;
-  char* message = NULL;
+  JSONFile_t* file = NULL;
 
   //Set up the syslog 
   openlog(argv[0], LOG_PID, LOG_USER);
@@ -216,6 +174,15 @@ int main(int argc, char* argv[]) {
   }
   
   int fileCount = 0;
+  JSONThreadPool_t* pool = NULL;
+
+  if (threads != 1 && !verify){
+    pool = newJSONThreadPool(threads);
+    if (!pool){
+      fprintf(stderr, "Unable to start %d threads\n", threads);
+      exit(1);
+    }
+  }
 
   if (standardin){
     fileCount = 1;
@@ -231,31 +198,90 @@ int main(int argc, char* argv[]) {
 
   while (fileCount > 0){
     fileCount--;
-    long long dataRead = 0;
     const char* filename = "";
     if (standardin){
-      message = readFromConsole();
+      file = openJSONFileDescriptor(STDIN_FILENO, FILE_DEFAULT);
       filename = "stdin";
     }
     else {
-      message = readFromFile(argv[optind++], &dataRead);
+      file = openJSONFile(argv[optind++], FILE_DEFAULT);
       filename = argv[optind - 1];
     }
 
-    if (!message){
+    if (!file){
       fprintf(stderr, "Unable to read from file %s", filename);
       exit(1);
     }
 
+    const char* message = file->data;
+    size_t dataRead = file->length;
+
+    if (verify){
+      //Only the return value is needed, so check every message without
+      //building any of them
+      size_t offset = 0;
+      do {
+        size_t consumed = 0;
+        JSONError_t status = validateJSONBuffer(&message[offset], dataRead - offset, &consumed);
+        if (status){
+          closeJSONFile(file);
+          exit(status);
+        }
+        offset += consumed;
+      } while (offset < dataRead);
+
+      closeJSONFile(file);
+      continue;
+    }
+
+    if (pool){
+      //Parse the whole file at once, then print the documents in order
+      JSONBatch_t* batch = NULL;
+      JSONError_t status = parseJSONBatch(pool, &batch, message, dataRead, PARSE_ARENA);
+      if (status){
+        fprintf(stderr, "%s\n", json_strerror(status));
+        closeJSONFile(file);
+        disposeOfJSONThreadPool(pool);
+        exit(status);
+      }
+
+      size_t i;
+      for (i = 0; status == JSON_SUCCESS && i < batch->count; ++i){
+        JSONBatchDocument_t* entry = &batch->documents[i];
+        if (entry->status){
+          fprintf(stderr, "Error while parsing the message at byte %zu\n", entry->offset);
+          fprintf(stderr, "%s\n", json_strerror(entry->status));
+          closeJSONFile(file);
+          disposeOfJSONBatch(batch);
+          disposeOfJSONThreadPool(pool);
+          exit(entry->status);
+        }
+
+        status = printDocument(entry->document, &exitcode);
+      }
+
+      disposeOfJSONBatch(batch);
+      closeJSONFile(file);
+      continue;
+    }
+
     JSONParser_t* parser = newJSONParser();
     JSONKeyValue_t* document = NULL;
-    int lastIndex = 0;
-    int currentIndex = 0;
+    //A mapped file is read only, and copying the strings out of it keeps the
+    //pages shared with the page cache. Input that was read into memory can be
+    //parsed in place
+    setJSONParserOptions(parser, PARSE_ARENA | ((file->writable) ? PARSE_IN_SITU : 0));
+    JSONDocumentIterator_t iterator;
     JSONError_t status = 0;
 
+    if (file->writable){
+      initJSONDocumentIteratorInSitu(&iterator, parser, file->data, dataRead);
+    }
+    else {
+      initJSONDocumentIterator(&iterator, parser, message, dataRead);
+    }
     do {
-      status = parseJSONMessage(parser, &document, &message[currentIndex], &lastIndex);
-      currentIndex += lastIndex;
+      status = nextJSONDocument(&iterator, &document);
 
       if (status){
         //An error has occurred! if we are not in verify mode, print the error
@@ -266,49 +292,23 @@ int main(int argc, char* argv[]) {
           fprintf(stderr, "%s\n", errorReport);
         }
        
-        disposeOfPair(document);
-        free(message);
-        free(parser);
+        closeJSONFile(file);
+        disposeOfJSONParser(parser);
         exit(status);
       }
 
-      if (key){
-         char* value = findValueForKey(key, delimit, document);
-         if (!value){
-            fprintf(stdout, "key not found!\n");
-            exitcode = 1;
-         }
-      }
-      else {
-         char* parsedDocument = NULL;
-         int messageLength;
-         status = documentToString(document, &parsedDocument, &messageLength);
-
-         if (status){
-           if (!verify){
-             const char* errorReport = json_strerror(json_errno);
-             fprintf(stderr, "%s\n", errorReport);
-           }
-         }
-
-         if (!verify){
-           fprintf(stdout, "%s\n", parsedDocument);
-         }
-
-         if (parsedDocument){
-           free(parsedDocument);
-         }
-      }
+      status = printDocument(document, &exitcode);
+      recycleJSONDocument(parser, document);
 
-      disposeOfPair(document);
+    } while (status == JSON_SUCCESS && hasNextJSONDocument(&iterator));
 
-    } while (status == JSON_SUCCESS && lastIndex > 0);
-
-    free(message);
-    free(parser);
+    closeJSONFile(file);
+    disposeOfJSONParser(parser);
 
   }
 
+  disposeOfJSONThreadPool(pool);
+
   //Close out the system log
   closelog();
   return exitcode;
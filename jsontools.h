@@ -43,6 +43,15 @@
 #include "jsonoutput.h"
 #include "jsonerror.h"
 #include "jsonhelper.h"
+#include "jsonmemory.h"
+#include "jsonkeys.h"
+#include "jsonprojection.h"
+#include "jsonvalidate.h"
+#include "jsonlazy.h"
+#include "jsonthreads.h"
+#include "jsonbatch.h"
+#include "jsonfile.h"
+#include "jsontape.h"
 
 #endif
 
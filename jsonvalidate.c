@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "jsontools.h"
+#include "jsonscan.h"
+#include "jsonnumber.h"
+#include "jsonstring.h"
+
+#define DEPTH_WORDS              ((MAX_DEPTH + 63) / 64)
+
+/**
+ * Everything the validator has to remember about a message. It is small
+ * enough to live on the stack, the objects and arrays that are open are
+ * kept as a single bit each.
+ */
+typedef struct {
+   const char* message;             /**< The message being checked */
+   size_t size;                     /**< The length of the message */
+   size_t index;                    /**< Where the validator is in the message */
+   int depth;                       /**< How many objects and arrays are open */
+   uint64_t objects[DEPTH_WORDS];   /**< Bit n is set if the container at depth n is an object */
+   ParserState_t state;             /**< What can come next, the same as the parsers state */
+} JSONValidator_t;
+
+/*-----------------------------------------------------------------
+ * Declare private static functions
+ *---------------------------------------------------------------*/
+
+static JSONError_t checkStructure(JSONValidator_t* validator);
+static JSONError_t checkString(JSONValidator_t* validator, size_t start, size_t end, bool isKey);
+static JSONError_t checkLiteral(const char* token, size_t length);
+static JSONError_t checkValueEnd(JSONValidator_t* validator);
+static bool isObject(JSONValidator_t* validator, int depth);
+static void nextValueState(JSONValidator_t* validator);
+static size_t findNumberEnd(const char* message, size_t index, size_t size);
+static size_t findLiteralEnd(const char* message, size_t index, size_t size);
+static void skipWhiteSpace(JSONValidator_t* validator);
+
+/*------------------------------------------------------------------
+ * Implement global functions
+ *-----------------------------------------------------------------*/
+
+/**
+ * Checks the first JSON message in a buffer without building anything.
+ * The message is held to exactly the same rules as parseJSONBuffer(), so
+ * a message that passes here will parse, and the same error is returned
+ * for a message that does not. On top of that every key and string has to
+ * be well formed UTF-8. No memory is allocated, the only state is a bit
+ * for each open object or array, and messages can nest up to MAX_DEPTH
+ * deep. That is the default limit of a parser, setJSONParserMaxDepth()
+ * does not change it here, so a message nested deeper than MAX_DEPTH is
+ * rejected with JSON_MESSAGE_TOO_LARGE even if a parser with a higher
+ * limit would take it. Characters are classified with the same tables the
+ * parser uses, so the result does not depend on the locale.
+ *
+ * @param message - The start of the JSON message
+ * @param length - The number of bytes available in the message buffer
+ * @param consumed - The number of bytes used by this message (see parseJSONBuffer).
+ *    If the message is not valid, this is where the problem was found.
+ * @return JSON_SUCCESS if the message is valid, an error otherwise
+ */
+JSONError_t validateJSONBuffer(const char* message, size_t length, size_t* consumed){
+   JSONValidator_t validator;
+
+   if (!message || !consumed){
+      json_errno = JSON_NULL_ARGUMENT;
+      return JSON_NULL_ARGUMENT;
+   }
+
+   validator.message = message;
+   validator.size = length;
+   validator.index = 0;
+   validator.depth = 0;
+   validator.state = (OPEN_PREN | OPEN_BRACKET);
+
+   //Seek forward to first character in the message
+   skipWhiteSpace(&validator);
+
+   JSONError_t returnStatus = JSON_INVALID_MESSAGE;
+   if (validator.index < length){
+      returnStatus = checkStructure(&validator);
+   }
+
+   if (returnStatus){
+      *consumed = (validator.index < length) ? validator.index : length;
+      json_errno = returnStatus;
+      return returnStatus;
+   }
+
+   //Report where the next message starts, if there is one
+   skipWhiteSpace(&validator);
+
+   if (validator.index < length && (message[validator.index] == '{' || message[validator.index] == '[')){
+      *consumed = validator.index;
+   }
+   else {
+      *consumed = length;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/*--------------------------------------------------------------------
+ * Implement private static functions
+ *------------------------------------------------------------------*/
+
+/**
+ * Walks the structural characters of the message the same way the parser
+ * does, using the same states to decide if each one is allowed where it
+ * was found.
+ *
+ * @param validator - The validator for the message
+ * @return JSON_SUCCESS when the message is complete, JSON_MESSAGE_INCOMPLETE
+ *    if the message ran out first, or the problem that was found
+ */
+static JSONError_t checkStructure(JSONValidator_t* validator){
+   const char* message = validator->message;
+   size_t size = validator->size;
+   JSONError_t returnStatus;
+   JSONScanner_t scanner;
+   size_t position;
+
+   initJSONScanner(&scanner, message, validator->index, size);
+
+   while (nextStructural(&scanner, &position)){
+      validator->index = position;
+      char current = message[position];
+      bool inObject = (validator->depth > 0 && isObject(validator, validator->depth - 1));
+
+      if (validator->depth == 0 && current != '{' && current != '['){
+         //A message has to begin with an object or an array
+         return JSON_INVALID_MESSAGE;
+      }
+
+      if (current == '"'){
+         if (!(validator->state & QUOTE)){
+            return JSON_UNEXPECTED_STRING;
+         }
+
+         //The next position in the index is always the closing quote
+         size_t start = position + 1;
+         size_t end;
+         if (!nextStructural(&scanner, &end)){
+            validator->index = size;
+            return JSON_MESSAGE_INCOMPLETE;
+         }
+
+         bool isKey = (validator->state & KEY);
+         returnStatus = checkString(validator, start, end, isKey);
+         if (returnStatus){
+            return returnStatus;
+         }
+
+         validator->index = end;
+         if (isKey){
+            validator->state = DELIMITER;
+         }
+         else {
+            nextValueState(validator);
+         }
+      }
+      else if ((current >= '0' && current <= '9') || current == '-'){
+         if (!(validator->state & DIGIT)){
+            return JSON_UNEXPECTED_NUMBER;
+         }
+
+         size_t end = findNumberEnd(message, position, size);
+         if (end >= size){
+            validator->index = size;
+            return JSON_MESSAGE_INCOMPLETE;
+         }
+
+         returnStatus = checkNumber(&message[position], end - position);
+         if (returnStatus){
+            return returnStatus;
+         }
+
+         validator->index = end;
+         returnStatus = checkValueEnd(validator);
+         if (returnStatus){
+            return returnStatus;
+         }
+
+         nextValueState(validator);
+      }
+      else if (current == 't' || current == 'f' || current == 'n'){
+         if (!(validator->state & CHARACTER) || !(validator->state & VALUE)){
+            return (inObject) ? JSON_UNEXPECTED_VALUE :
+                   (current == 'n') ? JSON_UNEXPECTED_NULL : JSON_UNEXPECTED_BOOLEAN;
+         }
+
+         size_t end = findLiteralEnd(message, position, size);
+         if (end >= size){
+            validator->index = size;
+            return JSON_MESSAGE_INCOMPLETE;
+         }
+
+         returnStatus = checkLiteral(&message[position], end - position);
+         if (returnStatus){
+            return returnStatus;
+         }
+
+         validator->index = end;
+         returnStatus = checkValueEnd(validator);
+         if (returnStatus){
+            return returnStatus;
+         }
+
+         nextValueState(validator);
+      }
+      else if (current == '{' || current == '['){
+         bool object = (current == '{');
+         if ((validator->depth > 0 && !(validator->state & VALUE)) ||
+             !(validator->state & ((object) ? OPEN_PREN : OPEN_BRACKET))){
+            return (object) ? JSON_UNEXPECTED_OBJECT : JSON_UNEXPECTED_ARRAY;
+         }
+
+         if (validator->depth >= MAX_DEPTH){
+            return JSON_MESSAGE_TOO_LARGE;
+         }
+
+         uint64_t bit = 1ULL << (validator->depth % 64);
+         if (object){
+            validator->objects[validator->depth / 64] |= bit;
+            validator->state = (KEY | QUOTE | CLOSE_PREN | CHARACTER);
+         }
+         else {
+            validator->objects[validator->depth / 64] &= ~bit;
+            validator->state = (VALUE | QUOTE | CHARACTER | DIGIT | CLOSE_BRACKET | OPEN_PREN | OPEN_BRACKET);
+         }
+         validator->depth++;
+      }
+      else if (current == '}' || current == ']'){
+         if (current == '}' && (!inObject || !(validator->state & CLOSE_PREN))){
+            return JSON_OBJECT_BRACKET_MISMATCH;
+         }
+
+         if (current == ']' && (inObject || !(validator->state & CLOSE_BRACKET))){
+            return JSON_ARRAY_BRACKET_MISMATCH;
+         }
+
+         validator->depth--;
+         if (validator->depth == 0){
+            //Done here
+            validator->index = position + 1;
+            return JSON_SUCCESS;
+         }
+
+         nextValueState(validator);
+      }
+      else if (current == ':' && inObject){
+         if (!(validator->state & DELIMITER)){
+            return JSON_UNEXPECTED_DELIMITER;
+         }
+
+         validator->state = (VALUE | QUOTE | OPEN_PREN | OPEN_BRACKET | DIGIT | CHARACTER);
+      }
+      else if (current == ','){
+         if (!(validator->state & COMMA)){
+            return JSON_UNEXPECTED_COMMA;
+         }
+
+         if (inObject){
+            validator->state = (KEY | QUOTE | CHARACTER);
+         }
+         else {
+            validator->state = (VALUE | QUOTE | CHARACTER | DIGIT | OPEN_PREN | OPEN_BRACKET);
+         }
+      }
+      else {
+         //Found some other random character that we weren't expecting
+         return JSON_UNEXPECTED_CHARACTER;
+      }
+   }
+
+   validator->index = size;
+   return JSON_MESSAGE_INCOMPLETE;
+}
+
+/**
+ * Checks the escape sequences in a key or string the same way the parser
+ * does, and then makes sure it is well formed UTF-8. The '\uXXXX' escapes
+ * in keys are decoded, so their surrogates have to be paired, strings are
+ * kept as they are and only need the four hex digits.
+ *
+ * @param validator - The validator for the message
+ * @param start - The first character inside of the quotes
+ * @param end - The closing quote
+ * @param isKey - true if this is a key
+ * @return JSON_SUCCESS, JSON_INVALID_KEY, JSON_INVALID_UNICODE_SEQ, or JSON_INVALID_UTF8
+ */
+static JSONError_t checkString(JSONValidator_t* validator, size_t start, size_t end, bool isKey){
+   const char* message = validator->message;
+   size_t i = findQuoteOrEscape(message, start, end);
+
+   while (i < end){
+      //The scanner only stops on escapes, the closing quote is the end
+      char escaped = message[i + 1];
+      size_t used = 2;
+      if (isKey){
+         uint32_t codePoint;
+         if (escaped == 'u'){
+            //A surrogate pair is read as one escape, both halves are skipped
+            used = readUnicodeEscape(message, i, end, &codePoint);
+            if (!used){
+               validator->index = i;
+               return JSON_INVALID_UNICODE_SEQ;
+            }
+         }
+         else if (!strchr("ntrb\\/f\"", escaped) || escaped == '\0'){
+            validator->index = i;
+            return JSON_INVALID_KEY;
+         }
+      }
+      else if (escaped == 'u' || escaped == 'U'){
+         for (size_t j = i + 2; j < i + 6; j++){
+            if (j >= end || !(characterTraits[(unsigned char)message[j]] & TRAIT_HEX)){
+               validator->index = i;
+               return JSON_INVALID_UNICODE_SEQ;
+            }
+         }
+      }
+
+      i = findQuoteOrEscape(message, i + used, end);
+   }
+
+   size_t invalid = findInvalidUTF8(message, start, end);
+   if (invalid < end){
+      validator->index = invalid;
+      return JSON_INVALID_UTF8;
+   }
+
+   return JSON_SUCCESS;
+}
+
+/**
+ * Checks that an unquoted value is true, false, or null
+ *
+ * @param token - The characters of the value
+ * @param length - The number of characters
+ * @return JSON_SUCCESS, or JSON_INVALID_VALUE
+ */
+static JSONError_t checkLiteral(const char* token, size_t length){
+   if ((length == 4 && memcmp(token, "true", 4) == 0) ||
+       (length == 5 && memcmp(token, "false", 5) == 0) ||
+       (length == 4 && memcmp(token, "null", 4) == 0)){
+      return JSON_SUCCESS;
+   }
+
+   return JSON_INVALID_VALUE;
+}
+
+/**
+ * Makes sure a number or unquoted value is followed by white space or a
+ * structural character.
+ *
+ * @param validator - The validator for the message, its index is just past the value
+ * @return JSON_SUCCESS, or JSON_UNEXPECTED_CHARACTER
+ */
+static JSONError_t checkValueEnd(JSONValidator_t* validator){
+   switch (validator->message[validator->index]){
+      case ' ' : case '\t' : case '\n' : case '\v' : case '\f' : case '\r' :
+      case '{' : case '}' : case '[' : case ']' : case ':' : case ',' : case '"' :
+         return JSON_SUCCESS;
+
+      default :
+         return JSON_UNEXPECTED_CHARACTER;
+   }
+}
+
+/**
+ * Checks the bit stack to see if an open container is an object
+ *
+ * @param validator - The validator for the message
+ * @param depth - The depth of the container
+ * @return true if it is an object, false if it is an array
+ */
+static bool isObject(JSONValidator_t* validator, int depth){
+   return (validator->objects[depth / 64] >> (depth % 64)) & 1;
+}
+
+/**
+ * Sets the state up for whatever can come after a value in the object
+ * or array that is open.
+ *
+ * @param validator - The validator for the message
+ */
+static void nextValueState(JSONValidator_t* validator){
+   if (isObject(validator, validator->depth - 1)){
+      validator->state = (COMMA | CLOSE_PREN);
+   }
+   else {
+      validator->state = (COMMA | CLOSE_BRACKET);
+   }
+}
+
+/**
+ * Finds the end of a number, the same way the parser does.
+ *
+ * @param message - The JSON message
+ * @param index - The first character of the number
+ * @param size - The length of the message
+ * @return The index just past the number, or size if the message ran out
+ */
+static size_t findNumberEnd(const char* message, size_t index, size_t size){
+   while(index < size && (characterTraits[(unsigned char)message[index]] & TRAIT_NUMBER)){
+      index++;
+   }
+
+   return index;
+}
+
+/**
+ * Finds the end of an unquoted value, the same way the parser does.
+ *
+ * @param message - The JSON message
+ * @param index - The first character of the value
+ * @param size - The length of the message
+ * @return The index just past the value, or size if the message ran out
+ */
+static size_t findLiteralEnd(const char* message, size_t index, size_t size){
+   while(index < size && (characterTraits[(unsigned char)message[index]] & TRAIT_LETTER)){
+      index++;
+   }
+
+   return index;
+}
+
+/**
+ * Steps over white space and comments between messages, the same way the
+ * parser does. A '/' that does not start a comment is left to be reported
+ * as an invalid message.
+ *
+ * @param validator - The validator for the message
+ */
+static void skipWhiteSpace(JSONValidator_t* validator){
+   const char* message = validator->message;
+   size_t size = validator->size;
+   enum { NONE, SLASH, BLOCK, STAR, LINE } comment = NONE;
+
+   while (validator->index < size){
+      char current = message[validator->index];
+
+      switch (comment){
+         case SLASH :
+            if (current == '*'){
+               comment = BLOCK;
+            }
+            else if (current == '/'){
+               comment = LINE;
+            }
+            else {
+               //Not a comment after all
+               validator->index--;
+               return;
+            }
+            break;
+
+         case BLOCK :
+            if (current == '*'){
+               comment = STAR;
+            }
+            break;
+
+         case STAR :
+            if (current == '/'){
+               comment = NONE;
+            }
+            else if (current != '*'){
+               comment = BLOCK;
+            }
+            break;
+
+         case LINE :
+            if (current == '\n'){
+               comment = NONE;
+            }
+            break;
+
+         default :
+            if (current == '/'){
+               comment = SLASH;
+            }
+            else if ((unsigned char)current > ' ' && (unsigned char)current < 0x7F){
+               //We found the first character in the message
+               return;
+            }
+            break;
+      }
+
+      validator->index++;
+   }
+}
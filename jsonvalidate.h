@@ -0,0 +1,21 @@
+#ifndef _JSON_VALIDATE_H
+#define _JSON_VALIDATE_H
+
+#include "jsoncommon.h"
+#include "jsonerror.h"
+
+/*------------------------------------------------------------------
+ * Define global functions
+ *----------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+JSONError_t validateJSONBuffer(const char* message, size_t length, size_t* consumed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,40 +14,27 @@ int main(int argc, char **argv)
       exit(1);
    }
    
-   FILE* jsonMessage = fopen(argv[1], "r");
-   if (!jsonMessage){
+   JSONFile_t* file = openJSONFile(argv[1], FILE_DEFAULT);
+   if (!file){
       fprintf(stderr, "Unable to open file %s\n", argv[1]);
       exit(2);
    }
    
-   fseek(jsonMessage, 0, SEEK_END);
-   long long fileSize = ftell(jsonMessage);
-   fseek(jsonMessage, 0, SEEK_SET);
-   
-   char message[fileSize];
-   
-   long long sizeForTest = fileSize;
-   fread(message, sizeof(char), sizeForTest, jsonMessage);
-   fclose(jsonMessage);
-   
-   message[sizeForTest] = '\0';
-   
    JSONParser_t* parser = newJSONParser();
    JSONKeyValue_t* document;
-   int lastIndex = 0;
-   int currentIndex = 0;
+   JSONDocumentIterator_t iterator;
    JSONError_t status;
    
+   initJSONDocumentIterator(&iterator, parser, file->data, file->length);
    do {
-      status = parseJSONMessage(parser, &document, &message[currentIndex], &lastIndex);
-      currentIndex += lastIndex;
+      status = nextJSONDocument(&iterator, &document);
       
       if (status){
          char* errorReport = parser->tracebackString;
          fprintf(stderr, "%s\n", errorReport);
          
-         for (int i = parser->keyStackIndex - 1; i >= 0; i--){
-            fprintf(stderr, "key->%s\n", parser->keyStack[i]);
+         if (parser->pendingKey){
+            fprintf(stderr, "key->%s\n", parser->pendingKey);
          }
          
          exit(status);
@@ -67,8 +54,9 @@ int main(int argc, char **argv)
       free(parsedDocument);
       disposeOfPair(document);
       
-   } while(status == JSON_SUCCESS && lastIndex > 0);
+   } while(status == JSON_SUCCESS && hasNextJSONDocument(&iterator));
    
-   free(parser);
+   disposeOfJSONParser(parser);
+   closeJSONFile(file);
    return 0;
 }